@@ -0,0 +1,134 @@
+/**
+ * Cache of per-line glyph advances.
+ *
+ * For each line the pixel offset of every column is stored as a prefix sum
+ * of glyph advances (plus kerning), so a column maps to its x position in
+ * O(1) and an x position maps back to a column by binary search. Lines are
+ * keyed by their content hash, an edited line hashes differently and is
+ * simply measured again. Slots are direct mapped, a collision just replaces
+ * the older line.
+ *
+ * Text is measured one byte per glyph (Latin-1), matching TTF_RenderText.
+ * Tabs advance to the next multiple of the tab width, in columns of spaces.
+ *
+ * Fixed pitch fonts take a fast path: a line without tabs stores no
+ * positions at all, x is just the column times the font's advance.
+ *
+ * Text drawn from a distance field font is measured with its scaled metrics
+ * instead, so positions match the resampled glyphs.
+ */
+
+#pragma once
+
+#include <SDL_ttf.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdf_font.h"
+
+#define ADVANCE_CACHE_SLOTS 1024 // Power of two
+#define ADVANCE_CACHE_GLYPHS 256
+
+typedef struct {
+    uint64_t hash;          // Content hash of the line
+    int length;             // Columns measured, -1 if the slot is empty
+    int advance;            // Width of every column if non-zero, x is unused
+    int* x;                 // x[col] for col in [0, length]
+    int capacity;
+} LineAdvances;
+
+typedef struct {
+    TTF_Font* font;
+    SdfFont* sdf;                           // Measured at size from this if set
+    int size;
+    bool kerning;                           // Whether glyph pairs need kerning applied
+    int monospace_advance;                  // Advance of every glyph if the font is
+                                            // fixed pitch, 0 otherwise
+    int tab_width;                          // Columns between tab stops
+    int glyph_advance[ADVANCE_CACHE_GLYPHS];
+    bool glyph_loaded[ADVANCE_CACHE_GLYPHS];
+
+    LineAdvances slots[ADVANCE_CACHE_SLOTS];
+} AdvanceCache;
+
+/**
+ * Initialises an empty cache.
+ *
+ * @param c Pointer to the cache
+ * @param tab_width Columns between tab stops
+ */
+void advance_cache_init(AdvanceCache* c, int tab_width);
+
+/**
+ * Frees every measured line.
+ *
+ * @param c Pointer to the cache
+ */
+void advance_cache_destroy(AdvanceCache* c);
+
+/**
+ * Sets the font lines are measured with, forgetting every line if it changed.
+ *
+ * @param c Pointer to the cache
+ * @param font Font text is drawn with
+ */
+void advance_cache_set_font(AdvanceCache* c, TTF_Font* font);
+
+/**
+ * Measures lines with a distance field font at a pixel size instead,
+ * forgetting every line if either changed.
+ *
+ * @param c Pointer to the cache
+ * @param sdf Distance field font text is drawn with
+ * @param size Pixel size
+ */
+void advance_cache_set_sdf(AdvanceCache* c, SdfFont* sdf, int size);
+
+/**
+ * Looks up a measured line.
+ *
+ * @param c Pointer to the cache
+ * @param hash Content hash of the line
+ * @param length Length of the line in bytes
+ *
+ * @return Advances of the line, or NULL if it has not been measured
+ */
+const LineAdvances* advance_cache_find(AdvanceCache* c, uint64_t hash, int length);
+
+/**
+ * Expands tabs into spaces, the way lines are measured.
+ *
+ * @param text Text to expand
+ * @param length Length of the text in bytes
+ * @param tab_width Columns between tab stops
+ * @param out Buffer for the expanded text, at least length * tab_width + 1 bytes
+ *
+ * @return Length of the expanded text (out is NUL-terminated)
+ */
+int advance_cache_expand_tabs(const char* text, int length, int tab_width, char* out);
+
+/**
+ * Measures a line and stores it.
+ *
+ * @param c Pointer to the cache
+ * @param hash Content hash of the line
+ * @param text Text of the line
+ * @param length Length of the line in bytes
+ *
+ * @return Advances of the line, or NULL on error
+ */
+const LineAdvances* advance_cache_build(AdvanceCache* c, uint64_t hash, const char* text, int length);
+
+/**
+ * @return x position of a column, columns past the end are clamped
+ */
+int advance_cache_col_to_x(const LineAdvances* a, int col);
+
+/**
+ * Finds the column boundary nearest to an x position.
+ *
+ * @param a Advances of the line
+ * @param x Position relative to the start of the line
+ *
+ * @return Column in [0, length]
+ */
+int advance_cache_x_to_col(const LineAdvances* a, int x);
@@ -11,19 +11,34 @@
 #define WINDOW_WIDTH  1200
 #define WINDOW_HEIGHT 800
 
+#define APP_FRAME_MS           16  // Frame interval while something animates
+#define APP_UNFOCUSED_FRAME_MS 100 // Slowest frame interval when in the background
+#define APP_MINIMIZED_POLL_MS  250 // Update interval when minimized, nothing is drawn
+#define APP_GLYPH_UPLOAD_MS    2   // Time spent uploading rasterized glyphs per frame
+
 typedef enum {
     APP_STATE_EDITOR,
     APP_STATE_FILE_DIALOG
 } AppState;
 
+typedef struct {
+    const char* file;       // File opened at start
+    bool headless;          // Draw offscreen on the dummy video driver, e.g. on CI
+    int frames;             // Frames drawn before quitting when headless, 0 for no limit
+    const char* dump_dir;   // Directory every headless frame is written to, NULL for none
+    bool scroll;            // Move the cursor down a line every headless frame
+} AppOptions;
+
 typedef struct {
     AppState state;
+    AppOptions options;
 
     kWindow window;
     Renderer* renderer;
-    Editor editor;
+    Editor* editor;
+    UiLayer help_layer;     // Help panel (F6)
 } App;
 
-bool app_init(App* app);
+bool app_init(App* app, const AppOptions* options);
 void app_run(App* app);
 void app_cleanup(App* app);
\ No newline at end of file
@@ -0,0 +1,113 @@
+/**
+ * Growable arena and fixed-size object pools.
+ *
+ * An Arena hands out memory by bumping a pointer through a chain of blocks.
+ * Blocks grow geometrically and are never moved or reallocated, so pointers
+ * into an arena stay valid until the arena is reset or destroyed.
+ *
+ * A Pool is a slab allocator for objects of one size (e.g. tree nodes),
+ * carving slabs out of its own arena and recycling freed objects through
+ * a free list.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define ARENA_MIN_BLOCK_SIZE (64 * 1024)
+#define ARENA_MAX_BLOCK_SIZE (64 * 1024 * 1024)
+
+typedef struct ArenaBlock ArenaBlock;
+
+struct ArenaBlock {
+    ArenaBlock* next;       // Previously filled block
+    size_t size;            // Usable bytes in this block
+    size_t used;            // Bytes handed out so far
+    char data[];
+};
+
+typedef struct {
+    ArenaBlock* head;       // Block currently being filled
+    size_t next_block_size; // Size of the next block to allocate
+    size_t total_size;      // Bytes reserved across all blocks
+} Arena;
+
+typedef struct {
+    Arena arena;            // Backing memory for slabs
+    size_t object_size;
+    void* free_list;        // Recycled objects
+    size_t count;           // Objects currently in use
+} Pool;
+
+/**
+ * Initialises an empty arena. No memory is reserved until the first allocation.
+ *
+ * @param a Pointer to the arena
+ */
+void arena_init(Arena* a);
+
+/**
+ * Frees every block owned by the arena.
+ *
+ * @param a Pointer to the arena
+ */
+void arena_destroy(Arena* a);
+
+/**
+ * Releases all allocations, keeping the most recent block for reuse.
+ *
+ * @param a Pointer to the arena
+ */
+void arena_reset(Arena* a);
+
+/**
+ * Allocates memory from the arena.
+ *
+ * @param a Pointer to the arena
+ * @param size Number of bytes to allocate
+ * @param align Required alignment (power of two, 1 for byte data)
+ *
+ * @return Pointer to the memory, or NULL on failure
+ */
+void* arena_alloc(Arena* a, size_t size, size_t align);
+
+/**
+ * Grows the most recent allocation in place, if it ends at end and the
+ * current block has room.
+ *
+ * @param a Pointer to the arena
+ * @param end Pointer one past the end of the allocation to grow
+ * @param size Number of bytes to add
+ *
+ * @return Whether the allocation was grown
+ */
+bool arena_extend(Arena* a, const void* end, size_t size);
+
+/**
+ * Initialises a pool of fixed-size objects.
+ *
+ * @param p Pointer to the pool
+ * @param object_size Size of each object in bytes
+ */
+void pool_init(Pool* p, size_t object_size);
+
+/**
+ * Frees all memory owned by the pool, including objects still in use.
+ *
+ * @param p Pointer to the pool
+ */
+void pool_destroy(Pool* p);
+
+/**
+ * @return Pointer to an uninitialised object, or NULL on failure
+ */
+void* pool_alloc(Pool* p);
+
+/**
+ * Returns an object to the pool for reuse.
+ *
+ * @param p Pointer to the pool
+ * @param object Object previously returned by pool_alloc
+ */
+void pool_free(Pool* p, void* object);
@@ -0,0 +1,117 @@
+/**
+ * Persistent glyph atlas cache.
+ *
+ * Atlases drawn with in a session are saved to one file when the renderer is
+ * destroyed, and the file is mapped at the next start. An atlas created for a
+ * font that was cached is filled from the mapping (pages, glyph boxes and
+ * metrics) instead of rasterizing its glyphs again.
+ *
+ * Atlases are keyed by a hash of the font file's contents, the pixel size and
+ * the render mode, so an edited font or a changed page layout is simply not
+ * found. Records of fonts not used in a session are carried over, but only
+ * the ATLAS_CACHE_MAX_RECORDS most recently used are kept, so sizes zoomed
+ * through once do not grow the file for good. Every
+ * record is checked (glyph boxes within its pages, checksum) before use, a
+ * damaged one is rasterized again.
+ *
+ * File layout (native byte order):
+ *   header:  "KATL", u32 version, u32 record count, u32 page size
+ *   records: AtlasCacheRecord[count]
+ *   pixels:  coverage of each record's pages, one byte per pixel, only the
+ *            rows in use
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "glyph_atlas.h"
+#include "kFile.h"
+
+#define ATLAS_CACHE_PATH    "resources/fonts/glyphs.cache"
+#define ATLAS_CACHE_VERSION 3
+#define ATLAS_CACHE_MAX_RECORDS 8   // Atlases kept, most recently used first
+
+typedef enum {
+    ATLAS_MODE_BLENDED,     // Rasterized by SDL_ttf
+    ATLAS_MODE_SDF          // Resampled from a distance field font
+} AtlasMode;
+
+typedef struct {
+    int16_t page;
+    int16_t x, y, w, h;
+    int16_t offset_x;
+    int16_t advance;
+    uint8_t loaded;
+    uint8_t unused;
+} AtlasCacheGlyph;
+
+typedef struct {
+    uint64_t font_hash;
+    int32_t size;
+    int32_t mode;           // AtlasMode
+    int32_t height;
+    int32_t kerning;
+    int32_t digit_width;
+    int32_t page_count;
+    int32_t shelf_x, shelf_y, shelf_height;
+    int32_t page_rows[GLYPH_ATLAS_MAX_PAGES];   // Rows of coverage stored per page
+    uint64_t pixels;        // Offset of the coverage in the file
+    uint64_t pixels_size;
+    uint32_t checksum;      // FNV-1a of the record (pixels and checksum zeroed)
+                            // followed by its coverage
+    uint32_t last_used;     // Session the atlas was last drawn with, counting up
+    AtlasCacheGlyph glyphs[GLYPH_ATLAS_GLYPHS];
+} AtlasCacheRecord;
+
+typedef struct {
+    kFileMap map;
+    bool mapped;
+    const AtlasCacheRecord* records;    // Within the mapping
+    uint32_t count;
+    size_t restored;                    // Atlases filled from the cache
+} AtlasCache;
+
+/**
+ * Maps the cache file, if there is a valid one.
+ *
+ * @param c Pointer to the cache to initialise
+ * @param path Path of the cache file
+ *
+ * @return Whether a cache was mapped (the cache is usable empty either way)
+ */
+bool atlas_cache_open(AtlasCache* c, const char* path);
+
+/**
+ * Unmaps the cache file.
+ *
+ * @param c Pointer to the cache
+ */
+void atlas_cache_close(AtlasCache* c);
+
+/**
+ * Fills a freshly created atlas from the cache. The atlas's font_hash, size
+ * and font or sdf must be set.
+ *
+ * @param c Pointer to the cache
+ * @param atlas Empty atlas
+ *
+ * @return Whether the atlas was found and restored
+ */
+bool atlas_cache_restore(AtlasCache* c, GlyphAtlas* atlas);
+
+/**
+ * Writes the atlases (and the most recently used records of other fonts
+ * still in the cache) to the cache file, replacing it. At most
+ * ATLAS_CACHE_MAX_RECORDS are written, atlases first in the order given.
+ * Nothing is written if no atlas gained glyphs. The cache is closed afterwards.
+ *
+ * @param c Pointer to the cache
+ * @param path Path of the cache file
+ * @param atlases Atlases to save, NULL entries are skipped
+ * @param count Number of atlases
+ *
+ * @return Whether the file is up to date
+ */
+bool atlas_cache_save(AtlasCache* c, const char* path, GlyphAtlas* const* atlases, int count);
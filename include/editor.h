@@ -5,50 +5,101 @@
 #include <stdio.h>
 #include "renderer.h"
 #include "kEvents.h"
-
-#define MAX_LINES       1024
-#define MAX_LINE_LENGTH 256
+#include "text_buffer.h"
+#include "file_loader.h"
+#include "file_saver.h"
+#include "undo.h"
+#include "journal.h"
+#include "arena.h"
+#include "advance_cache.h"
+#include "scroll_view.h"
+#include "font_manager.h"
 
 #define MAX_FILENAME_LENGTH 256
 
+#define EDITOR_MAX_RENDER_LENGTH 1024 // Bytes of a line fetched for rendering/measuring
+#define EDITOR_BLINK_TIMEOUT     10.0f // Seconds the cursor blinks for after the last input
+#define EDITOR_BLINK_PHASES      16    // Alpha steps per blink, the editor wakes once per step
+#define EDITOR_POLL_MS           16    // Update interval while loading or saving
+#define EDITOR_TAB_WIDTH         4     // Columns between tab stops
+#define EDITOR_SCROLL_SPEED      20.0f // Rate the shown scroll position catches up at (1/s)
+#define EDITOR_MIN_FONT_SIZE     6
+
+typedef struct {
+    char* text;                             // NUL-terminated copy of the line (may be truncated)
+    int length;                             // Cached length of text in bytes
+} EditorLine;
+
 typedef struct {
     int line_height;
     int left_margin;
 
-    char lines[MAX_LINES][MAX_LINE_LENGTH]; // Current text
-    char original_lines[MAX_LINES][MAX_LINE_LENGTH];
-    int num_lines;                          // Current number of lines
+    TextBuffer* buffer;                     // Current text
+    Arena line_arena;                       // Copies of lines fetched for the current frame
+    FileLoader* loader;                     // Background load of the current file,
+                                            // NULL once loaded. Editing is disabled
+                                            // until then
+    FileSaver* saver;                       // Save being written in the background,
+                                            // NULL if none
+    UndoHistory undo;                       // Edits that can be undone/redone
+    bool undo_lost;                         // Whether the last edit was too large to
+                                            // record, the history was cleared for it
+    Journal* journal;                       // Crash-recovery journal of the current
+                                            // file, NULL until it has loaded
 
     int scroll_offset_x;                    // Horizontal scroll
-    int scroll_offset_y;                    // Vertical scroll
+    int64_t scroll_offset_y;                // Vertical scroll, content y is 64-bit
+                                            // as 100M+ lines overflow an int
+    double scroll_y;                        // Vertical scroll shown, eases towards
+                                            // scroll_offset_y
+    ScrollView view;                        // Text area kept between frames
 
-    int cursor_line;                        // Current cursor line
+    size_t cursor_line;                     // Current cursor line
     int cursor_col;                         // Current cursor column
     float cursor_timer;                     // Cursor internal timer for animations
     float cursor_alpha;                     // Current cursor alpha
     float cursor_blink_duration;            // Duration of cursor blink
     float cursor_cooldown;                  // Time until blink effect begins
+    float cursor_idle_time;                 // Time spent blinking since the last input
 
     int cursor_margin_lines_y;               // Number of lines that must always remain in view
                                              // below the cursor
 
     bool is_selecting;
-    int selection_start_line;
+    size_t selection_start_line;
     int selection_start_col;
-    int selection_end_line;
+    size_t selection_end_line;
     int selection_end_col;
 
     bool text_changed;                      // Whether text has changed since
                                             // the last frame
 
     bool is_saved;                          // Whether file is currently saved
+    bool is_focused;                        // Whether the window has input focus,
+                                            // the cursor only blinks if it does
     //bool needs_save_check;                  // Whether a save check needs to be 
                                             // performed
 
     char current_file[MAX_FILENAME_LENGTH]; // Current file name
 
+    FontHandle font_handle;                 // Handle of the current font
     TTF_Font* current_font;                 // Current font
+    int font_size;                          // Pixel size text is drawn at
+    int atlas_prewarm;                      // Zoom steps whose atlases are still to be
+                                            // prewarmed, bit 0 smaller and bit 1 larger
+    bool sdf_text;                          // Whether text is drawn from the font's
+                                            // distance field, at any size
+    SdfFont* sdf;                           // Distance field font, if sdf_text
+    AdvanceCache advances;                  // Column x positions of lines measured
+                                            // with the current font
+    int text_origin_x;                      // x of column 0 within the viewport
+                                            // (before horizontal scroll)
+    int gutter_digits;                      // Digits the gutter is sized for,
+                                            // 0 to resize it next frame
+    int line_number_width;                  // Width of the widest line number
 
+    int viewport_x;                         // Position of the viewport in the window,
+    int viewport_y;                         // used to map mouse positions
     int viewport_width;
     int viewport_height;                    // Height of the viewport in which the 
                                             // editor is rendered
@@ -66,6 +117,13 @@ static void set_current_filename(Editor* e, const char* filename)
     e->current_file[MAX_FILENAME_LENGTH-1] = '\0';
 }
 
+/**
+ * Creates a heap allocated editor
+ * 
+ * @return Pointer to the editor state, or NULL on error
+ */
+Editor* editor_create(void);
+
 /**
  * Initialises the editor
  * 
@@ -73,13 +131,40 @@ static void set_current_filename(Editor* e, const char* filename)
  */
 void editor_init(Editor* e);
 
+/**
+ * Cleanup, destroys the editor and frees all memory it owns
+ * 
+ * @param e Pointer to the editor state
+ */
+void editor_destroy(Editor* e);
+
 /**
  * Updates the editor state
  * 
  * @param e Pointer to the editor state
  * @param delta_time Time in seconds since the last frame
+ * 
+ * @return Whether anything visible changed
+ */
+bool editor_update(Editor* e, float delta_time);
+
+/**
+ * Tells the editor when it next needs updating, so the app can sleep until then
+ * 
+ * @param e Pointer to the editor state
+ * 
+ * @return Milliseconds until the next update, 0 to update every frame
+ *         (animating), or -1 if nothing will change without input
+ */
+int editor_next_update_ms(Editor* e);
+
+/**
+ * Sets whether the editor has input focus
+ * 
+ * @param e Pointer to the editor state
+ * @param focused Whether the window has input focus
  */
-void editor_update(Editor* e, float delta_time);
+void editor_set_focused(Editor* e, bool focused);
 
 /**
  * Loads the contents of a given file into the editor
@@ -92,11 +177,16 @@ void editor_update(Editor* e, float delta_time);
 int editor_load_file(Editor* e, const char* filename);
 
 /**
- * Saves the contents of the current editor file
+ * @return Whether the current file is still being loaded in the background
+ */
+bool editor_is_loading(Editor* e);
+
+/**
+ * Starts saving the contents of the current editor file in the background
  * 
  * @param e Pointer to the editor state
  * 
- * @return Success code
+ * @return Success code (whether the save was started)
  */
 int editor_save_file(Editor* e);
 
@@ -107,7 +197,7 @@ int editor_save_file(Editor* e);
  * 
  * @return Whether file is saved
  * 
- * @note This function has been updated to use a memory cache of the original file
+ * @note Compares the text buffer's content hash against that of the text on disk
  */
 bool editor_is_file_saved(Editor* e);
 
@@ -126,17 +216,41 @@ void editor_insert_char(Editor* e, char c);
  */
 void editor_backspace(Editor* e);
 
+/**
+ * Reverts the last edit (or run of typing)
+ * 
+ * @param e Pointer to the editor state
+ */
+void editor_undo(Editor* e);
+
+/**
+ * Re-applies the last undone edit
+ * 
+ * @param e Pointer to the editor state
+ */
+void editor_redo(Editor* e);
+
 /**
  * Handles key inputs
  * 
  * @param e Pointer to the editor state
  * @param key Inputted key
  * 
+ * @return Whether the key did anything, i.e. the editor needs drawing
+ * 
  * @note The key is taken as an int, assumed converted from framework's keycode
  */
-void editor_handle_key(Editor* e, kKeycode key, kKeymod mod); // Assume input convert SDL keycode to int
+bool editor_handle_key(Editor* e, kKeycode key, kKeymod mod); // Assume input convert SDL keycode to int
 
-void editor_handle_mouse_down(Editor* e, kMouseButtonEvent btn);
+/**
+ * Places the cursor where the text area was clicked
+ * 
+ * @param e Pointer to the editor state
+ * @param btn Mouse button event
+ * 
+ * @return Whether the click moved the cursor, i.e. the editor needs drawing
+ */
+bool editor_handle_mouse_down(Editor* e, kMouseButtonEvent btn);
 
 void editor_handle_mouse_motion(Editor* e);
 
@@ -145,8 +259,10 @@ void editor_handle_mouse_motion(Editor* e);
  * 
  * @param e Pointer to the editor state
  * @param wheel_y The vertical scroll amount
+ * 
+ * @return Whether the view scrolled
  */
-void editor_handle_scroll(Editor* e, kMouseWheelEvent wheel);
+bool editor_handle_scroll(Editor* e, kMouseWheelEvent wheel);
 
 /**
  * Renders the editor
@@ -0,0 +1,88 @@
+/**
+ * Background file loading.
+ *
+ * Opening a file only maps it; splitting it into lines is the slow part
+ * (it touches every page of the file). A FileLoader scans the text for
+ * newlines on a worker thread in TEXT_BUFFER_INDEX_CHUNK sized chunks and
+ * queues the line lengths and hashes it finds. The UI thread drains the
+ * queue into the text buffer each frame, so the first screen can be drawn
+ * as soon as the first chunk is done.
+ *
+ * The scanned text must not change or be unmapped while the loader runs.
+ */
+
+#pragma once
+
+#include <SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "text_buffer.h"
+
+#define FILE_LOADER_POLL_BUDGET_MS 4 // Time spent applying queued lines per poll
+
+typedef struct FileLoaderBatch FileLoaderBatch;
+
+struct FileLoaderBatch {
+    FileLoaderBatch* next;
+    size_t scanned;             // Bytes of text covered by this batch
+    size_t count;               // Complete lines found
+    uint64_t tail_hash;         // Hash of the unfinished line at the end of the batch
+    uint64_t* hashes;           // Hash of each line, stored after lengths
+    uint32_t lengths[];         // Length of each line, including its '\n'
+};
+
+typedef struct {
+    const char* data;           // Text being scanned
+    size_t length;
+
+    SDL_Thread* thread;
+    SDL_mutex* lock;
+    SDL_atomic_t cancel;        // Set to stop the worker early
+
+    // Guarded by lock
+    FileLoaderBatch* queue_head;
+    FileLoaderBatch* queue_tail;
+    bool finished;              // Worker has queued its last batch
+
+    // UI thread only
+    FileLoaderBatch* pending;   // Batches taken from the queue but not yet applied
+    FileLoaderBatch* pending_tail;
+    size_t applied;             // Bytes applied to the text buffer
+    bool failed;                // A batch did not match the buffer, loading was stopped
+    Uint32 start_ticks;
+} FileLoader;
+
+/**
+ * Starts scanning text for lines on a worker thread.
+ *
+ * @param data Text to scan, usually the text buffer's original text
+ * @param length Length of the text in bytes
+ *
+ * @return Pointer to the loader, or NULL on error
+ */
+FileLoader* file_loader_create(const char* data, size_t length);
+
+/**
+ * Stops the worker (if still running) and frees the loader.
+ *
+ * @param fl Pointer to the loader
+ */
+void file_loader_destroy(FileLoader* fl);
+
+/**
+ * Applies lines found so far to a text buffer, spending at most
+ * FILE_LOADER_POLL_BUDGET_MS doing so.
+ *
+ * @param fl Pointer to the loader
+ * @param tb Text buffer whose original text is being scanned
+ *
+ * @return Whether loading is over: every line has been applied, or a batch
+ *         did not match the buffer and the rest is left to on demand indexing
+ */
+bool file_loader_poll(FileLoader* fl, TextBuffer* tb);
+
+/**
+ * @return Fraction of the text applied to the buffer so far, in [0, 1]
+ */
+float file_loader_progress(FileLoader* fl);
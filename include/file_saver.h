@@ -0,0 +1,80 @@
+/**
+ * Saving text buffers to disk.
+ *
+ * A save takes a snapshot of the buffer (its span list, not its text) and
+ * writes it on a background thread, so editing can continue meanwhile.
+ * Spans are streamed into large gathered writes (small spans, e.g. typed
+ * text, are copied into a staging buffer first so batches stay large).
+ * Data goes to a temporary file next to the target which is flushed and
+ * then renamed over it, so a crash mid-save never leaves a half-written
+ * file behind.
+ *
+ * Where mapped files cannot be replaced (KFILE_MAPPED_FILES_LOCKED), the
+ * worker also copies the buffer's mapped original text and leaves the
+ * rename to file_saver_finish, which hands the copy to the buffer first.
+ */
+
+#pragma once
+
+#include <SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "text_buffer.h"
+#include "kFile.h"
+
+#define FILE_SAVER_STAGING_SIZE (1024 * 1024) // Bytes of small spans gathered per batch
+#define FILE_SAVER_SMALL_SPAN   4096          // Spans smaller than this are copied
+
+typedef struct {
+    size_t bytes;           // Bytes written
+    double seconds;         // Time taken, including flushing to disk
+    uint64_t generation;    // Edit generation of the text that was saved
+    uint64_t hash;          // Content hash of the text that was saved
+} FileSaveStats;
+
+typedef struct {
+    TextBufferSnapshot snapshot;
+    char* path;
+    const char* original;   // Mapped original text to copy before replacing the file, or NULL
+    size_t original_length;
+
+    SDL_Thread* thread;
+    SDL_atomic_t done;      // Set by the writer once finished
+
+    // Written by the writer thread, read once done is set
+    int result;
+    FileSaveStats stats;
+    kFileWriter writer;
+    bool commit_pending;    // Written and flushed, the rename is left to file_saver_finish
+    char* original_copy;    // Copy of original, handed to the buffer by file_saver_finish
+} FileSaver;
+
+/**
+ * Snapshots a text buffer and starts writing it to a file on a worker thread.
+ *
+ * @param tb Pointer to the buffer
+ * @param path Path of the file to replace
+ *
+ * @return Pointer to the saver, or NULL on error
+ *
+ * @note The buffer may keep being edited, but must not be loaded or rebased
+ *       until the save has finished
+ */
+FileSaver* file_saver_start(TextBuffer* tb, const char* path);
+
+/**
+ * @return Whether the writer has finished
+ */
+bool file_saver_is_done(FileSaver* fs);
+
+/**
+ * Waits for the writer to finish, replaces the file if that was left to
+ * this call, and frees the saver.
+ *
+ * @param fs Pointer to the saver
+ * @param tb Buffer the save was started from
+ * @param stats Filled with the size, duration and generation of the save, may be NULL
+ *
+ * @return Success code of the save
+ */
+int file_saver_finish(FileSaver* fs, TextBuffer* tb, FileSaveStats* stats);
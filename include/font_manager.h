@@ -1,12 +1,95 @@
 #pragma once
 
+#include <SDL.h>
 #include <SDL_ttf.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "kFile.h"
+#include "sdf_font.h"
+
+#define FONT_DEFAULT_PATH "resources/fonts/SourceCodePro-Bold.ttf"
+
+#define FONT_HANDLE_INVALID -1
+
+#define FONT_PREWARM_QUEUE 8        // Most sizes waiting to be opened in the background
+#define FONT_PREWARM_FIRST_GLYPH 32 // Glyphs prepared ahead of use
+#define FONT_PREWARM_LAST_GLYPH 126
+
+/**
+ * Stable handle of a loaded font (path and size). Handles stay valid until
+ * the font manager is destroyed, so callers can look fonts up once and keep
+ * the handle.
+ */
+typedef int FontHandle;
+
+typedef struct {
+    TTF_Font* font;     // NULL if the font failed to load
+    int size;
+    int path;           // Index of the interned path
+} FontEntry;
+
+typedef struct {
+    char* path;
+    kFileMap map;       // Contents every size of the font is opened from
+    bool mapped;
+    bool map_failed;    // Sizes are then opened from the path
+    uint64_t hash;      // Hash of the mapped contents, 0 if not mapped
+    SdfFont* sdf;       // Distance field font, created on first use
+} FontFile;
+
+/**
+ * Where a font can be opened from by another thread, which needs its own
+ * TTF_Font since SDL_ttf fonts are not thread safe. Stays valid until the
+ * font manager is destroyed.
+ */
+typedef struct {
+    const char* path;   // Interned path
+    const char* data;   // Mapped font file, NULL to open from the path
+    size_t length;
+    int size;
+} FontSource;
+
+typedef struct {
+    int path;           // Index of the interned path
+    const char* path_name;
+    int size;
+    const char* data;   // Mapped font file, NULL to open from the path
+    size_t length;
+    TTF_Font* font;     // Set once opened
+} FontPrewarm;
 
 typedef struct {
-    TTF_Font** fonts;   // Currently loaded fonts
-    int* sizes;         // Currently loaded sizes
-    char** paths;       // Currently loaded font paths
-    size_t count;       // Total loaded fonts
+    FontEntry* entries; // Loaded fonts, indexed by handle
+    int count;          // Total loaded fonts
+    int capacity;
+
+    FontFile* paths;    // Interned font paths
+    int path_count;
+    int path_capacity;
+
+    // Open addressing hash tables of indices, -1 for an empty slot
+    int* path_table;    // Path -> path index
+    int path_table_size;
+    int* font_table;    // (path, size) -> handle
+    int* pointer_table; // TTF_Font* -> handle
+    int font_table_size;
+
+    // Background opening of sizes about to be used
+    SDL_Thread* worker;
+    SDL_mutex* open_lock;   // Serialises opening and closing fonts, FreeType
+                            // faces share one library
+    SDL_mutex* lock;
+    SDL_cond* wake;         // Signalled when a request is queued or on stop
+    SDL_cond* done;         // Signalled when a request has been opened
+
+    // Guarded by lock
+    FontPrewarm requests[FONT_PREWARM_QUEUE];
+    int request_count;
+    FontPrewarm working;    // Request being opened by the worker
+    bool busy;
+    FontPrewarm ready[FONT_PREWARM_QUEUE];
+    int ready_count;
+    bool stop;
 } FontManager;
 
 /**
@@ -16,6 +99,109 @@ typedef struct {
  */
 FontManager* font_manager_get();
 
+/**
+ * Loads a font (if not already loaded) and returns its handle.
+ * A font that failed to load is remembered and not retried.
+ * 
+ * Each font file is mapped once and every size is opened from that memory,
+ * a size already opened in the background is taken as is.
+ * 
+ * @param path Path to the font
+ * @param size Font size
+ * 
+ * @return Handle of the font, or FONT_HANDLE_INVALID if it failed to load
+ */
+FontHandle font_manager_load(const char* path, int size);
+
+/**
+ * Retrieves the distance field font of a font file, which draws every size
+ * from one set of glyphs. Only SDF_FONT_BASE_SIZE is ever opened for it.
+ * 
+ * @param path Path to the font
+ * 
+ * @return Distance field font, or NULL if the font failed to load
+ */
+SdfFont* font_manager_sdf(const char* path);
+
+/**
+ * Queues a font to be opened and have its ASCII glyphs measured on a
+ * worker thread, so a later font_manager_load of it does not stall a frame.
+ * Does nothing if the font is already loaded or queued, or the queue is full.
+ * Glyph pixels are not rendered here, see renderer_prewarm_atlas.
+ * 
+ * @param path Path to the font
+ * @param size Font size
+ */
+void font_manager_prewarm(const char* path, int size);
+
+/**
+ * Retrieves a font only if it is already open, e.g. once a prewarm of it
+ * has finished. Never opens the font itself.
+ * 
+ * @param path Path to the font
+ * @param size Font size
+ * 
+ * @return SDL TTF font, or NULL if it is not open (yet) or failed to load
+ */
+TTF_Font* font_manager_peek(const char* path, int size);
+
+/**
+ * @return SDL TTF font of a handle, or NULL if the handle is invalid
+ */
+TTF_Font* font_manager_font(FontHandle handle);
+
+/**
+ * @return Size of a handle's font, or -1 if the handle is invalid
+ */
+int font_manager_size(FontHandle handle);
+
+/**
+ * @return Path of a handle's font, or NULL if the handle is invalid
+ */
+const char* font_manager_path(FontHandle handle);
+
+/**
+ * @return Hash of the contents of a handle's font file, or 0 if unknown
+ */
+uint64_t font_manager_file_hash(FontHandle handle);
+
+/**
+ * Describes where a handle's font is opened from, so another thread can
+ * open a copy of it.
+ * 
+ * @param handle Font handle
+ * @param source Filled in with the font's file and size
+ * 
+ * @return Whether the handle is valid
+ */
+bool font_manager_source(FontHandle handle, FontSource* source);
+
+/**
+ * Opens a private copy of a font, from any thread. The copy is not indexed,
+ * its opener closes it with font_manager_close_font.
+ * 
+ * @param source Where to open the font from
+ * 
+ * @return SDL TTF font, or NULL on error
+ */
+TTF_Font* font_manager_open_source(const FontSource* source);
+
+/**
+ * Closes a font opened with font_manager_open_source, from any thread.
+ * 
+ * @param font SDL TTF font
+ */
+void font_manager_close_font(TTF_Font* font);
+
+/**
+ * Finds the handle of a loaded SDL TTF font.
+ * 
+ * @param font SDL TTF font
+ * 
+ * @return Handle of the font, or FONT_HANDLE_INVALID if it was not loaded here
+ */
+FontHandle font_manager_find(TTF_Font* font);
+
 /**
  * Attempts to load a given font (if not already loaded).
  * 
@@ -49,7 +235,7 @@ const char* font_manager_get_font_path(TTF_Font* font);
  * 
  * @param font SDL TTF font to get size for
  * 
- * @return Size of the font or NULL if failed
+ * @return Size of the font or -1 if failed
  */
 int font_manager_get_font_size(TTF_Font* font);
 
@@ -57,4 +243,4 @@ int font_manager_get_font_size(TTF_Font* font);
  * Destroy and cleanup of font manager.
  * Frees memory tied to font, path, size lists.
  */
-void font_manager_destroy();
\ No newline at end of file
+void font_manager_destroy();
@@ -0,0 +1,191 @@
+/**
+ * Glyph atlas.
+ *
+ * Each glyph of a font is rasterized once, in white, into a shared texture
+ * page and drawn from there as a textured quad, tinted through its vertex
+ * colour. Text is drawn one byte per glyph (Latin-1, like TTF_RenderText),
+ * so glyphs are looked up in a flat table.
+ *
+ * Pages are packed shelf by shelf; a new page is added when one fills up.
+ *
+ * An atlas can also be filled from a distance field font at any size, its
+ * glyphs are then resampled from the fields instead of rasterized.
+ *
+ * The coverage of every page is also kept in memory, so whole lines can be
+ * composed from glyphs already rasterized and atlases can be saved to the
+ * atlas cache.
+ *
+ * Given a raster pool, glyphs are rasterized on its workers instead: a new
+ * glyph gets its metrics at once but draws nothing until its pixels are
+ * handed back with glyph_atlas_complete.
+ */
+
+#pragma once
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdf_font.h"
+#include "raster_pool.h"
+
+#define GLYPH_ATLAS_PAGE_SIZE 512  // Width and height of each texture page
+#define GLYPH_ATLAS_MAX_PAGES 16
+#define GLYPH_ATLAS_GLYPHS    256  // One per Latin-1 character
+
+typedef struct {
+    bool loaded;            // Whether the glyph has been rasterized yet
+    bool pending;           // Loaded, but its pixels are still being rasterized
+    int page;               // Page holding the glyph, -1 if it has no pixels
+    SDL_Rect src;           // Glyph pixels within the page
+    int offset_x;           // Where the pixels start relative to the pen position
+    int advance;            // Pen movement after the glyph
+} AtlasGlyph;
+
+typedef struct {
+    TTF_Font* font;         // NULL when drawn from a distance field font
+    SdfFont* sdf;
+    int size;               // Pixel size of the font
+    uint64_t font_hash;     // Hash of the font file, 0 if it cannot be cached
+    bool dirty;             // Whether glyphs were added since it was created
+                            // or restored from the atlas cache
+    SDL_Renderer* renderer;
+    int height;             // Font height, every glyph is this tall
+    bool kerning;           // Whether glyph pairs need kerning applied
+    int digit_width;        // Widest advance of '0'-'9', 0 until measured
+
+    RasterPool* pool;       // Rasterizes glyphs off the UI thread if set
+    FontSource source;      // Font the pool opens its copies from
+    int pending_count;      // Glyphs waiting for the pool
+
+    SDL_Texture* pages[GLYPH_ATLAS_MAX_PAGES];
+    Uint8* page_alpha[GLYPH_ATLAS_MAX_PAGES];   // Coverage of each page
+    int page_count;
+    int shelf_x;            // Next free position on the current shelf
+    int shelf_y;
+    int shelf_height;
+
+    AtlasGlyph glyphs[GLYPH_ATLAS_GLYPHS];
+} GlyphAtlas;
+
+/**
+ * Creates an empty atlas for a font. Glyphs are rasterized on first use.
+ *
+ * @param renderer Renderer owning the atlas textures
+ * @param font Font to rasterize
+ *
+ * @return Pointer to the atlas, or NULL on error
+ */
+GlyphAtlas* glyph_atlas_create(SDL_Renderer* renderer, TTF_Font* font);
+
+/**
+ * Creates an empty atlas drawing a distance field font at a pixel size.
+ * Glyphs are resampled on first use.
+ *
+ * @param renderer Renderer owning the atlas textures
+ * @param sdf Distance field font
+ * @param size Pixel size
+ *
+ * @return Pointer to the atlas, or NULL on error
+ */
+GlyphAtlas* glyph_atlas_create_sdf(SDL_Renderer* renderer, SdfFont* sdf, int size);
+
+/**
+ * Frees the atlas and its textures.
+ *
+ * @param atlas Pointer to the atlas
+ */
+void glyph_atlas_destroy(GlyphAtlas* atlas);
+
+/**
+ * Creates every page texture again from the coverage kept in memory, after
+ * the renderer lost its textures (SDL_RENDER_DEVICE_RESET).
+ *
+ * @param atlas Pointer to the atlas
+ *
+ * @return Whether every page was restored
+ */
+bool glyph_atlas_reload(GlyphAtlas* atlas);
+
+/**
+ * Has new glyphs of a font atlas rasterized by a raster pool. Jobs are
+ * submitted with the atlas as their owner.
+ *
+ * @param atlas Pointer to the atlas
+ * @param pool Raster pool, NULL to rasterize on the calling thread again
+ * @param source Where the pool opens the atlas's font from
+ */
+void glyph_atlas_set_pool(GlyphAtlas* atlas, RasterPool* pool, const FontSource* source);
+
+/**
+ * Stores the pixels of a glyph rasterized by the raster pool.
+ *
+ * @param atlas Pointer to the atlas
+ * @param c Character (Latin-1)
+ * @param surface White ARGB8888 glyph, NULL if rasterizing it failed
+ *
+ * @return Whether the glyph was waiting for its pixels
+ */
+bool glyph_atlas_complete(GlyphAtlas* atlas, unsigned char c, SDL_Surface* surface);
+
+/**
+ * Adds a page holding previously rasterized glyphs, e.g. from the atlas
+ * cache. The caller fills in the glyphs and shelf position.
+ *
+ * @param atlas Pointer to the atlas
+ * @param alpha Coverage of the page's top rows, GLYPH_ATLAS_PAGE_SIZE wide
+ * @param rows Rows of coverage given, the rest of the page starts empty
+ *
+ * @return Whether the page was added
+ */
+bool glyph_atlas_upload_page(GlyphAtlas* atlas, const Uint8* alpha, int rows);
+
+/**
+ * Retrieves a glyph, rasterizing it into the atlas if needed. With a raster
+ * pool a new glyph is only queued, it has no pixels (page -1) until then.
+ *
+ * @param atlas Pointer to the atlas
+ * @param c Character (Latin-1)
+ *
+ * @return Pointer to the glyph
+ */
+const AtlasGlyph* glyph_atlas_get(GlyphAtlas* atlas, unsigned char c);
+
+/**
+ * @return Kerning adjustment between two consecutive characters, in pixels
+ */
+int glyph_atlas_kerning(GlyphAtlas* atlas, unsigned char prev, unsigned char c);
+
+/**
+ * @return Width of a digit cell, numbers are laid out on a grid of these
+ *         so they line up whatever the font's digits look like
+ */
+int glyph_atlas_digit_width(GlyphAtlas* atlas);
+
+/**
+ * Measures the width of text as drawn from the atlas.
+ *
+ * @param atlas Pointer to the atlas
+ * @param text Text to measure
+ * @param length Length of the text in bytes
+ *
+ * @return Width in pixels
+ */
+int glyph_atlas_measure(GlyphAtlas* atlas, const char* text, size_t length);
+
+/**
+ * Composes text into a surface from the atlas's glyphs, the way
+ * TTF_RenderText_Blended would draw it. Only glyphs never drawn before are
+ * rasterized. Fails while any of its glyphs is pending, rather than leave
+ * them out.
+ *
+ * @param atlas Pointer to the atlas
+ * @param text Text to render
+ * @param length Length of the text in bytes
+ * @param color Colour of the text
+ *
+ * @return ARGB8888 surface as tall as the font, or NULL on error or if a
+ *         glyph is pending
+ */
+SDL_Surface* glyph_atlas_render_text(GlyphAtlas* atlas, const char* text, size_t length, SDL_Color color);
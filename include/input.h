@@ -4,27 +4,26 @@
 #include "kEvents.h"
 #include "editor.h"
 
-void input_handle_event(Editor* e, kEvent* ev)
+// Returns whether the event changed anything drawn
+bool input_handle_event(Editor* e, kEvent* ev)
 {
     switch (ev->type)
     {
         case KEVENT_MOUSEBUTTONDOWN:
-            editor_handle_mouse_down(e, ev->button); 
-            break;
+            return editor_handle_mouse_down(e, ev->button); 
 
         case KEVENT_MOUSEMOTION:
-            break;
+            return false;
 
         case KEVENT_KEYDOWN:
-            editor_handle_key(e, ev->key.sym, ev->key.mod);
-            break;
+            return editor_handle_key(e, ev->key.sym, ev->key.mod);
 
         case KEVENT_MOUSEWHEEL:
-            editor_handle_scroll(e, ev->wheel);
-            break;
+            return editor_handle_scroll(e, ev->wheel);
         
         case KEVENT_TEXTINPUT:
             editor_insert_char(e, ev->text.text[0]);
-            break;
+            return true;
     }
+    return false;
 }
\ No newline at end of file
@@ -0,0 +1,135 @@
+/**
+ * Crash-recovery journal.
+ *
+ * Every edit made to a file is appended as a small binary record to a
+ * journal next to it (<file>.kswp), relative to the text last saved. Records
+ * are queued in memory and a worker thread writes and syncs them to disk
+ * JOURNAL_FLUSH_INTERVAL_MS after the first one is queued, so typing never
+ * waits on the disk. With nothing queued the worker sleeps.
+ *
+ * When the file is opened again and a journal for the same saved text is
+ * found, its records are replayed onto the buffer. A torn record at the end
+ * of the journal (the process died mid-write) ends the replay.
+ *
+ * File layout (native byte order):
+ *   header: "KSWP", u32 version, u64 base length, u64 base hash
+ *   record: u8 type, u64 offset, u64 length, [length bytes of text for
+ *           inserts], u32 checksum of the preceding record bytes
+ */
+
+#pragma once
+
+#include <SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "text_buffer.h"
+#include "file_saver.h"
+#include "kFile.h"
+
+#define JOURNAL_SUFFIX            ".kswp"
+#define JOURNAL_FLUSH_INTERVAL_MS 500 // Most time an edit spends only in memory
+#define JOURNAL_VERSION           1
+#define JOURNAL_HEADER_SIZE       24
+#define JOURNAL_RECORD_HEADER     17 // type + offset + length
+#define JOURNAL_CHECKSUM_SIZE     4
+
+typedef struct {
+    size_t records;         // Edits replayed
+    size_t bytes;           // Size of the valid part of the journal
+    double seconds;         // Time taken to read and replay it
+} JournalReplayStats;
+
+typedef struct {
+    char* path;
+    kFileAppender file;     // Writer thread only once started
+
+    SDL_Thread* thread;
+    SDL_mutex* lock;
+    SDL_cond* wake;         // Signalled to flush early, e.g. when closing
+
+    // Guarded by lock
+    char* pending;          // Records not yet handed to the writer
+    size_t pending_length;
+    size_t pending_capacity;
+    bool rewrite;           // Start the file over with header before pending
+    char header[JOURNAL_HEADER_SIZE];
+    bool stop;
+    size_t flushes;         // Batches written and synced
+    size_t written;         // Bytes written to the file, including the header
+
+    // UI thread only
+    bool saving;            // Whether records are being kept for rebase
+    char* since_save;       // Records made since the save started
+    size_t since_save_length;
+    size_t since_save_capacity;
+} Journal;
+
+/**
+ * Replays the journal of a file onto its freshly loaded text, if there is one
+ * for that exact text.
+ *
+ * @param file_path Path of the edited file (not the journal)
+ * @param tb Buffer holding the file's text, fully indexed
+ * @param stats Filled with what was replayed, may be NULL
+ *
+ * @return Whether a journal was replayed
+ */
+bool journal_replay(const char* file_path, TextBuffer* tb, JournalReplayStats* stats);
+
+/**
+ * Opens the journal of a file and starts its writer thread.
+ *
+ * @param file_path Path of the edited file (not the journal)
+ * @param base_length Length of the saved text the edits apply to
+ * @param base_hash Content hash of the saved text
+ * @param keep Bytes of an existing journal to keep (as returned by
+ *             journal_replay), 0 to start a new one
+ *
+ * @return Pointer to the journal, or NULL on error
+ */
+Journal* journal_open(const char* file_path, size_t base_length, uint64_t base_hash, size_t keep);
+
+/**
+ * Writes any queued records, stops the writer and frees the journal.
+ *
+ * @param j Pointer to the journal (NULL is ignored)
+ * @param remove_file Whether to delete the journal file, i.e. nothing needs recovering
+ */
+void journal_close(Journal* j, bool remove_file);
+
+/**
+ * Records an insertion.
+ *
+ * @param j Pointer to the journal
+ * @param offset Insertion offset
+ * @param text Inserted text
+ * @param length Length of the text
+ */
+void journal_record_insert(Journal* j, size_t offset, const char* text, size_t length);
+
+/**
+ * Records a deletion.
+ *
+ * @param j Pointer to the journal
+ * @param offset Offset of the deleted range
+ * @param length Length of the deleted range
+ */
+void journal_record_delete(Journal* j, size_t offset, size_t length);
+
+/**
+ * Marks the point a save snapshot was taken at. Records made from here on
+ * are kept until journal_end_save.
+ *
+ * @param j Pointer to the journal
+ */
+void journal_begin_save(Journal* j);
+
+/**
+ * Restarts the journal relative to the text just saved, keeping only the
+ * records made since journal_begin_save.
+ *
+ * @param j Pointer to the journal
+ * @param stats Stats of the save, NULL if it failed (the journal is unchanged)
+ */
+void journal_end_save(Journal* j, const FileSaveStats* stats);
@@ -11,7 +11,9 @@ typedef enum {
     KEVENT_MOUSEBUTTONUP,
     KEVENT_MOUSEMOTION,
     KEVENT_MOUSEWHEEL,
-    KEVENT_TEXTINPUT
+    KEVENT_TEXTINPUT,
+    KEVENT_WINDOW,      // Window shown, exposed, resized, focused etc.
+    KEVENT_RENDER_RESET // Render target contents, or every texture, were lost
 } kEventType;
 
 typedef enum {
@@ -108,8 +110,15 @@ typedef struct {
         struct {
             char text[KTEXTINPUTEVENT_TEXT_SIZE];
         } text;
+
+        struct {
+            int device_lost; // Every texture must be recreated, not only redrawn
+        } reset;
     };
 } kEvent;
 
 // Event poll function
 int kPollEvent(kEvent* ev);
+
+// Waits up to timeout_ms for an event (forever if negative), returns 0 on timeout
+int kWaitEventTimeout(kEvent* ev, int timeout_ms);
@@ -0,0 +1,170 @@
+/**
+ * Platform file helpers.
+ *
+ * Wraps the OS specific calls needed for read-only file mappings, atomic
+ * file replacement and append-only files so the rest of the editor can stay
+ * platform agnostic. Windows uses file mapping objects and MoveFileEx, everything
+ * else uses mmap, writev and rename.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define KFILE_MAX_SPANS 1024    // Most spans written by one kFileWriter_write call
+
+#ifdef _WIN32
+    #define KFILE_MAPPED_FILES_LOCKED 1 // Mapped files cannot be replaced
+#else
+    #define KFILE_MAPPED_FILES_LOCKED 0
+#endif
+
+typedef struct {
+    const char* data;       // Start of the mapped file (NULL for empty files)
+    size_t size;            // Size of the mapping in bytes
+#ifdef _WIN32
+    void* file;             // File HANDLE
+    void* mapping;          // File mapping HANDLE
+#endif
+} kFileMap;
+
+/**
+ * Maps a file into memory, read-only.
+ *
+ * @param map Pointer to the mapping to initialise
+ * @param path Path of the file to map
+ *
+ * @return Whether the file was mapped
+ *
+ * @note Empty files succeed with a NULL data pointer
+ */
+bool kFileMap_open(kFileMap* map, const char* path);
+
+/**
+ * Unmaps a file previously mapped with kFileMap_open.
+ *
+ * @param map Pointer to the mapping
+ */
+void kFileMap_close(kFileMap* map);
+
+typedef struct {
+    const void* data;
+    size_t size;
+} kFileSpan;
+
+typedef struct {
+    char* path;             // File being replaced
+    char* temp_path;        // File being written, next to path
+#ifdef _WIN32
+    void* file;             // File HANDLE
+#else
+    int fd;
+#endif
+    size_t written;         // Bytes written so far
+} kFileWriter;
+
+/**
+ * Starts replacing a file. Data is written to a temporary file in the same
+ * directory, which only replaces the file once committed.
+ *
+ * @param w Pointer to the writer to initialise
+ * @param path Path of the file to replace (it need not exist yet)
+ *
+ * @return Whether the temporary file was created
+ */
+bool kFileWriter_open(kFileWriter* w, const char* path);
+
+/**
+ * Writes spans of data in order, with as few system calls as possible.
+ *
+ * @param w Pointer to the writer
+ * @param spans Spans to write
+ * @param count Number of spans (at most KFILE_MAX_SPANS)
+ *
+ * @return Whether everything was written
+ */
+bool kFileWriter_write(kFileWriter* w, const kFileSpan* spans, int count);
+
+/**
+ * Flushes the written data to disk without replacing the file yet, so a
+ * later commit has little left to wait for.
+ *
+ * @param w Pointer to the writer
+ *
+ * @return Whether the data reached the disk
+ */
+bool kFileWriter_flush(kFileWriter* w);
+
+/**
+ * Flushes the written data to disk and atomically replaces the file with it.
+ * The writer is closed either way.
+ *
+ * @param w Pointer to the writer
+ *
+ * @return Whether the file was replaced
+ */
+bool kFileWriter_commit(kFileWriter* w);
+
+/**
+ * Closes the writer and removes the temporary file, leaving the file untouched.
+ *
+ * @param w Pointer to the writer
+ */
+void kFileWriter_abort(kFileWriter* w);
+
+typedef struct {
+#ifdef _WIN32
+    void* file;             // File HANDLE
+#else
+    int fd;
+#endif
+} kFileAppender;
+
+/**
+ * Opens a file for appending, creating it if needed. Writes go to the end of
+ * the file.
+ *
+ * @param a Pointer to the appender to initialise
+ * @param path Path of the file
+ *
+ * @return Whether the file was opened
+ */
+bool kFileAppender_open(kFileAppender* a, const char* path);
+
+/**
+ * Writes data at the end of the file.
+ *
+ * @param a Pointer to the appender
+ * @param data Data to write
+ * @param size Number of bytes to write
+ *
+ * @return Whether everything was written
+ */
+bool kFileAppender_write(kFileAppender* a, const void* data, size_t size);
+
+/**
+ * Cuts the file down to a size, later writes continue from there.
+ *
+ * @param a Pointer to the appender
+ * @param size New size of the file in bytes
+ *
+ * @return Whether the file was truncated
+ */
+bool kFileAppender_truncate(kFileAppender* a, size_t size);
+
+/**
+ * Flushes everything written so far to disk.
+ *
+ * @param a Pointer to the appender
+ *
+ * @return Whether the data reached the disk
+ */
+bool kFileAppender_sync(kFileAppender* a);
+
+/**
+ * Closes the file.
+ *
+ * @param a Pointer to the appender
+ */
+void kFileAppender_close(kFileAppender* a);
@@ -17,6 +17,7 @@
 #include <stdbool.h>
 #include "renderer.h"
 #include "kEvents.h"
+#include "font_manager.h"
 
 #define FILE_DIALOG_LINE_HEIGHT 30
 #define FILE_DIALOG_PADDING 10
@@ -37,6 +38,8 @@ typedef struct {
     char entries[256][256]; // list of file/dir names
 
     int x, y, w, h;
+
+    FontHandle font;        // Font of the path and entries
 } kFileDialog;
 
 /**
@@ -82,8 +85,10 @@ bool kFileDialog_is_open(kFileDialog* dialog);
  * 
  * @param dialog Pointer to kFileDialog
  * @param event Pointer to SDL event
+ * 
+ * @return Whether the dialog needs drawing
  */
-void kFileDialog_handle_event(kFileDialog* dialog, kEvent* event);
+bool kFileDialog_handle_event(kFileDialog* dialog, kEvent* event);
 
 /**
  * Renders the given dialog.
@@ -40,6 +40,9 @@ typedef struct {
     kWindowButton* window_buttons;      // List of titlebar control buttons
     int num_window_buttons;             // Current number of buttons
     int capacity_window_buttons;        // Current dynamic capacity of buttons
+
+    UiLayer titlebar_layer;             // Titlebar, drawn again when the title,
+                                        // width or a button colour changes
 } kWindow;
 
 /**
@@ -60,6 +63,8 @@ kWindow window_create(const char* title, int x, int y, int w, int h, Uint32 flag
 /**
  * Destroy and cleanup of window and associated allocations.
  * Frees pointers to titlebar controls.
+ * The titlebar layer must be destroyed (ui_layer_destroy) beforehand,
+ * while the renderer still exists.
  * 
  * @param win Pointer to window
  */
@@ -70,8 +75,10 @@ void window_destroy(kWindow* win);
  * 
  * @param win Pointer to window
  * @param dt Time (seconds) since last frame
+ * 
+ * @return Whether anything animated, so the window needs redrawing
  */
-void window_update(kWindow* win, float dt);
+bool window_update(kWindow* win, float dt);
 
 /**
  * Renders the window and associated components.
@@ -95,8 +102,11 @@ void window_add_button(kWindow* win, kWindowButton btn);
  * 
  * @param win Pointer to window
  * @param e Pointer to SDL event
+ * 
+ * @return Whether the window needs drawing, e.g. it was exposed or resized
+ *         or a button's hover changed
  */
-void window_handle_event(kWindow* win, kEvent* e);
+bool window_handle_event(kWindow* win, kEvent* e);
 
 /**
  * Maximises the window
@@ -0,0 +1,119 @@
+/**
+ * Cache of rendered line textures.
+ *
+ * Textures are keyed by the content hash of the text they show, plus the
+ * font and colour it was drawn with, so unchanged lines are never drawn
+ * twice and edited lines simply stop being looked up. The least recently
+ * used textures are evicted once the cache exceeds its memory budget.
+ */
+
+#pragma once
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LINE_CACHE_DEFAULT_BUDGET (32 * 1024 * 1024) // Bytes of texture memory
+
+typedef struct {
+    uint64_t hash;          // Content hash of the text
+    TTF_Font* font;
+    Uint32 color;           // RGBA packed into one value
+} LineCacheKey;
+
+typedef struct {
+    LineCacheKey key;
+    SDL_Texture* texture;
+    int width;
+    int height;
+
+    int prev, next;         // LRU order, most recent first (-1 terminated)
+    int chain;              // Next entry in the same bucket, or next free entry
+} LineCacheEntry;
+
+typedef struct {
+    LineCacheEntry* entries;
+    int entry_count;        // Entries ever used (live or free)
+    int entry_capacity;
+    int free_list;
+
+    int* buckets;           // Hash table of entry indices (-1 terminated chains)
+    int bucket_count;       // Power of two
+
+    int lru_head;           // Most recently used
+    int lru_tail;           // Least recently used
+
+    size_t bytes;           // Texture memory held
+    size_t budget;
+
+    // Counters
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+} LineCache;
+
+/**
+ * Creates an empty cache.
+ *
+ * @param budget Texture memory budget in bytes
+ *
+ * @return Pointer to the cache, or NULL on error
+ */
+LineCache* line_cache_create(size_t budget);
+
+/**
+ * Destroys every cached texture and frees the cache.
+ *
+ * @param c Pointer to the cache
+ */
+void line_cache_destroy(LineCache* c);
+
+/**
+ * Destroys every cached texture, e.g. after the renderer lost them.
+ *
+ * @param c Pointer to the cache
+ */
+void line_cache_clear(LineCache* c);
+
+/**
+ * Changes the memory budget, evicting textures if it shrank.
+ *
+ * @param c Pointer to the cache
+ * @param budget Texture memory budget in bytes
+ */
+void line_cache_set_budget(LineCache* c, size_t budget);
+
+/**
+ * Builds the key of some text.
+ *
+ * @param hash Content hash of the text
+ * @param font Font it is drawn with
+ * @param color Colour it is drawn with
+ */
+LineCacheKey line_cache_key(uint64_t hash, TTF_Font* font, SDL_Color color);
+
+/**
+ * Looks up a texture, marking it as most recently used.
+ *
+ * @param c Pointer to the cache
+ * @param key Key of the text
+ *
+ * @return Pointer to the entry, or NULL on a miss
+ */
+const LineCacheEntry* line_cache_find(LineCache* c, LineCacheKey key);
+
+/**
+ * Adds a texture, evicting the least recently used ones to stay in budget.
+ * The cache takes ownership of the texture.
+ *
+ * @param c Pointer to the cache
+ * @param key Key of the text
+ * @param texture Texture showing the text
+ * @param width Width of the texture
+ * @param height Height of the texture
+ *
+ * @return Pointer to the entry, or NULL on error (the texture is destroyed)
+ */
+const LineCacheEntry* line_cache_insert(LineCache* c, LineCacheKey key, SDL_Texture* texture, int width, int height);
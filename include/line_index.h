@@ -0,0 +1,161 @@
+/**
+ * Balanced index of line lengths.
+ *
+ * Line lengths are stored in fixed-size blocks of LINE_INDEX_BLOCK_SIZE
+ * entries, and the blocks are kept in a treap augmented with subtree line
+ * and byte totals. This answers line -> offset and offset -> line in
+ * O(log n) (plus a bounded scan within one block) and supports splicing
+ * lines in and out anywhere in the document with incremental updates.
+ *
+ * Each line also carries a hash of its contents, and subtrees combine them
+ * into a hash of the whole document (a polynomial over line hashes), so
+ * comparing the document against a known state is O(1).
+ *
+ * Each line's length includes its terminating '\n'; the last line has no
+ * terminator. The index always holds at least one (possibly empty) line.
+ *
+ * @note A single line is limited to LINE_INDEX_MAX_LINE bytes, the
+ *       document as a whole is not.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+
+#define LINE_INDEX_BLOCK_SIZE 512
+#define LINE_INDEX_BLOCK_MIN  (LINE_INDEX_BLOCK_SIZE / 4) // Edited blocks are merged with a neighbour below this
+#define LINE_INDEX_MAX_LINE   UINT32_MAX // Longest line a block can hold, in bytes
+
+#define LINE_INDEX_HASH_BYTE 0x9E3779B97F4A7C15ull // Multiplier between bytes of a line
+#define LINE_INDEX_HASH_LINE 0x00000100000001B3ull // Multiplier between lines
+
+typedef struct LineBlock LineBlock;
+
+struct LineBlock {
+    LineBlock* left;
+    LineBlock* right;
+    unsigned int priority;                      // Treap heap priority
+
+    uint32_t count;                             // Lines held in this block
+    uint32_t lengths[LINE_INDEX_BLOCK_SIZE];    // Length of each line in bytes
+    uint64_t hashes[LINE_INDEX_BLOCK_SIZE];     // Hash of each line's contents
+    size_t bytes;                               // Sum of lengths in this block
+    uint64_t hash;                              // Combined hash of this block's lines
+    uint64_t power;                             // LINE_INDEX_HASH_LINE ^ count
+
+    size_t total_lines;                         // Lines in this subtree
+    size_t total_bytes;                         // Bytes in this subtree
+    uint64_t total_hash;                        // Combined hash of this subtree
+    uint64_t total_power;                       // LINE_INDEX_HASH_LINE ^ total_lines
+};
+
+typedef struct {
+    LineBlock* root;        // Treap of blocks ordered by document position
+    Pool blocks;            // Block storage
+    unsigned int seed;      // PRNG state for treap priorities
+} LineIndex;
+
+/**
+ * Initialises an index holding a single empty line.
+ *
+ * @param li Pointer to the index
+ */
+void line_index_init(LineIndex* li);
+
+/**
+ * Frees all blocks owned by the index.
+ *
+ * @param li Pointer to the index
+ */
+void line_index_destroy(LineIndex* li);
+
+/**
+ * Rebuilds the index from a complete text.
+ *
+ * @param li Pointer to the index
+ * @param text Text to index
+ * @param length Length of the text in bytes
+ */
+void line_index_build(LineIndex* li, const char* text, size_t length);
+
+/**
+ * Extends a line hash with more bytes of the line.
+ *
+ * @param hash Hash of the bytes so far (0 for none)
+ * @param data Bytes to append
+ * @param length Number of bytes
+ *
+ * @return Hash of the bytes so far followed by data
+ */
+uint64_t line_index_hash_bytes(uint64_t hash, const char* data, size_t length);
+
+/**
+ * @return Combined hash of every line's hash, in order
+ */
+uint64_t line_index_hash(LineIndex* li);
+
+/**
+ * @return Hash stored for a line
+ */
+uint64_t line_index_line_hash(LineIndex* li, size_t line);
+
+/**
+ * Updates the hash stored for a line, after its contents changed.
+ *
+ * @param li Pointer to the index
+ * @param line Line to update
+ * @param hash New hash of the line's contents
+ */
+void line_index_set_hash(LineIndex* li, size_t line, uint64_t hash);
+
+/**
+ * @return Number of lines (at least 1)
+ */
+size_t line_index_count(LineIndex* li);
+
+/**
+ * @return Total number of bytes covered by the index
+ */
+size_t line_index_bytes(LineIndex* li);
+
+/**
+ * @return Offset of the first byte of a line
+ */
+size_t line_index_start(LineIndex* li, size_t line);
+
+/**
+ * @return Length of a line in bytes, including its '\n'
+ */
+size_t line_index_length(LineIndex* li, size_t line);
+
+/**
+ * @return Line containing a given offset (the last line for offsets at or past the end)
+ */
+size_t line_index_find(LineIndex* li, size_t offset);
+
+/**
+ * Grows or shrinks a single line without changing the number of lines.
+ * The line's hash is left as is.
+ *
+ * @param li Pointer to the index
+ * @param line Line to resize
+ * @param delta Change in length, in bytes
+ */
+void line_index_resize(LineIndex* li, size_t line, ptrdiff_t delta);
+
+/**
+ * Replaces a run of lines with new ones. The blocks touched are repacked
+ * together with a neighbour if they would end up less than a quarter full.
+ *
+ * @param li Pointer to the index
+ * @param line First line to replace
+ * @param remove_count Number of lines to remove
+ * @param lengths Lengths of the lines to insert in their place
+ * @param hashes Hashes of the lines to insert, or NULL to set them later
+ * @param insert_count Number of lines to insert
+ */
+void line_index_splice(LineIndex* li, size_t line, size_t remove_count,
+                       const uint32_t* lengths, const uint64_t* hashes, size_t insert_count);
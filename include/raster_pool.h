@@ -0,0 +1,119 @@
+/**
+ * Background glyph rasterization.
+ *
+ * A RasterPool runs a few worker threads that render glyphs with FreeType
+ * into white ARGB8888 surfaces, so drawing text never waits for a glyph
+ * seen for the first time. SDL_ttf fonts are not thread safe: every worker
+ * opens its own copy of each font from the font manager's mapped file.
+ *
+ * Jobs are queued under a mutex. Finished jobs are pushed onto a lock-free
+ * stack, which the UI thread takes whole each frame and hands out in the
+ * order the jobs finished, so uploading the surfaces can be spread over
+ * frames without blocking the workers.
+ */
+
+#pragma once
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <stdbool.h>
+#include "font_manager.h"
+
+#define RASTER_POOL_MAX_WORKERS 4
+#define RASTER_POOL_FONTS       8   // Font copies each worker keeps open
+
+typedef struct RasterJob RasterJob;
+
+struct RasterJob {
+    RasterJob* next;
+    void* owner;                // Whoever the glyph is for, e.g. its atlas
+    FontSource source;
+    Uint32 ch;
+    SDL_Surface* surface;       // White ARGB8888 glyph, NULL if it failed
+};
+
+typedef struct {
+    const char* path;           // Interned path and size of the copy
+    int size;
+    TTF_Font* font;
+} RasterFont;
+
+typedef struct RasterPool RasterPool;
+
+typedef struct {
+    RasterPool* pool;
+    SDL_Thread* thread;
+
+    // Worker thread only
+    RasterFont fonts[RASTER_POOL_FONTS];
+    int font_count;
+    int next_evict;             // Copy replaced when all are in use
+} RasterWorker;
+
+struct RasterPool {
+    RasterWorker workers[RASTER_POOL_MAX_WORKERS];
+    int worker_count;
+
+    SDL_mutex* lock;
+    SDL_cond* wake;             // Signalled when a job is queued or on stop
+    SDL_atomic_t outstanding;   // Jobs submitted but not yet taken
+    void* finished;             // Lock-free stack of finished jobs, newest first
+
+    // Guarded by lock
+    RasterJob* queue_head;
+    RasterJob* queue_tail;
+    bool stop;
+
+    // UI thread only
+    RasterJob* taken;           // Finished jobs taken from the stack, oldest first
+};
+
+/**
+ * Starts the worker threads.
+ *
+ * @param workers Number of workers, 0 for one per spare CPU core
+ *
+ * @return Pointer to the pool, or NULL on error
+ */
+RasterPool* raster_pool_create(int workers);
+
+/**
+ * Stops the workers and frees every job not taken yet. Must be called
+ * before the font manager is destroyed.
+ *
+ * @param pool Pointer to the pool
+ */
+void raster_pool_destroy(RasterPool* pool);
+
+/**
+ * Queues a glyph to be rasterized.
+ *
+ * @param pool Pointer to the pool
+ * @param owner Passed back with the finished job
+ * @param source Font to rasterize with
+ * @param ch Character to rasterize
+ *
+ * @return Whether the job was queued
+ */
+bool raster_pool_submit(RasterPool* pool, void* owner, const FontSource* source, Uint32 ch);
+
+/**
+ * Takes the oldest finished job. UI thread only.
+ *
+ * @param pool Pointer to the pool
+ *
+ * @return Finished job, to be freed with raster_pool_release, or NULL if none
+ */
+RasterJob* raster_pool_take(RasterPool* pool);
+
+/**
+ * Frees a taken job and its surface.
+ *
+ * @param job Job returned by raster_pool_take
+ */
+void raster_pool_release(RasterJob* job);
+
+/**
+ * @return Number of jobs submitted but not yet taken
+ */
+int raster_pool_outstanding(RasterPool* pool);
@@ -2,10 +2,82 @@
 
 #include <SDL.h>
 #include <SDL_ttf.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "glyph_atlas.h"
+#include "atlas_cache.h"
+#include "line_cache.h"
+#include "raster_pool.h"
+#include "ui_layer.h"
+
+#define RENDERER_BATCH_LOOKBACK 16 // Batches a quad may skip back over to join one with its state
+#define RENDERER_SDF_ATLASES    2  // Sizes of distance field fonts kept resampled
+
+typedef enum {
+    RENDERER_BACKEND_GPU,       // Accelerated SDL renderer drawing to the window
+    RENDERER_BACKEND_HEADLESS   // SDL software renderer drawing to an in-memory
+                                // framebuffer, needs no GPU or display
+} RendererBackend;
+
+/**
+ * Draws are queued as quads and only submitted when the frame is flushed.
+ * Quads sharing a texture and blend mode are grouped into batches, each
+ * submitted with one SDL_RenderGeometry call. A quad may join an earlier
+ * batch only if it overlaps nothing queued since, so the frame looks the
+ * same as if it was drawn in order.
+ */
+typedef struct {
+    int batch;                  // Batch the quad is drawn with
+    SDL_Vertex vertices[4];
+} RenderQuad;
+
+typedef struct {
+    SDL_Texture* texture;       // NULL for solid colour
+    SDL_BlendMode blend;
+    SDL_FRect bounds;           // Union of the batch's quads
+    int quad_count;
+} RenderBatch;
+
+typedef struct {
+    int draw_calls;             // SDL_RenderGeometry submissions
+    int vertices;
+    int quads;
+} RenderStats;
 
 typedef struct Renderer {
+    RendererBackend backend;
     SDL_Renderer* sdl_renderer;
+    SDL_Surface* framebuffer;   // Frame drawn by the headless backend, NULL otherwise
+    int max_texture_width;      // Widest texture the renderer accepts, 0 if unlimited
     TTF_Font* font;
+
+    GlyphAtlas** atlases;       // One per font text has been drawn with
+    int atlas_count;
+    int atlas_capacity;
+    GlyphAtlas* last_atlas;     // Most recently used atlas
+    GlyphAtlas* sdf_atlases[RENDERER_SDF_ATLASES]; // Most recently used first
+    AtlasCache atlas_cache;     // Atlases saved by earlier sessions
+    RasterPool* raster_pool;    // Rasterizes new glyphs, NULL to do it inline
+    Uint32 glyph_generation;    // Bumped when glyphs arrive from the pool, part of
+                                // every layer and scroll view key so they redraw
+
+    SDL_Vertex* vertices;       // Queued quads sorted by batch, 4 vertices each
+    int* indices;               // 6 indices per quad
+    int quad_capacity;
+
+    RenderQuad* queue;          // Quads queued this frame, in draw order
+    int queue_count;
+    int queue_capacity;
+    RenderBatch* batches;
+    int batch_count;
+    int batch_capacity;
+    SDL_BlendMode draw_blend;   // Blend mode of solid colour quads
+
+    RenderStats stats;          // Frame being drawn
+    RenderStats last_stats;     // Last presented frame
+
+    LineCache* line_cache;      // Textures of whole lines of text
+    UiLayer infobar_layer;
 } Renderer;
 
 typedef enum {
@@ -16,18 +88,22 @@ typedef enum {
 
 /**
  * Creates a Renderer:
- *  - Creates SDL renderer
- *  - Creates TTF font
+ *  - Creates SDL renderer for the backend
+ *  - Maps the atlas cache
+ *  - Starts the raster pool (GPU backend only, headless frames rasterize
+ *    glyphs inline so every frame comes out the same)
  *
- * @param window Pointer to SDL window
+ * @param window Pointer to SDL window, the headless framebuffer is its size
+ * @param backend What to draw with
  * 
  * @return a valid Renderer, or NULL on error
  */
-Renderer* renderer_create(SDL_Window* window);
+Renderer* renderer_create(SDL_Window* window, RendererBackend backend);
 
 /**
  * Cleanup, destroys the Renderer:
- *  - Closes TTF font
+ *  - Stops the raster pool
+ *  - Saves glyph atlases to the atlas cache
  *  - Destroys SDL renderer
  *  - Frees memory allocated for Renderer
  * 
@@ -35,6 +111,32 @@ Renderer* renderer_create(SDL_Window* window);
  */
 void renderer_destroy(Renderer* r);
 
+/**
+ * Uploads glyphs the raster pool finished into their atlases, oldest first,
+ * for at most a time budget. The rest wait for the next call.
+ * 
+ * @param r Pointer to Renderer
+ * @param budget_ms Time to spend uploading
+ * 
+ * @return Whether any glyph arrived, the screen is then out of date
+ */
+bool renderer_upload_glyphs(Renderer* r, Uint32 budget_ms);
+
+/**
+ * Recovers from SDL_RENDER_TARGETS_RESET (target textures lost their
+ * contents) or SDL_RENDER_DEVICE_RESET (every texture was lost). Layers and
+ * views owned elsewhere must be invalidated or destroyed by their owners.
+ *
+ * @param r Pointer to Renderer
+ * @param device_lost Whether every texture was lost
+ */
+void renderer_reset(Renderer* r, bool device_lost);
+
+/**
+ * @return Whether glyphs are still being rasterized or waiting for upload
+ */
+bool renderer_glyphs_pending(Renderer* r);
+
 /**
  * Clears the render target
  * 
@@ -50,7 +152,53 @@ void renderer_clear(Renderer* r);
 void renderer_present(Renderer* r);
 
 /**
- * Renders text
+ * Writes the frame drawn so far to a BMP file, e.g. to compare against a
+ * golden image. Call before renderer_present, the GPU backend's frame is
+ * undefined after it.
+ * 
+ * @param r Pointer to Renderer
+ * @param path File to write
+ * 
+ * @return Whether the frame was written
+ */
+bool renderer_dump_frame(Renderer* r, const char* path);
+
+/**
+ * Submits every queued draw. Must be called before changing SDL render
+ * state directly (viewport, target etc.).
+ * 
+ * @param r Pointer to Renderer
+ */
+void renderer_flush(Renderer* r);
+
+/**
+ * Sets the viewport, flushing draws queued for the previous one
+ * 
+ * @param r Pointer to Renderer
+ * @param rect Viewport, or NULL for the whole target
+ */
+void renderer_set_viewport(Renderer* r, const SDL_Rect* rect);
+
+/**
+ * Redirects drawing into a target texture, flushing draws queued for the
+ * previous target
+ * 
+ * @param r Pointer to Renderer
+ * @param target Texture created with SDL_TEXTUREACCESS_TARGET, or NULL for the window
+ */
+void renderer_set_target(Renderer* r, SDL_Texture* target);
+
+/**
+ * Retrieves draw call and vertex counts of the last presented frame
+ * 
+ * @param r Pointer to Renderer
+ * 
+ * @return Stats of the last frame
+ */
+RenderStats renderer_get_stats(Renderer* r);
+
+/**
+ * Renders text as quads from the font's glyph atlas
  * 
  * @param r Pointer to Renderer
  * @param text Text to render
@@ -61,6 +209,116 @@ void renderer_present(Renderer* r);
  */
 void renderer_draw_text(Renderer* r, const char* text, int x, int y, TTF_Font* font, TextAlign align, SDL_Color color);
 
+/**
+ * Renders text as quads from a glyph atlas
+ * 
+ * @param r Pointer to Renderer
+ * @param atlas Atlas to draw glyphs from
+ * @param text Text to render
+ * @param length Length of the text in bytes
+ * @param x Text x position
+ * @param y Text y position
+ * @param color Color to render text
+ */
+void renderer_draw_atlas_text(Renderer* r, GlyphAtlas* atlas, const char* text, size_t length, int x, int y, SDL_Color color);
+
+/**
+ * Renders a number right aligned, from the digit glyphs of a glyph atlas
+ * 
+ * @param r Pointer to Renderer
+ * @param atlas Atlas to draw glyphs from
+ * @param number Number to render, e.g. a line number past INT_MAX
+ * @param x Right edge of the number
+ * @param y Number y position
+ * @param color Color to render number
+ */
+void renderer_draw_atlas_number(Renderer* r, GlyphAtlas* atlas, uint64_t number, int x, int y, SDL_Color color);
+
+/**
+ * Renders a number right aligned, from the digit glyphs of the font's atlas
+ * 
+ * @param r Pointer to Renderer
+ * @param number Number to render (non-negative)
+ * @param x Right edge of the number
+ * @param y Number y position
+ * @param font Pointer to TTF_Font
+ * @param color Color to render number
+ */
+void renderer_draw_number(Renderer* r, int number, int x, int y, TTF_Font* font, SDL_Color color);
+
+/**
+ * Renders text from the line cache, if it has been cached
+ * 
+ * @param r Pointer to Renderer
+ * @param hash Content hash of the text
+ * @param x Text x position
+ * @param y Text y position
+ * @param font Pointer to TTF_Font
+ * @param color Color to render text
+ * 
+ * @return Whether the text was cached (and drawn)
+ */
+bool renderer_draw_cached_text(Renderer* r, uint64_t hash, int x, int y, TTF_Font* font, SDL_Color color);
+
+/**
+ * Rasterizes text into a texture, adds it to the line cache and renders it.
+ * Text too wide for a texture is drawn from the glyph atlas without caching.
+ * 
+ * @param r Pointer to Renderer
+ * @param hash Content hash of the text, used to find it again
+ * @param text Text to render
+ * @param x Text x position
+ * @param y Text y position
+ * @param font Pointer to TTF_Font
+ * @param color Color to render text
+ */
+void renderer_cache_text(Renderer* r, uint64_t hash, const char* text, int x, int y, TTF_Font* font, SDL_Color color);
+
+/**
+ * Retrieves the glyph atlas of a font, creating it on first use
+ * 
+ * @param r Pointer to Renderer
+ * @param font Pointer to TTF_Font
+ * 
+ * @return Pointer to the atlas, or NULL on error
+ */
+GlyphAtlas* renderer_get_atlas(Renderer* r, TTF_Font* font);
+
+/**
+ * Retrieves the glyph atlas of a distance field font at a pixel size.
+ * Only the RENDERER_SDF_ATLASES most recently used sizes are kept, so
+ * zooming through sizes does not add up texture memory.
+ * 
+ * @param r Pointer to Renderer
+ * @param sdf Distance field font
+ * @param size Pixel size
+ * 
+ * @return Pointer to the atlas, or NULL on error
+ */
+GlyphAtlas* renderer_get_sdf_atlas(Renderer* r, SdfFont* sdf, int size);
+
+/**
+ * Queues a font's ASCII glyphs on the raster pool, so its atlas is filled
+ * before the font is first drawn with, e.g. the next zoom step. Does nothing
+ * without a raster pool, rasterising inline would only move the stall.
+ * 
+ * @param r Pointer to Renderer
+ * @param font Pointer to TTF_Font
+ */
+void renderer_prewarm_atlas(Renderer* r, TTF_Font* font);
+
+/**
+ * Renders a whole texture
+ * 
+ * @param r Pointer to Renderer
+ * @param texture Texture to render
+ * @param x Position on x-axis (top-left corner)
+ * @param y Position on y-axis (top-left corner)
+ * @param w Width to render at
+ * @param h Height to render at
+ */
+void renderer_draw_texture(Renderer* r, SDL_Texture* texture, int x, int y, int w, int h);
+
 /**
  * Renders a rectangle
  * 
@@ -86,7 +344,8 @@ void renderer_draw_rect(Renderer* r, int x, int y, int w, int h, SDL_Color color
 void renderer_draw_cursor(Renderer* r, int x, int y, int height, float alpha);
 
 /**
- * Renders the infobar (current file, line etc.)
+ * Renders the infobar (current file, line etc.), only drawing it again
+ * when the text or width changes
  * 
  * @param r Pointer to Renderer
  * @param text Text to display on infobar
@@ -0,0 +1,110 @@
+/**
+ * Offscreen view of a vertically scrolling list of equally tall rows.
+ *
+ * The rows are kept in a texture the size of the view. When the view
+ * scrolls, the pixels still on screen are shifted by copying the texture
+ * into a second one (SDL cannot copy a texture onto itself) and only the
+ * rows that came into view are drawn again. Each row is drawn for a key
+ * describing its contents; rows whose key did not change are left alone.
+ * Every row is drawn again once glyphs arrive from the raster pool, as
+ * rows drawn before then may be missing some.
+ *
+ * Usage:
+ *     scroll_view_begin(&view, r, w, h, row_height, scroll_y, layout_key);
+ *     for (each visible row)
+ *         if (scroll_view_row_dirty(&view, row, key))
+ *             // Draw the row at scroll_view_row_y(&view, row), over its old pixels
+ *     scroll_view_end(&view, r);
+ *
+ * Without target texture support every row is always dirty and drawn
+ * straight to the screen.
+ */
+
+#pragma once
+
+#include <SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct Renderer;
+
+typedef struct {
+    SDL_Texture* front;     // Rows as currently shown
+    SDL_Texture* back;      // Scratch texture for shifting
+    int w, h;
+    int row_height;
+    int64_t scroll_y;       // Content y at the top of the view
+    uint64_t layout_key;    // What every row's position depends on (font,
+                            // horizontal scroll...), changing it redraws all
+
+    size_t first_row;       // Row of row_keys[0]
+    uint64_t* row_keys;     // Key each visible row was drawn for, 0 if not drawn
+    uint64_t* spare_keys;   // Scratch for shifting the keys
+    int row_count;
+    int row_capacity;
+
+    bool direct;            // Target textures are unavailable
+    bool drawing;           // Between begin and end
+    SDL_Rect viewport;      // Viewport to restore once drawn
+    int rows_drawn;         // Rows drawn since begin
+} ScrollView;
+
+/**
+ * Initialises an empty view.
+ *
+ * @param v Pointer to the view
+ */
+void scroll_view_init(ScrollView* v);
+
+/**
+ * Destroys the view's textures. Must be called before the renderer is destroyed.
+ *
+ * @param v Pointer to the view
+ */
+void scroll_view_destroy(ScrollView* v);
+
+/**
+ * Forgets every drawn row, so the whole view is drawn next frame.
+ *
+ * @param v Pointer to the view
+ */
+void scroll_view_invalidate(ScrollView* v);
+
+/**
+ * Starts a frame: scrolls the kept pixels to scroll_y and redirects drawing
+ * into the view.
+ *
+ * @param v Pointer to the view
+ * @param r Pointer to the Renderer
+ * @param w Width of the view
+ * @param h Height of the view
+ * @param row_height Height of each row
+ * @param scroll_y Content y at the top of the view (not negative)
+ * @param layout_key Key of everything all rows depend on
+ */
+void scroll_view_begin(ScrollView* v, struct Renderer* r, int w, int h, int row_height, int64_t scroll_y, uint64_t layout_key);
+
+/**
+ * Checks whether a visible row must be drawn, and records it as drawn.
+ *
+ * @param v Pointer to the view
+ * @param row Row to check
+ * @param key Key of the row's contents (non-zero)
+ *
+ * @return Whether the row must be drawn
+ */
+bool scroll_view_row_dirty(ScrollView* v, size_t row, uint64_t key);
+
+/**
+ * @return y of a visible row within the view
+ */
+int scroll_view_row_y(const ScrollView* v, size_t row);
+
+/**
+ * Finishes the frame and composites the view at the top-left of the viewport.
+ *
+ * @param v Pointer to the view
+ * @param r Pointer to the Renderer
+ */
+void scroll_view_end(ScrollView* v, struct Renderer* r);
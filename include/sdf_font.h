@@ -0,0 +1,104 @@
+/**
+ * Signed distance field font.
+ *
+ * Each glyph of a font is rasterised once, at SDF_FONT_BASE_SIZE, and turned
+ * into a field holding how far every pixel is from the glyph's outline. Text
+ * of any size is then resampled from the fields, so zooming needs neither a
+ * new TTF_Font nor FreeType rasterisation, and the memory used stays the
+ * same whatever sizes are drawn.
+ *
+ * Metrics are the base size's scaled and rounded per glyph, so layout from
+ * them matches the resampled glyphs exactly.
+ */
+
+#pragma once
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <stdbool.h>
+
+#define SDF_FONT_BASE_SIZE 64    // Size glyphs are rasterised at
+#define SDF_FONT_SPREAD    8     // Distance in base pixels the field covers on
+                                 // each side of an outline
+#define SDF_FONT_GLYPHS    256   // One per Latin-1 character
+
+typedef struct {
+    bool loaded;            // Whether metrics have been read
+    bool has_field;         // Whether the field has been built
+    int advance;            // Pen movement after the glyph, in base pixels
+    int offset_x;           // Where the glyph box starts relative to the pen
+    int width;              // Glyph box, 0 if it has no pixels
+    int height;
+    unsigned char* field;   // (width + 2 * SPREAD) x (height + 2 * SPREAD),
+                            // 128 on the outline, higher inside
+} SdfGlyph;
+
+typedef struct {
+    TTF_Font* font;         // Base size font, owned by the font manager
+    int height;             // Base size metrics
+    int line_skip;
+    bool kerning;           // Whether glyph pairs need kerning applied
+
+    SdfGlyph glyphs[SDF_FONT_GLYPHS];
+} SdfFont;
+
+/**
+ * Creates an empty distance field font. Glyphs are built on first use.
+ *
+ * @param font Font opened at SDF_FONT_BASE_SIZE, must outlive the SDF font
+ *
+ * @return Pointer to the font, or NULL on error
+ */
+SdfFont* sdf_font_create(TTF_Font* font);
+
+/**
+ * Frees every field and the font.
+ *
+ * @param f Pointer to the font
+ */
+void sdf_font_destroy(SdfFont* f);
+
+/**
+ * @return Pen movement after a character at a pixel size
+ */
+int sdf_font_advance(SdfFont* f, unsigned char c, int size);
+
+/**
+ * @return Kerning adjustment between two consecutive characters at a pixel size
+ */
+int sdf_font_kerning(SdfFont* f, unsigned char prev, unsigned char c, int size);
+
+/**
+ * @return Font height at a pixel size
+ */
+int sdf_font_height(SdfFont* f, int size);
+
+/**
+ * @return Distance between lines at a pixel size
+ */
+int sdf_font_line_skip(SdfFont* f, int size);
+
+/**
+ * Finds the pixels a character covers at a pixel size.
+ *
+ * @param f Pointer to the font
+ * @param c Character (Latin-1)
+ * @param size Pixel size
+ * @param offset_x Filled with where the pixels start relative to the pen
+ * @param w Filled with the width, 0 if there is nothing to draw
+ * @param h Filled with the height
+ */
+void sdf_font_glyph_box(SdfFont* f, unsigned char c, int size, int* offset_x, int* w, int* h);
+
+/**
+ * Resamples a character into white ARGB8888 pixels with coverage in alpha.
+ *
+ * @param f Pointer to the font
+ * @param c Character (Latin-1)
+ * @param size Pixel size
+ * @param pixels Output, the size of the character's glyph box
+ * @param pitch Bytes between rows of pixels
+ *
+ * @return Whether the glyph was drawn
+ */
+bool sdf_font_resample(SdfFont* f, unsigned char c, int size, Uint32* pixels, int pitch);
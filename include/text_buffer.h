@@ -0,0 +1,328 @@
+/**
+ * Piece table text storage.
+ *
+ * The document is described by an ordered list of pieces, each referencing a
+ * span of either the immutable original text (as loaded from disk) or the
+ * append-only add buffer (everything typed since). Pieces are kept in a treap
+ * ordered by document position and augmented with subtree byte totals, so
+ * locating, inserting and deleting at any offset costs O(log pieces).
+ *
+ * Inserted text and pieces are allocated from arenas, so text never moves
+ * once written. Files are memory-mapped and used as the original text
+ * directly, and lines are indexed lazily: only as far into the file as
+ * has been asked for.
+ *
+ * Offsets are byte offsets into the document. Lines are separated by '\n';
+ * a '\r' directly before the '\n' is treated as part of the line ending.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+#include "line_index.h"
+#include "kFile.h"
+
+#define TEXT_BUFFER_INDEX_CHUNK (1024 * 1024) // Bytes scanned per line indexing step
+
+typedef struct Piece Piece;
+
+struct Piece {
+    Piece* left;
+    Piece* right;
+    unsigned int priority;  // Treap heap priority
+    const char* data;       // Start of the span, in the original text or add buffer
+    size_t length;          // Length of the piece in bytes
+    size_t total;           // Sum of piece lengths in this subtree
+};
+
+typedef struct {
+    const char* original;   // Immutable original text
+    size_t original_length;
+    char* original_heap;    // Owned copy backing the original, if not mapped
+    kFileMap original_map;  // File mapping backing the original, if mapped
+
+    Arena add;              // Append-only storage for inserted text
+
+    Piece* root;            // Treap of pieces ordered by document position
+    Pool pieces;            // Piece storage
+    unsigned int seed;      // PRNG state for treap priorities
+
+    LineIndex lines;        // Line lengths, updated on every edit
+    size_t unindexed;       // Trailing bytes not yet split into lines. They are
+                            // kept out of the index, whose last line only
+                            // holds the part of it scanned so far
+    bool index_paused;      // Lines are being supplied by text_buffer_append_lines
+
+    char eol[3];            // Line ending inserted for new lines ("\n" or "\r\n")
+
+    uint64_t generation;    // Incremented on every edit
+    uint64_t clean_generation; // Generation whose contents are on disk
+    uint64_t clean_hash;    // text_buffer_hash of the text on disk, fully indexed
+    bool has_clean_hash;    // Whether clean_hash is known
+    bool clean_is_original; // Whether the text on disk is the original text, so
+                            // its hash can be worked out if it is not known
+} TextBuffer;
+
+/**
+ * Immutable view of the document at one point in time.
+ *
+ * Pieces never modify the text they point at, so a snapshot only copies
+ * the list of spans, not the text. It stays valid while the buffer keeps
+ * being edited, until the buffer's storage is replaced (by a load or rebase).
+ */
+typedef struct {
+    kFileSpan* spans;       // Contiguous spans making up the document
+    size_t count;
+    size_t length;          // Total length in bytes
+    uint64_t generation;    // Edit generation the snapshot was taken at
+    uint64_t hash;          // text_buffer_hash at the time of the snapshot, 0 if
+                            // the text was not fully indexed yet
+} TextBufferSnapshot;
+
+/**
+ * Called for each contiguous span of the document, in order.
+ *
+ * @return false to stop iteration early
+ */
+typedef bool (*TextBufferSpanFn)(const char* data, size_t length, void* user);
+
+/**
+ * Creates an empty text buffer.
+ *
+ * @return Pointer to the buffer, or NULL on allocation failure
+ */
+TextBuffer* text_buffer_create(void);
+
+/**
+ * Destroys a text buffer and frees all memory it owns.
+ *
+ * @param tb Pointer to the buffer
+ */
+void text_buffer_destroy(TextBuffer* tb);
+
+/**
+ * Replaces the contents of the buffer with the given text.
+ *
+ * @param tb Pointer to the buffer
+ * @param data Heap allocated text (may be NULL if length is 0)
+ * @param length Length of the text in bytes
+ *
+ * @note The buffer takes ownership of data and frees it when no longer needed
+ */
+void text_buffer_load(TextBuffer* tb, char* data, size_t length);
+
+/**
+ * Replaces the contents of the buffer with a file, memory-mapping it when
+ * possible and reading it into memory otherwise.
+ *
+ * @param tb Pointer to the buffer
+ * @param path Path of the file to load
+ *
+ * @return Success code
+ */
+int text_buffer_load_file(TextBuffer* tb, const char* path);
+
+/**
+ * Copies mapped original text into memory and releases the mapping, so the
+ * file backing it can be overwritten.
+ *
+ * @param tb Pointer to the buffer
+ * @param copy Copy of the original text made ahead of time (e.g. on another
+ *             thread), taken over by the buffer, or NULL to copy it now
+ *
+ * @return Success code
+ */
+int text_buffer_detach_file(TextBuffer* tb, char* copy);
+
+/**
+ * Hash of the document contents, kept up to date on every edit so it costs O(1).
+ * Text not yet indexed only contributes its length.
+ *
+ * @param tb Pointer to the buffer
+ *
+ * @return Hash of the contents
+ */
+uint64_t text_buffer_hash(TextBuffer* tb);
+
+/**
+ * Records which contents are on disk, loading a file records its own.
+ *
+ * @param tb Pointer to the buffer
+ * @param generation Edit generation of the saved contents
+ * @param hash text_buffer_hash of the saved contents, 0 if they were not fully indexed
+ */
+void text_buffer_mark_saved(TextBuffer* tb, uint64_t generation, uint64_t hash);
+
+/**
+ * Compares the contents against the text on disk in O(1). Edits that are
+ * reverted (e.g. by deleting typed text) leave the buffer unmodified, once
+ * every line has been indexed.
+ *
+ * @param tb Pointer to the buffer
+ *
+ * @return Whether the contents differ from the text on disk
+ */
+bool text_buffer_is_modified(TextBuffer* tb);
+
+/**
+ * Makes the current contents the new original text, collapsing all pieces
+ * into one and discarding the add buffer. Typically called after a save.
+ *
+ * @param tb Pointer to the buffer
+ *
+ * @return Success code
+ */
+int text_buffer_rebase(TextBuffer* tb);
+
+/**
+ * Makes the current contents the new original text, mapping it from a file
+ * known to hold exactly those contents (e.g. the file just saved). Falls
+ * back to text_buffer_rebase if the file cannot be mapped.
+ *
+ * @param tb Pointer to the buffer
+ * @param path Path of the file
+ *
+ * @return Success code
+ */
+int text_buffer_rebase_file(TextBuffer* tb, const char* path);
+
+/**
+ * Checks whether the contents are identical to the original text.
+ *
+ * @param tb Pointer to the buffer
+ *
+ * @return Whether the buffer is unmodified
+ */
+bool text_buffer_is_original(TextBuffer* tb);
+
+/**
+ * Inserts text at a document offset.
+ *
+ * @param tb Pointer to the buffer
+ * @param offset Offset to insert at (clamped to the document length)
+ * @param text Text to insert
+ * @param length Length of the text in bytes
+ */
+void text_buffer_insert(TextBuffer* tb, size_t offset, const char* text, size_t length);
+
+/**
+ * Deletes a range of text.
+ *
+ * @param tb Pointer to the buffer
+ * @param offset Offset of the first byte to delete
+ * @param length Number of bytes to delete (clamped to the document length)
+ */
+void text_buffer_delete(TextBuffer* tb, size_t offset, size_t length);
+
+/**
+ * Copies a range of the document into a caller provided buffer.
+ *
+ * @param tb Pointer to the buffer
+ * @param offset Offset of the first byte to copy
+ * @param length Number of bytes to copy
+ * @param out Destination, must hold at least length bytes
+ *
+ * @return Number of bytes copied
+ */
+size_t text_buffer_copy(TextBuffer* tb, size_t offset, size_t length, char* out);
+
+/**
+ * Visits the contiguous spans making up the document, in order.
+ *
+ * @param tb Pointer to the buffer
+ * @param fn Callback invoked for each span
+ * @param user User data passed to the callback
+ *
+ * @return false if the callback stopped iteration early
+ */
+bool text_buffer_for_each_span(TextBuffer* tb, TextBufferSpanFn fn, void* user);
+
+/**
+ * Takes a snapshot of the current contents.
+ *
+ * @param tb Pointer to the buffer
+ * @param snap Pointer to the snapshot to fill
+ *
+ * @return Success code
+ */
+int text_buffer_snapshot(TextBuffer* tb, TextBufferSnapshot* snap);
+
+/**
+ * Frees a snapshot's span list.
+ *
+ * @param snap Pointer to the snapshot
+ */
+void text_buffer_snapshot_free(TextBufferSnapshot* snap);
+
+/**
+ * @return Length of the document in bytes
+ */
+size_t text_buffer_length(TextBuffer* tb);
+
+/**
+ * Indexes lines until the given line is known (or the whole document is indexed).
+ *
+ * @param tb Pointer to the buffer
+ * @param line Line that must be indexed
+ */
+void text_buffer_index_to_line(TextBuffer* tb, size_t line);
+
+/**
+ * @return Whether every line of the document has been indexed
+ */
+bool text_buffer_is_indexed(TextBuffer* tb);
+
+/**
+ * Stops (or resumes) indexing lines on demand, for when lines are supplied
+ * by a background scan through text_buffer_append_lines instead.
+ *
+ * @param tb Pointer to the buffer
+ * @param paused Whether on demand indexing is paused
+ */
+void text_buffer_pause_indexing(TextBuffer* tb, bool paused);
+
+/**
+ * Adds lines found by scanning the unindexed text elsewhere (e.g. on another thread).
+ *
+ * @param tb Pointer to the buffer
+ * @param lengths Lengths of the complete lines found, the first including any
+ *                part of it scanned by earlier calls
+ * @param hashes Hashes of the complete lines found (see line_index_hash_bytes)
+ * @param count Number of lines found
+ * @param scanned Number of unindexed bytes the scan consumed
+ * @param tail_hash Hash of the part of the last line scanned so far
+ *
+ * @return Success code, fails if the lines do not fit the unindexed text
+ */
+int text_buffer_append_lines(TextBuffer* tb, const uint32_t* lengths, const uint64_t* hashes,
+                             size_t count, size_t scanned, uint64_t tail_hash);
+
+/**
+ * @return Number of lines indexed so far (at least 1), which is the total
+ *         number of lines once text_buffer_is_indexed returns true
+ */
+size_t text_buffer_line_count(TextBuffer* tb);
+
+/**
+ * @return Document offset of the first byte of a line
+ */
+size_t text_buffer_line_start(TextBuffer* tb, size_t line);
+
+/**
+ * @return Length of a line in bytes, excluding its line ending
+ */
+size_t text_buffer_line_length(TextBuffer* tb, size_t line);
+
+/**
+ * @return Content hash of a line (including its line ending), equal for
+ *         lines with equal text
+ */
+uint64_t text_buffer_line_hash(TextBuffer* tb, size_t line);
+
+/**
+ * @return Line containing the given document offset
+ */
+size_t text_buffer_line_of_offset(TextBuffer* tb, size_t offset);
@@ -0,0 +1,99 @@
+/**
+ * Retained UI layers.
+ *
+ * A layer is a panel (titlebar, infobar, overlay...) rendered into its own
+ * target texture. Its owner describes everything the panel shows by a key,
+ * usually a hash of its inputs, and the panel is only drawn again when the
+ * key or size changes, or glyphs it may have drawn blank arrive from the
+ * raster pool. Every other frame just composites the texture.
+ *
+ * Usage:
+ *     if (ui_layer_begin(&layer, r, x, y, w, h, key))
+ *     {
+ *         // Draw the panel, relative to its top-left corner
+ *     }
+ *     ui_layer_end(&layer, r);
+ *
+ * Layer textures hold premultiplied alpha, so translucent panels composite
+ * the same as if they were drawn directly.
+ */
+
+#pragma once
+
+#include <SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define UI_LAYER_HASH_SEED 14695981039346656037ull // FNV-1a offset basis
+
+struct Renderer;
+
+typedef struct {
+    SDL_Texture* texture;   // Panel contents, NULL until first drawn
+    int x, y;               // Where the panel is composited
+    int w, h;
+    uint64_t key;           // Key the contents were drawn for
+
+    bool drawing;           // Between a begin that redraws and its end
+    bool direct;            // Target textures are unavailable, the panel is
+                            // drawn straight to the screen every frame
+    SDL_Rect viewport;      // Viewport to restore once drawn
+} UiLayer;
+
+/**
+ * Initialises an empty layer.
+ *
+ * @param l Pointer to the layer
+ */
+void ui_layer_init(UiLayer* l);
+
+/**
+ * Destroys the layer's texture. Must be called before the renderer is destroyed.
+ *
+ * @param l Pointer to the layer
+ */
+void ui_layer_destroy(UiLayer* l);
+
+/**
+ * Forgets the layer's contents, so the panel is drawn again next frame
+ * (e.g. after the renderer lost the contents of its target textures).
+ *
+ * @param l Pointer to the layer
+ */
+void ui_layer_invalidate(UiLayer* l);
+
+/**
+ * Hashes panel inputs into a key.
+ *
+ * @param seed UI_LAYER_HASH_SEED, or the key of the previous inputs
+ * @param data Input to hash
+ * @param length Length of the input in bytes
+ *
+ * @return Key covering the input
+ */
+uint64_t ui_layer_hash(uint64_t seed, const void* data, size_t length);
+
+/**
+ * Starts a frame of the layer. If its contents are out of date, draws are
+ * redirected into the layer until ui_layer_end.
+ *
+ * @param l Pointer to the layer
+ * @param r Pointer to the Renderer
+ * @param x Position of the panel within the current viewport
+ * @param y Position of the panel within the current viewport
+ * @param w Width of the panel
+ * @param h Height of the panel
+ * @param key Key of what the panel shows
+ *
+ * @return Whether the panel must be drawn now
+ */
+bool ui_layer_begin(UiLayer* l, struct Renderer* r, int x, int y, int w, int h, uint64_t key);
+
+/**
+ * Finishes drawing the layer (if it was redrawn) and composites it.
+ *
+ * @param l Pointer to the layer
+ * @param r Pointer to the Renderer
+ */
+void ui_layer_end(UiLayer* l, struct Renderer* r);
@@ -0,0 +1,132 @@
+/**
+ * Undo/redo history.
+ *
+ * Every edit is recorded as a delta: the offset it happened at, the text it
+ * removed and the text it inserted. Delta text is copied into an append-only
+ * arena, so undoing or redoing an edit costs O(size of the edit) no matter
+ * how large the document is. Runs of typing (and of backspacing) are merged
+ * into single entries.
+ *
+ * The history is kept within a memory budget by compacting the arena and
+ * forgetting the oldest entries once the budget is exceeded. An edit larger
+ * than half the budget is never copied: the history is cleared instead and
+ * the caller told the edit cannot be undone.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "arena.h"
+#include "text_buffer.h"
+
+#define UNDO_DEFAULT_BUDGET (64 * 1024 * 1024) // Bytes of history kept by default
+#define UNDO_COALESCE_MAX   4096               // Longest run of typing merged into one entry
+
+typedef struct {
+    size_t offset;              // Where the edit happened
+    const char* removed;        // Text removed at offset (in the history arena)
+    size_t removed_length;
+    const char* inserted;       // Text inserted at offset (in the history arena)
+    size_t inserted_length;
+} UndoEntry;
+
+typedef struct {
+    UndoEntry* entries;         // Oldest first
+    size_t count;               // Entries recorded (including undone ones)
+    size_t capacity;
+    size_t position;            // Entries before this are applied, the rest can be redone
+
+    Arena text;                 // Removed/inserted text of every entry
+    size_t budget;              // Memory budget in bytes
+    bool sealed;                // Whether the next edit must start a new entry
+} UndoHistory;
+
+/**
+ * Initialises an empty history.
+ *
+ * @param u Pointer to the history
+ * @param budget Memory budget in bytes
+ */
+void undo_init(UndoHistory* u, size_t budget);
+
+/**
+ * Frees all memory owned by the history.
+ *
+ * @param u Pointer to the history
+ */
+void undo_destroy(UndoHistory* u);
+
+/**
+ * Forgets every entry, e.g. when a different file is loaded.
+ *
+ * @param u Pointer to the history
+ */
+void undo_clear(UndoHistory* u);
+
+/**
+ * Stops the next edit from being merged into the last entry, e.g. when the
+ * cursor is moved.
+ *
+ * @param u Pointer to the history
+ */
+void undo_seal(UndoHistory* u);
+
+/**
+ * Records text about to be inserted into a buffer.
+ *
+ * @param u Pointer to the history
+ * @param offset Insertion offset
+ * @param text Text being inserted
+ * @param length Length of the text
+ *
+ * @return Whether the edit can be undone, if not the history was cleared
+ *         (the edit is too large for the budget, or out of memory)
+ */
+bool undo_record_insert(UndoHistory* u, size_t offset, const char* text, size_t length);
+
+/**
+ * Records text about to be deleted from a buffer. Must be called before the
+ * deletion, as the removed text is copied from the buffer.
+ *
+ * @param u Pointer to the history
+ * @param tb Buffer the text is being deleted from
+ * @param offset Offset of the deleted range
+ * @param length Length of the deleted range
+ *
+ * @return Whether the edit can be undone, if not the history was cleared
+ *         (the edit is too large for the budget, or out of memory)
+ */
+bool undo_record_delete(UndoHistory* u, TextBuffer* tb, size_t offset, size_t length);
+
+/**
+ * @return Entry the next undo would revert, or NULL if there is none
+ */
+const UndoEntry* undo_peek_undo(UndoHistory* u);
+
+/**
+ * @return Entry the next redo would re-apply, or NULL if there is none
+ */
+const UndoEntry* undo_peek_redo(UndoHistory* u);
+
+/**
+ * Reverts the last applied entry.
+ *
+ * @param u Pointer to the history
+ * @param tb Buffer to revert
+ * @param cursor Set to the offset the cursor should move to
+ *
+ * @return Whether there was anything to undo
+ */
+bool undo_undo(UndoHistory* u, TextBuffer* tb, size_t* cursor);
+
+/**
+ * Re-applies the last undone entry.
+ *
+ * @param u Pointer to the history
+ * @param tb Buffer to apply it to
+ * @param cursor Set to the offset the cursor should move to
+ *
+ * @return Whether there was anything to redo
+ */
+bool undo_redo(UndoHistory* u, TextBuffer* tb, size_t* cursor);
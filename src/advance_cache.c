@@ -0,0 +1,219 @@
+#include "advance_cache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+static int glyph_advance(AdvanceCache* c, unsigned char ch)
+{
+    if (!c->glyph_loaded[ch])
+    {
+        int advance = 0;
+        if (c->sdf) advance = sdf_font_advance(c->sdf, ch, c->size);
+        else if (TTF_GlyphMetrics32(c->font, ch, NULL, NULL, NULL, NULL, &advance) != 0) advance = 0;
+        c->glyph_advance[ch] = advance;
+        c->glyph_loaded[ch] = true;
+    }
+    return c->glyph_advance[ch];
+}
+
+// Columns a tab at col spans, reaching the next tab stop
+static int tab_span(int col, int tab_width)
+{
+    return tab_width - col % tab_width;
+}
+
+// Fixed pitch fonts are detected from the face, and confirmed by comparing
+// a narrow and a wide glyph since some faces set the flag loosely
+static int detect_monospace(AdvanceCache* c)
+{
+    if (!TTF_FontFaceIsFixedWidth(c->font)) return 0;
+
+    int advance = glyph_advance(c, 'M');
+    if (advance <= 0 || glyph_advance(c, 'i') != advance || glyph_advance(c, ' ') != advance) return 0;
+    return advance;
+}
+
+static LineAdvances* slot_of(AdvanceCache* c, uint64_t hash)
+{
+    return &c->slots[(hash ^ (hash >> 32)) & (ADVANCE_CACHE_SLOTS - 1)];
+}
+
+static void forget_lines(AdvanceCache* c)
+{
+    for (int i = 0; i < ADVANCE_CACHE_SLOTS; i++) c->slots[i].length = -1;
+    memset(c->glyph_loaded, 0, sizeof(c->glyph_loaded));
+}
+
+void advance_cache_init(AdvanceCache* c, int tab_width)
+{
+    memset(c, 0, sizeof(AdvanceCache));
+    c->tab_width = tab_width > 0 ? tab_width : 1;
+    forget_lines(c);
+}
+
+void advance_cache_destroy(AdvanceCache* c)
+{
+    for (int i = 0; i < ADVANCE_CACHE_SLOTS; i++) free(c->slots[i].x);
+    memset(c, 0, sizeof(AdvanceCache));
+}
+
+int advance_cache_expand_tabs(const char* text, int length, int tab_width, char* out)
+{
+    int n = 0;
+    for (int i = 0; i < length; i++)
+    {
+        if (text[i] == '\t')
+        {
+            int span = tab_span(n, tab_width);
+            memset(out + n, ' ', span);
+            n += span;
+        }
+        else
+        {
+            out[n++] = text[i];
+        }
+    }
+    out[n] = '\0';
+    return n;
+}
+
+void advance_cache_set_font(AdvanceCache* c, TTF_Font* font)
+{
+    if (c->font == font && !c->sdf) return;
+
+    c->font = font;
+    c->sdf = NULL;
+    c->size = 0;
+    c->kerning = font && TTF_GetFontKerning(font) && !TTF_FontFaceIsFixedWidth(font);
+    forget_lines(c);
+    c->monospace_advance = font ? detect_monospace(c) : 0;
+}
+
+void advance_cache_set_sdf(AdvanceCache* c, SdfFont* sdf, int size)
+{
+    if (!sdf)
+    {
+        advance_cache_set_font(c, NULL);
+        return;
+    }
+    if (c->sdf == sdf && c->size == size) return;
+
+    // The base font still tells whether the face is fixed pitch
+    c->font = sdf->font;
+    c->sdf = sdf;
+    c->size = size;
+    c->kerning = sdf->kerning;
+    forget_lines(c);
+    c->monospace_advance = detect_monospace(c);
+}
+
+const LineAdvances* advance_cache_find(AdvanceCache* c, uint64_t hash, int length)
+{
+    LineAdvances* a = slot_of(c, hash);
+    if (a->length != length || a->hash != hash) return NULL;
+    return a;
+}
+
+const LineAdvances* advance_cache_build(AdvanceCache* c, uint64_t hash, const char* text, int length)
+{
+    if (!c->font || length < 0) return NULL;
+
+    LineAdvances* a = slot_of(c, hash);
+    a->hash = hash;
+    a->advance = 0;
+
+    // Fixed pitch without tabs, every column is equally wide
+    if (c->monospace_advance && !memchr(text, '\t', length))
+    {
+        a->advance = c->monospace_advance;
+        a->length = length;
+        return a;
+    }
+
+    if (a->capacity < length + 1)
+    {
+        int new_capacity = a->capacity ? a->capacity : 64;
+        while (new_capacity < length + 1) new_capacity *= 2;
+
+        int* x = realloc(a->x, new_capacity * sizeof(int));
+        if (!x)
+        {
+            fprintf(stderr, "[advance_cache] Failed to allocate advances of %d columns.\n", length);
+            a->length = -1;
+            return NULL;
+        }
+        a->x = x;
+        a->capacity = new_capacity;
+    }
+
+    a->x[0] = 0;
+    if (c->monospace_advance)
+    {
+        // Only tabs break the grid
+        int col = 0;
+        for (int i = 0; i < length; i++)
+        {
+            col += text[i] == '\t' ? tab_span(col, c->tab_width) : 1;
+            a->x[i + 1] = col * c->monospace_advance;
+        }
+    }
+    else
+    {
+        int col = 0;    // Visual column, to find tab stops
+        int pen = 0;
+        int space = glyph_advance(c, ' ');
+        for (int i = 0; i < length; i++)
+        {
+            unsigned char ch = (unsigned char)text[i];
+            if (ch == '\t')
+            {
+                int span = tab_span(col, c->tab_width);
+                col += span;
+                pen += span * space;
+            }
+            else
+            {
+                if (i > 0 && c->kerning && text[i - 1] != '\t')
+                {
+                    pen += c->sdf ? sdf_font_kerning(c->sdf, (unsigned char)text[i - 1], ch, c->size)
+                                  : TTF_GetFontKerningSizeGlyphs32(c->font, (unsigned char)text[i - 1], ch);
+                }
+                col++;
+                pen += glyph_advance(c, ch);
+            }
+            a->x[i + 1] = pen;
+        }
+    }
+
+    a->length = length;
+    return a;
+}
+
+int advance_cache_col_to_x(const LineAdvances* a, int col)
+{
+    if (col <= 0) return 0;
+    if (col > a->length) col = a->length;
+    return a->advance ? col * a->advance : a->x[col];
+}
+
+int advance_cache_x_to_col(const LineAdvances* a, int x)
+{
+    if (x <= 0) return 0;
+    if (x >= advance_cache_col_to_x(a, a->length)) return a->length;
+
+    // Round to the nearest column boundary
+    if (a->advance) return (x + a->advance / 2) / a->advance;
+
+    // Last column starting at or before x
+    int lo = 0, hi = a->length;
+    while (lo < hi)
+    {
+        int mid = (lo + hi + 1) / 2;
+        if (a->x[mid] <= x) lo = mid;
+        else hi = mid - 1;
+    }
+
+    // Snap to whichever side of the glyph is closer
+    if (lo < a->length && x - a->x[lo] > a->x[lo + 1] - x) lo++;
+    return lo;
+}
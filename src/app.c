@@ -10,9 +10,15 @@
 static kFileDialog dialog;
 
 static bool draw_help = false;
+static bool draw_stats = false;
 
-bool app_init(App* app)
+bool app_init(App* app, const AppOptions* options)
 {
+    app->options = *options;
+
+    // The dummy driver needs no display, frames are drawn in memory
+    if (options->headless) SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+
     if (SDL_Init(SDL_INIT_VIDEO) != 0) return false;
     if (TTF_Init() != 0) return false;
 
@@ -25,12 +31,22 @@ bool app_init(App* app)
 
     printf("[app] Window created.\n");
 
-    app->renderer = renderer_create(app->window.sdl_window);
+    ui_layer_init(&app->help_layer);
+
+    app->renderer = renderer_create(app->window.sdl_window, options->headless ? RENDERER_BACKEND_HEADLESS : RENDERER_BACKEND_GPU);
     if (!app->renderer) return false;
 
-    editor_init(&app->editor);
+    app->editor = editor_create();
+    if (!app->editor) return false;
 
-    editor_load_file(&app->editor, "test.txt");
+    editor_load_file(app->editor, options->file);
+
+    // Headless frames start from the whole file, so every run draws the same
+    while (options->headless && editor_is_loading(app->editor))
+    {
+        editor_update(app->editor, 0.0f);
+        SDL_Delay(1);
+    }
 
     SDL_StartTextInput();
 
@@ -40,44 +56,167 @@ bool app_init(App* app)
     return true;
 }
 
+// Window flags, a headless window always counts as shown and focused
+static Uint32 app_window_flags(App* app)
+{
+    if (app->options.headless) return SDL_WINDOW_SHOWN | SDL_WINDOW_INPUT_FOCUS;
+    return SDL_GetWindowFlags(app->window.sdl_window);
+}
+
+// Writes a headless frame to the dump directory, before it is presented
+static void app_dump_frame(App* app, int frame)
+{
+    if (!app->options.dump_dir) return;
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/frame_%05d.bmp", app->options.dump_dir, frame);
+    renderer_dump_frame(app->renderer, path);
+}
+
+/**
+ * Works out how long the app can sleep waiting for events.
+ * 
+ * @param app Pointer to app
+ * @param flags Window flags
+ * @param animating Whether the window animated last frame
+ * 
+ * @return Milliseconds to wait, or -1 to wait for the next event
+ */
+static int app_next_frame_ms(App* app, Uint32 flags, bool animating)
+{
+    int ms = editor_next_update_ms(app->editor);
+    if (animating || ms == 0 || renderer_glyphs_pending(app->renderer)) ms = APP_FRAME_MS;
+    if (ms < 0) return -1;
+
+    // Nothing needs to look smooth when the user is not looking
+    if ((flags & SDL_WINDOW_MINIMIZED) && ms < APP_MINIMIZED_POLL_MS) return APP_MINIMIZED_POLL_MS;
+    if ((flags & SDL_WINDOW_INPUT_FOCUS) == 0 && ms < APP_UNFOCUSED_FRAME_MS) return APP_UNFOCUSED_FRAME_MS;
+    return ms;
+}
+
+// Redraws everything kept in target textures, recreating them if the device was lost
+static void app_render_reset(App* app, bool device_lost)
+{
+    renderer_reset(app->renderer, device_lost);
+
+    if (device_lost)
+    {
+        ui_layer_destroy(&app->help_layer);
+        ui_layer_destroy(&app->window.titlebar_layer);
+        scroll_view_destroy(&app->editor->view);
+    }
+    else
+    {
+        ui_layer_invalidate(&app->help_layer);
+        ui_layer_invalidate(&app->window.titlebar_layer);
+        scroll_view_invalidate(&app->editor->view);
+    }
+}
+
+// Draws the help panel, relative to its top-left corner
+static void app_render_help(App* app)
+{
+    SDL_Color help_bg = {40, 40, 40, 200};
+    SDL_Color text_color = {255, 255, 255, 200};
+    TTF_Font* title_font = font_manager_get_font(FONT_DEFAULT_PATH, 18);
+    TTF_Font* heading_font = font_manager_get_font(FONT_DEFAULT_PATH, 16);
+    TTF_Font* text_font = font_manager_get_font(FONT_DEFAULT_PATH, 14);
+    if (draw_help)
+    {
+        renderer_draw_rect(app->renderer, 0, 0, 290, 600, help_bg);
+        renderer_draw_text(app->renderer, "Controls", 150, 10, title_font, ALIGN_CENTER, text_color);
+        renderer_draw_text(app->renderer, "F6 to close", 150, 30, text_font, ALIGN_CENTER, text_color);
+
+        renderer_draw_text(app->renderer, "Editor", 150, 70, heading_font, ALIGN_CENTER, text_color);
+
+        renderer_draw_text(app->renderer, "F1           : Decrease font size", 10, 90, text_font, ALIGN_LEFT, text_color);
+        renderer_draw_text(app->renderer, "F2           : Increase font size", 10, 110, text_font, ALIGN_LEFT, text_color);
+        renderer_draw_text(app->renderer, "F4           : Open file dialog", 10, 130, text_font, ALIGN_LEFT, text_color);
+        renderer_draw_text(app->renderer, "F5           : Save file", 10, 150, text_font, ALIGN_LEFT, text_color);
+        renderer_draw_text(app->renderer, "SHIFT + ARROW: Highlight text", 10, 170, text_font, ALIGN_LEFT, text_color);
+        renderer_draw_text(app->renderer, "CTRL + Z / Y : Undo / Redo", 10, 190, text_font, ALIGN_LEFT, text_color);
+        renderer_draw_text(app->renderer, "F7           : Render stats", 10, 210, text_font, ALIGN_LEFT, text_color);
+        renderer_draw_text(app->renderer, "F8           : Distance field text", 10, 230, text_font, ALIGN_LEFT, text_color);
+    
+        renderer_draw_text(app->renderer, "File Dialog", 150, 270, heading_font, ALIGN_CENTER, text_color);
+        renderer_draw_text(app->renderer, "ARROW : Navigate dialog", 10, 290, text_font, ALIGN_LEFT, text_color);
+        renderer_draw_text(app->renderer, "RETURN: Select file/folder", 10, 310, text_font, ALIGN_LEFT, text_color);
+    }
+    else
+    {
+        renderer_draw_rect(app->renderer, 0, 0, 290, 45, help_bg);
+        renderer_draw_text(app->renderer, "Press F6 for help", 150, 10, title_font, ALIGN_CENTER, text_color);
+    }
+}
+
 void app_run(App* app)
 {
     bool running = true;
+    bool dirty = true;      // Whether the screen is out of date
+    bool animating = false;
     kEvent event;
 
     Uint32 last_tick = SDL_GetTicks();
+    Uint32 start_tick = last_tick;
+    int frame = 0;
 
     while (running)
     {
+        // Headless runs draw every frame, as fast as they can
+        if (app->options.headless) dirty = true;
+
+        Uint32 flags = app_window_flags(app);
+        editor_set_focused(app->editor, (flags & SDL_WINDOW_INPUT_FOCUS) != 0);
+
+        // Sleep until input arrives or something is due to change
+        int timeout = dirty && !(flags & SDL_WINDOW_MINIMIZED) ? 0 : app_next_frame_ms(app, flags, animating);
+        int has_event = kWaitEventTimeout(&event, timeout);
+
         Uint32 current_tick = SDL_GetTicks();
         float delta_time = (current_tick - last_tick) / 1000.0f; // converted to seconds
         last_tick = current_tick;
 
-        app->editor.text_changed = false;
+        // Animations advance by whole frames, so headless frames do not depend on timing
+        if (app->options.headless) delta_time = APP_FRAME_MS / 1000.0f;
 
-        while (kPollEvent(&event))
+        app->editor->text_changed = false;
+
+        if (app->options.headless && app->options.scroll)
         {
+            kEvent step = { .type = KEVENT_KEYDOWN, .key = { KKEY_DOWN, KKEYMOD_NONE } };
+            input_handle_event(app->editor, &step);
+        }
+
+        for (; has_event; has_event = kPollEvent(&event))
+        {
+            // Only events that change what is drawn need a new frame
             if (event.type == KEVENT_QUIT) running = false;
+            else if (event.type == KEVENT_RENDER_RESET)
+            {
+                app_render_reset(app, event.reset.device_lost != 0);
+                dirty = true;
+            }
             else
             {
                 // Send event to window
-                window_handle_event(&app->window, &event);
+                if (window_handle_event(&app->window, &event)) dirty = true;
 
                 // If in editor state, send event to editor event handler
                 // Else if in file dialog state, send event to file dialog
                 if (app->state == APP_STATE_EDITOR)
                 {
-                    input_handle_event(&app->editor, &event);  
+                    if (input_handle_event(app->editor, &event)) dirty = true;
                 }
                 else if (app->state == APP_STATE_FILE_DIALOG)
                 {
-                    kFileDialog_handle_event(&dialog, &event);
+                    if (kFileDialog_handle_event(&dialog, &event)) dirty = true;
                     if (!kFileDialog_is_open(&dialog))
                     {
+                        dirty = true;
                         // Only attempt to load the file if one was selected
                         if (*dialog.selected_file != '\0')
                         {
-                            if(!editor_load_file(&app->editor, kFileDialog_get_selected(&dialog)))
+                            if(!editor_load_file(app->editor, kFileDialog_get_selected(&dialog)))
                             {
                                 fprintf(stderr, "Failed to load file: %s\n", kFileDialog_get_selected(&dialog));
                             }
@@ -98,45 +237,62 @@ void app_run(App* app)
                         kFileDialog_open(&dialog);
                         app->state = APP_STATE_FILE_DIALOG;
                     }
-                    
+                    dirty = true;
                 }
 
                 if (event.type == KEVENT_KEYDOWN && event.key.sym == KKEY_F6)
                 {
                     draw_help = !draw_help;
+                    dirty = true;
+                }
+
+                if (event.type == KEVENT_KEYDOWN && event.key.sym == KKEY_F7)
+                {
+                    draw_stats = !draw_stats;
+                    dirty = true;
                 }
             }
         }
 
-        renderer_clear(app->renderer);    
+        animating = window_update(&app->window, delta_time);
+        if (editor_update(app->editor, delta_time)) dirty = true;
+        if (animating) dirty = true;
 
-        window_update(&app->window, delta_time);
-        editor_update(&app->editor, delta_time);
+        // Glyphs rasterized off-thread since the last frame, drawn blank until now
+        if (renderer_upload_glyphs(app->renderer, APP_GLYPH_UPLOAD_MS)) dirty = true;
+
+        // Keep the last frame on screen until something changes
+        flags = app_window_flags(app);
+        if (!dirty || (flags & SDL_WINDOW_MINIMIZED)) continue;
+        dirty = false;
+
+        renderer_clear(app->renderer);
 
         window_render(&app->window, app->renderer);
         
         SDL_Rect editor_bounds = { 0, TITLEBAR_HEIGHT + 5, WINDOW_WIDTH, WINDOW_HEIGHT - TITLEBAR_HEIGHT - 5 };
         if (app->state == APP_STATE_EDITOR)
         {
-            SDL_RenderSetViewport(app->renderer->sdl_renderer, &editor_bounds);
-            app->editor.viewport_width  = editor_bounds.w;
-            app->editor.viewport_height = editor_bounds.h;
-            editor_render(&app->editor, app->renderer);
-            SDL_RenderSetViewport(app->renderer->sdl_renderer, NULL);
+            renderer_set_viewport(app->renderer, &editor_bounds);
+            app->editor->viewport_x      = editor_bounds.x;
+            app->editor->viewport_y      = editor_bounds.y;
+            app->editor->viewport_width  = editor_bounds.w;
+            app->editor->viewport_height = editor_bounds.h;
+            editor_render(app->editor, app->renderer);
+            renderer_set_viewport(app->renderer, NULL);
         }
         else if (app->state == APP_STATE_FILE_DIALOG)
         {
-            SDL_RenderSetViewport(app->renderer->sdl_renderer, &editor_bounds);
+            renderer_set_viewport(app->renderer, &editor_bounds);
             dialog.x = editor_bounds.x;
             dialog.y = editor_bounds.y;
             dialog.w = editor_bounds.w;
             dialog.h = editor_bounds.h;
             //kFileDialog_open(&dialog);
             kFileDialog_render(&dialog, app->renderer);
-            SDL_RenderSetViewport(app->renderer->sdl_renderer, NULL);
+            renderer_set_viewport(app->renderer, NULL);
         }
 
-        Uint32 flags = SDL_GetWindowFlags(app->window.sdl_window);
         if ((flags & SDL_WINDOW_INPUT_FOCUS) == 0)
         {
             SDL_Color unfocus_color = {40, 40, 40, 100};
@@ -149,38 +305,43 @@ void app_run(App* app)
         // sprintf(fps_buffer, "%.0f", 1.0f / (delta_time > 0.0001f ? delta_time : 0.0001f));
         // renderer_draw_text(app->renderer, fps_buffer, WINDOW_WIDTH - 100, 20, font_manager_get_font("resources/fonts/SourceCodePro-Bold.ttf", 12), ALIGN_CENTER, fps_color);
 
-        SDL_Color help_bg = {40, 40, 40, 200};
-        SDL_Color text_color = {255, 255, 255, 200};
-        if (draw_help)
+        // Visualise submissions of the previous frame
+        if (draw_stats)
         {
-            renderer_draw_rect(app->renderer, WINDOW_WIDTH - 300, 40, 290, 600, help_bg);
-            renderer_draw_text(app->renderer, "Controls", WINDOW_WIDTH - 300 + 150, 50, font_manager_get_font("resources/fonts/SourceCodePro-Bold.ttf", 18), ALIGN_CENTER, text_color);
-            renderer_draw_text(app->renderer, "F6 to close", WINDOW_WIDTH - 300 + 150, 70, font_manager_get_font("resources/fonts/SourceCodePro-Bold.ttf", 14), ALIGN_CENTER, text_color);
-
-            renderer_draw_text(app->renderer, "Editor", WINDOW_WIDTH - 300 + 150, 110, font_manager_get_font("resources/fonts/SourceCodePro-Bold.ttf", 16), ALIGN_CENTER, text_color);
-
-            renderer_draw_text(app->renderer, "F1           : Decrease font size", WINDOW_WIDTH - 300 + 10, 130, font_manager_get_font("resources/fonts/SourceCodePro-Bold.ttf", 14), ALIGN_LEFT, text_color);
-            renderer_draw_text(app->renderer, "F2           : Increase font size", WINDOW_WIDTH - 300 + 10, 150, font_manager_get_font("resources/fonts/SourceCodePro-Bold.ttf", 14), ALIGN_LEFT, text_color);
-            renderer_draw_text(app->renderer, "F4           : Open file dialog", WINDOW_WIDTH - 300 + 10, 170, font_manager_get_font("resources/fonts/SourceCodePro-Bold.ttf", 14), ALIGN_LEFT, text_color);
-            renderer_draw_text(app->renderer, "F5           : Save file", WINDOW_WIDTH - 300 + 10, 190, font_manager_get_font("resources/fonts/SourceCodePro-Bold.ttf", 14), ALIGN_LEFT, text_color);
-            renderer_draw_text(app->renderer, "SHIFT + ARROW: Highlight text", WINDOW_WIDTH - 300 + 10, 210, font_manager_get_font("resources/fonts/SourceCodePro-Bold.ttf", 14), ALIGN_LEFT, text_color);
-        
-            renderer_draw_text(app->renderer, "File Dialog", WINDOW_WIDTH - 300 + 150, 250, font_manager_get_font("resources/fonts/SourceCodePro-Bold.ttf", 16), ALIGN_CENTER, text_color);
-            renderer_draw_text(app->renderer, "ARROW : Navigate dialog", WINDOW_WIDTH - 300 + 10, 270, font_manager_get_font("resources/fonts/SourceCodePro-Bold.ttf", 14), ALIGN_LEFT, text_color);
-            renderer_draw_text(app->renderer, "RETURN: Select file/folder", WINDOW_WIDTH - 300 + 10, 290, font_manager_get_font("resources/fonts/SourceCodePro-Bold.ttf", 14), ALIGN_LEFT, text_color);
+            SDL_Color stats_color = {255, 255, 255, 255};
+            char stats_buffer[100];
+            RenderStats stats = renderer_get_stats(app->renderer);
+            snprintf(stats_buffer, sizeof(stats_buffer), "%d draw calls, %d vertices", stats.draw_calls, stats.vertices);
+            renderer_draw_text(app->renderer, stats_buffer, WINDOW_WIDTH - 310, 20, font_manager_get_font(FONT_DEFAULT_PATH, 12), ALIGN_RIGHT, stats_color);
         }
-        else
+
+        // Help panel, drawn again only when toggled
+        int help_height = draw_help ? 600 : 45;
+        if (ui_layer_begin(&app->help_layer, app->renderer, WINDOW_WIDTH - 300, 40, 290, help_height, draw_help))
         {
-            renderer_draw_rect(app->renderer, WINDOW_WIDTH - 300, 40, 290, 45, help_bg);
-            renderer_draw_text(app->renderer, "Press F6 for help", WINDOW_WIDTH - 300 + 150, 50, font_manager_get_font("resources/fonts/SourceCodePro-Bold.ttf", 18), ALIGN_CENTER, text_color);
+            app_render_help(app);
         }
+        ui_layer_end(&app->help_layer, app->renderer);
 
+        if (app->options.headless) app_dump_frame(app, frame);
         renderer_present(app->renderer);
+
+        frame++;
+        if (app->options.headless && app->options.frames > 0 && frame >= app->options.frames) running = false;
+    }
+
+    if (app->options.headless && frame > 0)
+    {
+        Uint32 elapsed = SDL_GetTicks() - start_tick;
+        printf("[app] Drew %d frames in %u ms (%.2f ms per frame)\n", frame, elapsed, (float)elapsed / frame);
     }
 }
 
 void app_cleanup(App* app)
 {
+    editor_destroy(app->editor);
+    ui_layer_destroy(&app->help_layer);
+    ui_layer_destroy(&app->window.titlebar_layer);
     renderer_destroy(app->renderer);
     if (app->window.sdl_window) SDL_DestroyWindow(app->window.sdl_window);
     SDL_StopTextInput();
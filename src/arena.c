@@ -0,0 +1,150 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// ----------------------------------------------------------------
+// Arena
+// ----------------------------------------------------------------
+
+static ArenaBlock* arena_new_block(Arena* a, size_t min_size)
+{
+    size_t size = a->next_block_size;
+    while (size < min_size) size *= 2;
+
+    ArenaBlock* block = malloc(sizeof(ArenaBlock) + size);
+    if (!block)
+    {
+        fprintf(stderr, "[arena] Failed to allocate %zu byte block.\n", size);
+        return NULL;
+    }
+
+    block->next = a->head;
+    block->size = size;
+    block->used = 0;
+
+    a->head = block;
+    a->total_size += size;
+    if (a->next_block_size < ARENA_MAX_BLOCK_SIZE) a->next_block_size *= 2;
+
+    return block;
+}
+
+void arena_init(Arena* a)
+{
+    a->head = NULL;
+    a->next_block_size = ARENA_MIN_BLOCK_SIZE;
+    a->total_size = 0;
+}
+
+void arena_destroy(Arena* a)
+{
+    ArenaBlock* block = a->head;
+    while (block)
+    {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    arena_init(a);
+}
+
+void arena_reset(Arena* a)
+{
+    if (!a->head) return;
+
+    // Keep the newest (largest) block
+    ArenaBlock* keep = a->head;
+    ArenaBlock* block = keep->next;
+    while (block)
+    {
+        ArenaBlock* next = block->next;
+        a->total_size -= block->size;
+        free(block);
+        block = next;
+    }
+
+    keep->next = NULL;
+    keep->used = 0;
+}
+
+void* arena_alloc(Arena* a, size_t size, size_t align)
+{
+    ArenaBlock* block = a->head;
+    if (block)
+    {
+        uintptr_t base = (uintptr_t)block->data;
+        uintptr_t aligned = (base + block->used + align - 1) & ~(uintptr_t)(align - 1);
+        size_t offset = aligned - base;
+        if (offset + size <= block->size)
+        {
+            block->used = offset + size;
+            return block->data + offset;
+        }
+    }
+
+    block = arena_new_block(a, size + align);
+    if (!block) return NULL;
+
+    uintptr_t base = (uintptr_t)block->data;
+    size_t offset = ((base + align - 1) & ~(uintptr_t)(align - 1)) - base;
+    block->used = offset + size;
+    return block->data + offset;
+}
+
+bool arena_extend(Arena* a, const void* end, size_t size)
+{
+    ArenaBlock* block = a->head;
+    if (!block || (const char*)end != block->data + block->used) return false;
+    if (block->size - block->used < size) return false;
+
+    block->used += size;
+    return true;
+}
+
+// ----------------------------------------------------------------
+// Pool
+// ----------------------------------------------------------------
+
+void pool_init(Pool* p, size_t object_size)
+{
+    arena_init(&p->arena);
+
+    // Freed objects store the free list link in place
+    p->object_size = object_size < sizeof(void*) ? sizeof(void*) : object_size;
+    p->free_list = NULL;
+    p->count = 0;
+}
+
+void pool_destroy(Pool* p)
+{
+    arena_destroy(&p->arena);
+    p->free_list = NULL;
+    p->count = 0;
+}
+
+void* pool_alloc(Pool* p)
+{
+    void* object = p->free_list;
+    if (object)
+    {
+        p->free_list = *(void**)object;
+    }
+    else
+    {
+        object = arena_alloc(&p->arena, p->object_size, sizeof(void*));
+        if (!object) return NULL;
+    }
+
+    p->count++;
+    return object;
+}
+
+void pool_free(Pool* p, void* object)
+{
+    if (!object) return;
+
+    *(void**)object = p->free_list;
+    p->free_list = object;
+    p->count--;
+}
@@ -0,0 +1,359 @@
+#include "atlas_cache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define ATLAS_CACHE_MAGIC       "KATL"
+#define ATLAS_CACHE_HEADER_SIZE 16
+
+static int atlas_mode(const GlyphAtlas* atlas)
+{
+    return atlas->sdf ? ATLAS_MODE_SDF : ATLAS_MODE_BLENDED;
+}
+
+// Rows of coverage worth keeping per page, everything below the last shelf is empty
+static int page_rows(const GlyphAtlas* atlas, int page)
+{
+    if (page < atlas->page_count - 1) return GLYPH_ATLAS_PAGE_SIZE;
+
+    int rows = atlas->shelf_y + atlas->shelf_height;
+    return rows < GLYPH_ATLAS_PAGE_SIZE ? rows : GLYPH_ATLAS_PAGE_SIZE;
+}
+
+// FNV-1a, enough to tell a damaged record from a saved one
+static uint32_t atlas_checksum(uint32_t h, const void* data, size_t length)
+{
+    const unsigned char* p = data;
+    for (size_t i = 0; i < length; i++)
+    {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Checksum of a record's fields, its coverage is added by the caller. The
+// pixels offset changes whenever the file is rewritten and is left out
+static uint32_t record_checksum(const AtlasCacheRecord* rec)
+{
+    AtlasCacheRecord copy = *rec;
+    copy.pixels = 0;
+    copy.checksum = 0;
+    return atlas_checksum(2166136261u, &copy, sizeof(copy));
+}
+
+static bool glyph_valid(const AtlasCacheRecord* rec, const AtlasCacheGlyph* glyph)
+{
+    if (!glyph->loaded || glyph->page == -1) return true; // Nothing to draw, e.g. a space
+    if (glyph->page < 0 || glyph->page >= rec->page_count) return false;
+
+    return glyph->x >= 0 && glyph->w >= 0 && glyph->x + glyph->w <= GLYPH_ATLAS_PAGE_SIZE &&
+           glyph->y >= 0 && glyph->h >= 0 && glyph->y + glyph->h <= rec->page_rows[glyph->page];
+}
+
+// Whether a mapped record only points within its own pages and is intact
+static bool record_valid(const AtlasCache* c, const AtlasCacheRecord* rec)
+{
+    if (rec->page_count < 0 || rec->page_count > GLYPH_ATLAS_MAX_PAGES) return false;
+
+    uint64_t size = 0;
+    for (int i = 0; i < rec->page_count; i++)
+    {
+        if (rec->page_rows[i] < 0 || rec->page_rows[i] > GLYPH_ATLAS_PAGE_SIZE) return false;
+        size += (uint64_t)rec->page_rows[i] * GLYPH_ATLAS_PAGE_SIZE;
+    }
+    if (size != rec->pixels_size || rec->pixels > c->map.size || rec->pixels_size > c->map.size - rec->pixels) return false;
+
+    // New glyphs are placed from the shelf, it must lie within the stored rows
+    int last_rows = rec->page_count > 0 ? rec->page_rows[rec->page_count - 1] : 0;
+    if (rec->shelf_x < 0 || rec->shelf_x > GLYPH_ATLAS_PAGE_SIZE || rec->shelf_y < 0 || rec->shelf_height < 0 ||
+        rec->shelf_y + rec->shelf_height > last_rows)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < GLYPH_ATLAS_GLYPHS; i++)
+    {
+        if (!glyph_valid(rec, &rec->glyphs[i])) return false;
+    }
+
+    uint32_t checksum = atlas_checksum(record_checksum(rec), (const uint8_t*)c->map.data + rec->pixels, rec->pixels_size);
+    return checksum == rec->checksum;
+}
+
+static const AtlasCacheRecord* find_record(const AtlasCache* c, uint64_t font_hash, int size, int mode)
+{
+    for (uint32_t i = 0; i < c->count; i++)
+    {
+        const AtlasCacheRecord* rec = &c->records[i];
+        if (rec->font_hash == font_hash && rec->size == size && rec->mode == mode) return rec;
+    }
+    return NULL;
+}
+
+bool atlas_cache_open(AtlasCache* c, const char* path)
+{
+    memset(c, 0, sizeof(AtlasCache));
+    if (!kFileMap_open(&c->map, path)) return false;
+    c->mapped = true;
+
+    uint32_t header[4];
+    if (c->map.size < ATLAS_CACHE_HEADER_SIZE)
+    {
+        atlas_cache_close(c);
+        return false;
+    }
+    memcpy(header, c->map.data, sizeof(header));
+
+    uint32_t count = header[2];
+    if (memcmp(c->map.data, ATLAS_CACHE_MAGIC, 4) != 0 || header[1] != ATLAS_CACHE_VERSION ||
+        header[3] != GLYPH_ATLAS_PAGE_SIZE ||
+        count > (c->map.size - ATLAS_CACHE_HEADER_SIZE) / sizeof(AtlasCacheRecord))
+    {
+        fprintf(stderr, "[atlas_cache] Ignoring outdated or damaged cache %s\n", path);
+        atlas_cache_close(c);
+        return false;
+    }
+
+    c->records = (const AtlasCacheRecord*)(c->map.data + ATLAS_CACHE_HEADER_SIZE);
+    c->count = count;
+    printf("[atlas_cache] Mapped %u atlases from %s (%.1f KB)\n", count, path, c->map.size / 1024.0);
+    return true;
+}
+
+void atlas_cache_close(AtlasCache* c)
+{
+    if (c->mapped) kFileMap_close(&c->map);
+    c->mapped = false;
+    c->records = NULL;
+    c->count = 0;
+}
+
+bool atlas_cache_restore(AtlasCache* c, GlyphAtlas* atlas)
+{
+    if (atlas->font_hash == 0 || atlas->page_count > 0) return false;
+
+    const AtlasCacheRecord* rec = find_record(c, atlas->font_hash, atlas->size, atlas_mode(atlas));
+    if (!rec || !record_valid(c, rec)) return false;
+
+    // Metrics differ with the SDL_ttf build, rather rasterize again than misplace glyphs
+    if (rec->height != atlas->height || (rec->kerning != 0) != atlas->kerning) return false;
+
+    const Uint8* pixels = (const Uint8*)c->map.data + rec->pixels;
+    for (int i = 0; i < rec->page_count; i++)
+    {
+        if (!glyph_atlas_upload_page(atlas, pixels, rec->page_rows[i])) return false;
+        pixels += (size_t)rec->page_rows[i] * GLYPH_ATLAS_PAGE_SIZE;
+    }
+
+    for (int i = 0; i < GLYPH_ATLAS_GLYPHS; i++)
+    {
+        const AtlasCacheGlyph* src = &rec->glyphs[i];
+        AtlasGlyph* glyph = &atlas->glyphs[i];
+        if (!src->loaded) continue;
+
+        glyph->loaded = true;
+        glyph->page = src->page;
+        glyph->src.x = src->x;
+        glyph->src.y = src->y;
+        glyph->src.w = src->w;
+        glyph->src.h = src->h;
+        glyph->offset_x = src->offset_x;
+        glyph->advance = src->advance;
+    }
+
+    atlas->digit_width = rec->digit_width;
+    atlas->shelf_x = rec->shelf_x;
+    atlas->shelf_y = rec->shelf_y;
+    atlas->shelf_height = rec->shelf_height;
+    atlas->dirty = false;
+    c->restored++;
+    return true;
+}
+
+static void record_from_atlas(AtlasCacheRecord* rec, const GlyphAtlas* atlas, uint32_t session)
+{
+    memset(rec, 0, sizeof(AtlasCacheRecord));
+    rec->last_used = session;
+    rec->font_hash = atlas->font_hash;
+    rec->size = atlas->size;
+    rec->mode = atlas_mode(atlas);
+    rec->height = atlas->height;
+    rec->kerning = atlas->kerning;
+    rec->digit_width = atlas->digit_width;
+    rec->page_count = atlas->page_count;
+    rec->shelf_x = atlas->shelf_x;
+    rec->shelf_y = atlas->shelf_y;
+    rec->shelf_height = atlas->shelf_height;
+
+    for (int i = 0; i < atlas->page_count; i++)
+    {
+        rec->page_rows[i] = page_rows(atlas, i);
+        rec->pixels_size += (uint64_t)rec->page_rows[i] * GLYPH_ATLAS_PAGE_SIZE;
+    }
+
+    // A full shelf or page only starts a new one, keep the shelf within the stored rows
+    int last_rows = atlas->page_count > 0 ? rec->page_rows[atlas->page_count - 1] : 0;
+    if (rec->shelf_x > GLYPH_ATLAS_PAGE_SIZE) rec->shelf_x = GLYPH_ATLAS_PAGE_SIZE;
+    if (rec->shelf_y > last_rows) rec->shelf_y = last_rows;
+    if (rec->shelf_y + rec->shelf_height > last_rows) rec->shelf_height = last_rows - rec->shelf_y;
+
+    for (int i = 0; i < GLYPH_ATLAS_GLYPHS; i++)
+    {
+        const AtlasGlyph* glyph = &atlas->glyphs[i];
+        AtlasCacheGlyph* dst = &rec->glyphs[i];
+        dst->loaded = glyph->loaded && !glyph->pending; // Rasterized again next session
+        dst->page = (int16_t)glyph->page;
+        dst->x = (int16_t)glyph->src.x;
+        dst->y = (int16_t)glyph->src.y;
+        dst->w = (int16_t)glyph->src.w;
+        dst->h = (int16_t)glyph->src.h;
+        dst->offset_x = (int16_t)glyph->offset_x;
+        dst->advance = (int16_t)glyph->advance;
+    }
+
+    uint32_t checksum = record_checksum(rec);
+    for (int i = 0; i < atlas->page_count; i++)
+    {
+        checksum = atlas_checksum(checksum, atlas->page_alpha[i], (size_t)rec->page_rows[i] * GLYPH_ATLAS_PAGE_SIZE);
+    }
+    rec->checksum = checksum;
+}
+
+// Most recently used first
+static int compare_last_used(const void* a, const void* b)
+{
+    uint32_t x = (*(const AtlasCacheRecord* const*)a)->last_used;
+    uint32_t y = (*(const AtlasCacheRecord* const*)b)->last_used;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+// Queues a span, writing the queued ones first if there is no room
+static bool write_span(kFileWriter* w, kFileSpan* spans, int* count, const void* data, size_t size)
+{
+    if (size == 0) return true;
+    if (*count == KFILE_MAX_SPANS)
+    {
+        if (!kFileWriter_write(w, spans, *count)) return false;
+        *count = 0;
+    }
+    spans[(*count)++] = (kFileSpan){ data, size };
+    return true;
+}
+
+bool atlas_cache_save(AtlasCache* c, const char* path, GlyphAtlas* const* atlases, int count)
+{
+    bool dirty = false;
+    for (int i = 0; i < count; i++)
+    {
+        if (atlases[i] && atlases[i]->font_hash && atlases[i]->dirty) dirty = true;
+    }
+    if (!dirty)
+    {
+        atlas_cache_close(c);
+        return true;
+    }
+
+    // Live atlases first, then the most recently used records of fonts not drawn with this session
+    AtlasCacheRecord* records = malloc(ATLAS_CACHE_MAX_RECORDS * sizeof(AtlasCacheRecord));
+    const AtlasCacheRecord** carried = malloc(((size_t)c->count + 1) * sizeof(AtlasCacheRecord*));
+    kFileSpan* spans = malloc(KFILE_MAX_SPANS * sizeof(kFileSpan));
+    if (!records || !carried || !spans)
+    {
+        free(records);
+        free(carried);
+        free(spans);
+        atlas_cache_close(c);
+        return false;
+    }
+
+    uint32_t session = 1;
+    for (uint32_t i = 0; i < c->count; i++)
+    {
+        if (c->records[i].last_used >= session) session = c->records[i].last_used + 1;
+    }
+
+    uint32_t record_count = 0;
+    for (int i = 0; i < count && record_count < ATLAS_CACHE_MAX_RECORDS; i++)
+    {
+        if (atlases[i] && atlases[i]->font_hash) record_from_atlas(&records[record_count++], atlases[i], session);
+    }
+    uint32_t live_count = record_count;
+
+    uint32_t carried_count = 0;
+    for (uint32_t i = 0; i < c->count; i++)
+    {
+        const AtlasCacheRecord* old = &c->records[i];
+        bool replaced = false;
+        for (uint32_t j = 0; j < live_count && !replaced; j++)
+        {
+            replaced = records[j].font_hash == old->font_hash && records[j].size == old->size && records[j].mode == old->mode;
+        }
+        if (!replaced && record_valid(c, old)) carried[carried_count++] = old;
+    }
+    qsort(carried, carried_count, sizeof(AtlasCacheRecord*), compare_last_used);
+    for (uint32_t i = 0; i < carried_count && record_count < ATLAS_CACHE_MAX_RECORDS; i++)
+    {
+        records[record_count++] = *carried[i];
+    }
+    free(carried);
+
+    // Coverage follows the records, in the same order
+    uint64_t offset = ATLAS_CACHE_HEADER_SIZE + (uint64_t)record_count * sizeof(AtlasCacheRecord);
+    const uint8_t** sources = malloc(record_count * sizeof(uint8_t*));
+    if (!sources)
+    {
+        free(records);
+        free(spans);
+        atlas_cache_close(c);
+        return false;
+    }
+    for (uint32_t i = 0; i < record_count; i++)
+    {
+        sources[i] = i < live_count ? NULL : (const uint8_t*)c->map.data + records[i].pixels;
+        records[i].pixels = offset;
+        offset += records[i].pixels_size;
+    }
+
+    uint32_t header[4] = { 0, ATLAS_CACHE_VERSION, record_count, GLYPH_ATLAS_PAGE_SIZE };
+    memcpy(header, ATLAS_CACHE_MAGIC, 4);
+
+    kFileWriter w;
+    bool opened = kFileWriter_open(&w, path);
+    bool ok = opened;
+    int span_count = 0;
+    ok = ok && write_span(&w, spans, &span_count, header, sizeof(header));
+    ok = ok && write_span(&w, spans, &span_count, records, record_count * sizeof(AtlasCacheRecord));
+
+    uint32_t live = 0;
+    for (int i = 0; i < count && ok; i++)
+    {
+        const GlyphAtlas* atlas = atlases[i];
+        if (!atlas || !atlas->font_hash) continue;
+        if (live == live_count) break;
+
+        const AtlasCacheRecord* rec = &records[live++];
+        for (int p = 0; p < atlas->page_count && ok; p++)
+        {
+            ok = write_span(&w, spans, &span_count, atlas->page_alpha[p], (size_t)rec->page_rows[p] * GLYPH_ATLAS_PAGE_SIZE);
+        }
+    }
+    for (uint32_t i = live_count; i < record_count && ok; i++)
+    {
+        ok = write_span(&w, spans, &span_count, sources[i], records[i].pixels_size);
+    }
+    ok = ok && (span_count == 0 || kFileWriter_write(&w, spans, span_count));
+
+    // Mapped files cannot be replaced on every platform, the old data is written by now
+    atlas_cache_close(c);
+    if (ok) ok = kFileWriter_commit(&w);
+    else if (opened) kFileWriter_abort(&w);
+
+    if (ok) printf("[atlas_cache] Saved %u atlases to %s (%.1f KB)\n", record_count, path, offset / 1024.0);
+    else fprintf(stderr, "[atlas_cache] Failed to save %s\n", path);
+
+    free(sources);
+    free(records);
+    free(spans);
+    return ok;
+}
@@ -3,31 +3,208 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <limits.h>
 
 #include "theme.h"
 
 static void set_current_font(Editor* e, const char* fontname, int fontsize)
 {
-    size_t len = strlen("resources/fonts/") + strlen(fontname) + 1;
-    char* font_path = malloc(len);
-    if (font_path)
+    char font_path[256];
+    snprintf(font_path, sizeof(font_path), "resources/fonts/%s", fontname);
+    if (fontsize < EDITOR_MIN_FONT_SIZE) fontsize = EDITOR_MIN_FONT_SIZE;
+
+    e->font_size = fontsize;
+    e->gutter_digits = 0;
+    e->atlas_prewarm = 0;
+
+    // Every size is resampled from the one distance field, nothing to open
+    e->sdf = e->sdf_text ? font_manager_sdf(font_path) : NULL;
+    if (e->sdf)
     {
-        snprintf(font_path, len, "resources/fonts/%s", fontname);
-        e->current_font = font_manager_get_font(font_path, fontsize);
-        e->line_height = TTF_FontLineSkip(e->current_font);
-        free(font_path);
+        e->font_handle = font_manager_find(e->sdf->font);
+        e->current_font = e->sdf->font;
+        e->line_height = sdf_font_line_skip(e->sdf, fontsize);
+        advance_cache_set_sdf(&e->advances, e->sdf, fontsize);
+        return;
     }
+
+    e->font_handle = font_manager_load(font_path, fontsize);
+    e->current_font = font_manager_font(e->font_handle);
+    e->line_height = TTF_FontLineSkip(e->current_font);
+    advance_cache_set_font(&e->advances, e->current_font);
+
+    // The next zoom step in either direction is then ready when asked for
+    font_manager_prewarm(font_path, fontsize - 1);
+    font_manager_prewarm(font_path, fontsize + 1);
+    e->atlas_prewarm = 3;
+}
+
+// Fills the atlases of the next zoom steps once their fonts have been opened
+static void editor_prewarm_atlases(Editor* e, struct Renderer* r)
+{
+    const char* path = font_manager_path(e->font_handle);
+    for (int step = 0; step < 2; step++)
+    {
+        if (!(e->atlas_prewarm & (1 << step))) continue;
+
+        TTF_Font* font = font_manager_peek(path, step ? e->font_size + 1 : e->font_size - 1);
+        if (!font) continue;
+
+        renderer_prewarm_atlas(r, font);
+        e->atlas_prewarm &= ~(1 << step);
+    }
+}
+
+// Atlas text is drawn with, either the font's or its distance field's
+static GlyphAtlas* editor_text_atlas(Editor* e, struct Renderer* r)
+{
+    if (e->sdf) return renderer_get_sdf_atlas(r, e->sdf, e->font_size);
+    return renderer_get_atlas(r, e->current_font);
+}
+
+static size_t editor_num_lines(Editor* e)
+{
+    return text_buffer_line_count(e->buffer);
+}
+
+// Columns are ints, a longer line is only reachable up to INT_MAX
+static int editor_line_length(Editor* e, size_t line)
+{
+    size_t length = text_buffer_line_length(e->buffer, line);
+    return length < INT_MAX ? (int)length : INT_MAX;
+}
+
+static size_t editor_offset(Editor* e, size_t line, int col)
+{
+    return text_buffer_line_start(e->buffer, line) + col;
+}
+
+// Lines have a uniform height, so line <-> y mapping is arithmetic. Content
+// y is 64-bit, a file of 100M+ lines is taller than an int can count
+static int64_t editor_line_to_y(Editor* e, size_t line)
+{
+    return (int64_t)line * e->line_height;
+}
+
+static size_t editor_y_to_line(Editor* e, int64_t y)
+{
+    return y > 0 ? (size_t)(y / e->line_height) : 0;
+}
+
+/**
+ * Copies a line into the editor's line arena
+ * 
+ * @param e Pointer to the editor state
+ * @param line Line to fetch
+ * @param max_length Maximum number of bytes to fetch
+ * 
+ * @return Line text and length, valid until the line arena is next reset
+ */
+static EditorLine editor_get_line(Editor* e, size_t line, size_t max_length)
+{
+    size_t len = text_buffer_line_length(e->buffer, line);
+    if (len > max_length) len = max_length;
+
+    EditorLine result = { "", 0 };
+    char* text = arena_alloc(&e->line_arena, len + 1, 1);
+    if (!text) return result;
+
+    text_buffer_copy(e->buffer, text_buffer_line_start(e->buffer, line), len, text);
+    text[len] = '\0';
+
+    result.text = text;
+    result.length = (int)len;
+    return result;
+}
+
+// Tabs are drawn as spaces up to the next tab stop, like they are measured
+static EditorLine editor_expand_tabs(Editor* e, EditorLine line)
+{
+    if (!memchr(line.text, '\t', line.length)) return line;
+
+    char* expanded = arena_alloc(&e->line_arena, (size_t)line.length * EDITOR_TAB_WIDTH + 1, 1);
+    if (!expanded) return line;
+
+    line.length = advance_cache_expand_tabs(line.text, line.length, EDITOR_TAB_WIDTH, expanded);
+    line.text = expanded;
+    return line;
+}
+
+/**
+ * Retrieves the x position of every column of a line, measuring it if it
+ * changed since it was last measured
+ * 
+ * @param e Pointer to the editor state
+ * @param line Line to measure
+ * 
+ * @return Advances of the line, or NULL on error
+ */
+static const LineAdvances* editor_line_advances(Editor* e, size_t line)
+{
+    int length = editor_line_length(e, line);
+    if (length > EDITOR_MAX_RENDER_LENGTH) length = EDITOR_MAX_RENDER_LENGTH;
+
+    uint64_t hash = text_buffer_line_hash(e->buffer, line);
+    const LineAdvances* advances = advance_cache_find(&e->advances, hash, length);
+    if (advances) return advances;
+
+    EditorLine text = editor_get_line(e, line, EDITOR_MAX_RENDER_LENGTH);
+    return advance_cache_build(&e->advances, hash, text.text, text.length);
+}
+
+static int editor_col_to_x(Editor* e, size_t line, int col)
+{
+    const LineAdvances* advances = editor_line_advances(e, line);
+    return advances ? advance_cache_col_to_x(advances, col) : 0;
+}
+
+// Edits go through these so they can be undone
+static void editor_edit_insert(Editor* e, size_t offset, const char* text, size_t length)
+{
+    e->undo_lost = !undo_record_insert(&e->undo, offset, text, length);
+    if (e->journal) journal_record_insert(e->journal, offset, text, length);
+    text_buffer_insert(e->buffer, offset, text, length);
+}
+
+static void editor_edit_delete(Editor* e, size_t offset, size_t length)
+{
+    e->undo_lost = !undo_record_delete(&e->undo, e->buffer, offset, length);
+    if (e->journal) journal_record_delete(e->journal, offset, length);
+    text_buffer_delete(e->buffer, offset, length);
+}
+
+static void editor_reset_view(Editor* e)
+{
+    e->scroll_offset_x = 0;
+    e->scroll_offset_y = 0;
+    e->scroll_y = 0.0;
+
+    e->cursor_line = 0;
+    e->cursor_col = 0;
+    e->cursor_timer = 0.0f;
+    e->cursor_alpha = 1.0f;
+    e->cursor_cooldown = 1.0f;
+    e->cursor_idle_time = 0.0f;
+
+    e->is_selecting = false;
+    e->selection_start_line = 0;
+    e->selection_start_col = 0;
+    e->selection_end_line = 0;
+    e->selection_end_col = 0;
+    
+    e->text_changed = false;
+    e->is_saved = true;
 }
 
 static void editor_clamp_scroll_y(Editor* e)
 {
-    int content_height = e->num_lines * e->line_height + 25; // 25 = infobar height
-    int max_scroll = content_height - (e->viewport_height + 25) + (e->line_height * e->cursor_margin_lines_y);
+    int64_t content_height = editor_line_to_y(e, editor_num_lines(e)) + 25; // 25 = infobar height
+    int64_t max_scroll = content_height - (e->viewport_height + 25) + (e->line_height * e->cursor_margin_lines_y);
     if (max_scroll < 0) max_scroll = 0;
     if (e->scroll_offset_y > max_scroll) e->scroll_offset_y = max_scroll;
 }
 
-static void move_cursor(Editor* e, int new_line, int new_col, bool shift)
+static void move_cursor(Editor* e, size_t new_line, int new_col, bool shift)
 {
     if (shift)
     {
@@ -50,18 +227,22 @@ static void move_cursor(Editor* e, int new_line, int new_col, bool shift)
     e->cursor_col  = new_col;
     e->cursor_cooldown = 1.0f;
 
+    // Typing after moving the cursor is undone separately
+    undo_seal(&e->undo);
+
     // infobar height = 25px
     int usable_height = e->viewport_height - 25; //TODO: Update this when infobar is refactored
-    int first_visible_line = e->scroll_offset_y / e->line_height;
-    int last_visible_line = (e->scroll_offset_y + usable_height) / e->line_height;
+    size_t first_visible_line = editor_y_to_line(e, e->scroll_offset_y);
+    size_t last_visible_line = editor_y_to_line(e, e->scroll_offset_y + usable_height);
+    size_t margin = e->cursor_margin_lines_y;
 
     // Ensuring that cursor is always visible on the viewport
     // A number of editor lines around the cursor are set to be always visible (Editor::cursor_margin_lines_y)
-    if (e->cursor_line < first_visible_line + e->cursor_margin_lines_y)
+    if (e->cursor_line < first_visible_line + margin)
     {
-        if (e->cursor_line - e->cursor_margin_lines_y >= 0)
+        if (e->cursor_line >= margin)
         {
-            e->scroll_offset_y = (e->cursor_line - e->cursor_margin_lines_y) * e->line_height;
+            e->scroll_offset_y = editor_line_to_y(e, e->cursor_line - e->cursor_margin_lines_y);
         }
         else // If cursor - margin is not greater than or equal to zero, the cursor must be on
              // line number (cursor_margin_lines_y) at most
@@ -69,58 +250,146 @@ static void move_cursor(Editor* e, int new_line, int new_col, bool shift)
             e->scroll_offset_y = 0;
         }
     }
-    else if (e->cursor_line > last_visible_line - e->cursor_margin_lines_y)
+    else if (e->cursor_line + margin > last_visible_line)
+    {
+        size_t lines_fit = editor_y_to_line(e, usable_height);
+        size_t first_line = e->cursor_line + margin > lines_fit ? e->cursor_line + margin - lines_fit : 0;
+        e->scroll_offset_y = editor_line_to_y(e, first_line);
+    }
+}
+
+// Waits for the background save (if any) and records what reached disk
+static void editor_finish_save(Editor* e)
+{
+    if (!e->saver) return;
+
+    FileSaveStats stats;
+    int saved = file_saver_finish(e->saver, e->buffer, &stats);
+    e->saver = NULL;
+
+    if (e->journal) journal_end_save(e->journal, saved ? &stats : NULL);
+    if (!saved) return;
+
+    // The buffer is clean whenever its contents hash back to the snapshot's
+    text_buffer_mark_saved(e->buffer, stats.generation, stats.hash);
+
+    // Saved text becomes the new original, mapped from the file just written.
+    // Where mapped files are locked that would make the next save copy it
+    // again, so the pieces are kept over the in-memory original instead.
+    if (stats.generation == e->buffer->generation && !KFILE_MAPPED_FILES_LOCKED)
+    {
+        text_buffer_rebase_file(e->buffer, e->current_file);
+    }
+}
+
+// Recovers unsaved edits of the current file and starts journaling new ones
+static void editor_open_journal(Editor* e)
+{
+    if (e->current_file[0] == '\0') return;
+
+    // Edits are recorded against the text as saved on disk
+    text_buffer_index_to_line(e->buffer, (size_t)-1);
+    size_t base_length = text_buffer_length(e->buffer);
+    uint64_t base_hash = text_buffer_hash(e->buffer);
+
+    JournalReplayStats replay = { 0, 0, 0.0 };
+    if (journal_replay(e->current_file, e->buffer, &replay) && replay.records > 0)
     {
-        int lines_fit = usable_height / e->line_height;
-        e->scroll_offset_y = (e->cursor_line - lines_fit + e->cursor_margin_lines_y) * e->line_height;
+        // Show where the recovered text ends
+        e->cursor_line = editor_num_lines(e) - 1;
+        e->cursor_col = editor_line_length(e, e->cursor_line);
+        e->text_changed = true;
     }
+
+    e->journal = journal_open(e->current_file, base_length, base_hash, replay.bytes);
+}
+
+// Stops journaling, the journal is only kept if it holds unsaved edits
+static void editor_close_journal(Editor* e)
+{
+    journal_close(e->journal, !text_buffer_is_modified(e->buffer));
+    e->journal = NULL;
 }
 
 void editor_init(Editor* e)
 {
-    // Empty editor and original copy
-    strcpy(e->lines[0], "");
-    strcpy(e->original_lines[0], "");
+    // Empty editor
+    e->buffer = text_buffer_create();
+    arena_init(&e->line_arena);
+    e->loader = NULL;
+    e->saver = NULL;
+    undo_init(&e->undo, UNDO_DEFAULT_BUDGET);
+    e->undo_lost = false;
+    e->journal = NULL;
+    advance_cache_init(&e->advances, EDITOR_TAB_WIDTH);
+    scroll_view_init(&e->view);
 
     e->line_height = 20;
     e->left_margin = 40;
 
-    e->num_lines = 1;
-
-    e->scroll_offset_x = 0;
-    e->scroll_offset_y = 0;
-
-    e->cursor_line = 0;
-    e->cursor_col = 0;
-    e->cursor_timer = 0.0f;
-    e->cursor_alpha = 1.0f;
     e->cursor_blink_duration = 1.2f;
-    e->cursor_cooldown = 1.0f;
-
     e->cursor_margin_lines_y = 3;
 
-    e->is_selecting = false;
-    e->selection_start_line = 0;
-    e->selection_start_col = 0;
-    e->selection_end_line = 0;
-    e->selection_end_col = 0;
-    
-    e->text_changed = false;
-    e->is_saved = true;
+    editor_reset_view(e);
 
     set_current_filename(e, "");
 
     //e->current_font = font_manager_get_font("resources/fonts/SourceCodePro-Bold.ttf", 20);
+    e->sdf_text = false;
     set_current_font(e, "SourceCodePro-Bold.ttf", 18);
 
+    e->viewport_x = 0;
+    e->viewport_y = 0;
     e->viewport_width = 0;
     e->viewport_height = 0;
+    e->text_origin_x = e->left_margin;
+    e->gutter_digits = 0;
+    e->line_number_width = 0;
+    e->is_focused = true;
 
     printf("[editor] Editor initialised.\n");
 }
 
-void editor_update(Editor* e, float delta_time)
+Editor* editor_create(void)
 {
+    Editor* e = malloc(sizeof(Editor));
+    if (!e)
+    {
+        fprintf(stderr, "[editor] Failed to allocate Editor.\n");
+        return NULL;
+    }
+
+    editor_init(e);
+    if (!e->buffer)
+    {
+        fprintf(stderr, "[editor] Failed to create text buffer.\n");
+        free(e);
+        return NULL;
+    }
+
+    return e;
+}
+
+void editor_destroy(Editor* e)
+{
+    if (!e) return;
+    file_loader_destroy(e->loader); // Before the text it scans goes away
+    editor_finish_save(e);
+    editor_close_journal(e);
+    text_buffer_destroy(e->buffer);
+    arena_destroy(&e->line_arena);
+    undo_destroy(&e->undo);
+    advance_cache_destroy(&e->advances);
+    scroll_view_destroy(&e->view);
+    free(e);
+}
+
+bool editor_update(Editor* e, float delta_time)
+{
+    float old_alpha = e->cursor_alpha;
+    bool was_saved = e->is_saved;
+    bool changed = false;
+
     // Update cursor cooldown
     if (e->cursor_cooldown > 0.0f)
     {
@@ -135,12 +404,20 @@ void editor_update(Editor* e, float delta_time)
 
         // During cooldown, keep cursor fully visible
         e->cursor_alpha = 1.0f;
+        e->cursor_idle_time = 0.0f;
+    }
+    else if (!e->is_focused || e->cursor_idle_time >= EDITOR_BLINK_TIMEOUT)
+    {
+        // Stop blinking so an idle editor needs no frames at all
+        e->cursor_alpha = 1.0f;
     }
     else
     {
+        e->cursor_idle_time += delta_time;
         e->cursor_timer += delta_time;
-        // Map cursor timer to opacity
+        // Map cursor timer to opacity, held for a whole phase so frames are only needed between phases
         float t = fmodf(e->cursor_timer, e->cursor_blink_duration) / e->cursor_blink_duration;
+        t = floorf(t * EDITOR_BLINK_PHASES) / EDITOR_BLINK_PHASES;
         e->cursor_alpha = cosf(t * 2.0f * 3.14159256f); // [-1, 1]
         e->cursor_alpha = (e->cursor_alpha + 1.0f) / 2.0f;              // [0, 1]
 
@@ -148,67 +425,127 @@ void editor_update(Editor* e, float delta_time)
         e->cursor_alpha = 0.1f + e->cursor_alpha * (1.0f - 0.1f);
     }
 
-    e->is_saved = editor_is_file_saved(e);
-}
-
-int editor_load_file(Editor* e, const char* filename)
-{
-    fprintf(stdout, "Loading: %s\n", filename);
-
-    FILE* f = fopen(filename, "r");
-    if (!f) return 0; // Failed to open file
+    // Ease the shown scroll position towards where it should be
+    double scroll_distance = (double)e->scroll_offset_y - e->scroll_y;
+    if (scroll_distance != 0.0)
+    {
+        double step = scroll_distance * fmin(1.0, delta_time * EDITOR_SCROLL_SPEED);
+        if (fabs(scroll_distance) <= 1.0 || fabs(step) >= fabs(scroll_distance)) e->scroll_y = (double)e->scroll_offset_y;
+        else if (fabs(step) < 1.0) e->scroll_y += scroll_distance > 0.0 ? 1.0 : -1.0;
+        else e->scroll_y += step;
+        changed = true;
+    }
 
-    editor_init(e);
-    e->num_lines = 0; // Completely empty file
+    if (e->saver && file_saver_is_done(e->saver))
+    {
+        editor_finish_save(e);
+        changed = true;
+    }
 
-    while (e->num_lines < MAX_LINES && fgets(e->lines[e->num_lines], MAX_LINE_LENGTH, f))
+    // Apply lines found by the background load
+    if (e->loader)
     {
-        // Remove newline
-        size_t len = strlen(e->lines[e->num_lines]);
-        if (len > 0 && (e->lines[e->num_lines][len-1] == '\n' || e->lines[e->num_lines][len-1] == '\r'))
+        if (file_loader_poll(e->loader, e->buffer))
         {
-            e->lines[e->num_lines][len-1] = '\0';
+            file_loader_destroy(e->loader);
+            e->loader = NULL;
+            text_buffer_pause_indexing(e->buffer, false);
+            editor_open_journal(e);
         }
+        changed = true;
+    }
 
-        strcpy(e->original_lines[e->num_lines], e->lines[e->num_lines]);
-    
-        e->num_lines++;
+    // Lines are indexed lazily, keep the index a screen ahead of the viewport
+    // (and cursor) so scrolling and cursor movement can reach them
+    size_t lines_per_screen = editor_y_to_line(e, e->viewport_height) + 1;
+    size_t wanted_line = editor_y_to_line(e, e->scroll_offset_y) + 2 * lines_per_screen;
+    if (wanted_line < e->cursor_line + e->cursor_margin_lines_y)
+    {
+        wanted_line = e->cursor_line + e->cursor_margin_lines_y;
     }
+    text_buffer_index_to_line(e->buffer, wanted_line);
 
-    // Set the cursor position to end of file
-    e->cursor_line = e->num_lines - 1;
-    e->cursor_col = strlen(e->lines[e->cursor_line]);
+    e->is_saved = editor_is_file_saved(e);
 
-    set_current_filename(e, filename);
+    // Compare alpha as drawn, not the exact float
+    changed = changed || (int)(old_alpha * 255) != (int)(e->cursor_alpha * 255);
+    return changed || was_saved != e->is_saved;
+}
 
-    fclose(f);
-    return 1;
+int editor_next_update_ms(Editor* e)
+{
+    if ((int64_t)e->scroll_y != e->scroll_offset_y) return 0;
+    if (e->loader || e->saver) return EDITOR_POLL_MS;
+    if (!e->is_focused) return -1;
+
+    // Blinking starts once the cooldown runs out
+    if (e->cursor_cooldown > 0.0f) return (int)(e->cursor_cooldown * 1000.0f) + 1;
+    if (e->cursor_idle_time >= EDITOR_BLINK_TIMEOUT) return -1;
+
+    // Wake for the next blink phase, or when blinking stops if that comes first
+    float phase = e->cursor_blink_duration / EDITOR_BLINK_PHASES;
+    float remaining = phase - fmodf(e->cursor_timer, phase);
+    float until_timeout = EDITOR_BLINK_TIMEOUT - e->cursor_idle_time;
+    if (until_timeout < remaining) remaining = until_timeout;
+    return (int)(remaining * 1000.0f) + 1;
 }
 
-int editor_save_file(Editor* e)
+void editor_set_focused(Editor* e, bool focused)
 {
-    FILE* f = fopen(e->current_file, "w");
-    if (!f) return 0; // Failed to open
+    if (focused && !e->is_focused) e->cursor_cooldown = 1.0f; // Restart blinking
+    e->is_focused = focused;
+}
 
-    for (size_t i = 0; i < e->num_lines; i++)
-    {
-        if (i < e->num_lines - 1)
-        {
-            fprintf(f, "%s\n", e->lines[i]);
-        }
-        else
-        {
-            fprintf(f, "%s", e->lines[i]);
-        }
+int editor_load_file(Editor* e, const char* filename)
+{
+    fprintf(stdout, "Loading: %s\n", filename);
 
-        strcpy(e->original_lines[i], e->lines[i]);
+    // The previous file's mapping is about to be released
+    file_loader_destroy(e->loader);
+    e->loader = NULL;
+    editor_finish_save(e);
+    editor_close_journal(e);
+
+    // The file is mapped rather than read
+    if (!text_buffer_load_file(e->buffer, filename)) return 0; // Failed to open file
+    editor_reset_view(e);
+    undo_clear(&e->undo);
+    e->undo_lost = false;
+    set_current_filename(e, filename);
+
+    if (e->buffer->original_length > TEXT_BUFFER_INDEX_CHUNK)
+    {
+        // Split large files into lines on a worker thread, lines are shown as they arrive
+        e->loader = file_loader_create(e->buffer->original, e->buffer->original_length);
+        if (e->loader) text_buffer_pause_indexing(e->buffer, true);
     }
+    else
+    {
+        // Set the cursor position to end of file
+        e->cursor_line = editor_num_lines(e) - 1;
+        e->cursor_col = editor_line_length(e, e->cursor_line);
 
-    fclose(f);
+        editor_open_journal(e);
+    }
 
     return 1;
 }
 
+bool editor_is_loading(Editor* e)
+{
+    return e->loader != NULL;
+}
+
+int editor_save_file(Editor* e)
+{
+    if (editor_is_loading(e) || e->saver) return 0;
+
+    // Typing can continue while the snapshot is written
+    e->saver = file_saver_start(e->buffer, e->current_file);
+    if (e->saver && e->journal) journal_begin_save(e->journal);
+    return e->saver != NULL;
+}
+
 bool editor_is_file_saved(Editor* e)
 {
     // ----------------------------------------------------------------
@@ -240,62 +577,95 @@ bool editor_is_file_saved(Editor* e)
     // fclose(f);
     // return true;  
 
-    // Compare current editor lines to original copy
-    for (size_t i = 0; i < e->num_lines; i++) {
-        if (strcmp(e->lines[i], e->original_lines[i]) != 0) {
-            return false;
-        }
-    }
-    return true;
+    // Compare the current contents' hash with the saved one, O(1)
+    return !text_buffer_is_modified(e->buffer);
 }
 
 void editor_insert_char(Editor* e, char c)
 {
-    char* line = e->lines[e->cursor_line];
-    size_t len = strlen(line);
-    if (len + 1 < MAX_LINE_LENGTH)
-    {
-        memmove(&line[e->cursor_col + 1], &line[e->cursor_col], len - e->cursor_col + 1);
-        line[e->cursor_col] = c;
-        e->cursor_col++;
-    }
+    if (editor_is_loading(e)) return;
 
+    editor_edit_insert(e, editor_offset(e, e->cursor_line, e->cursor_col), &c, 1);
+    e->cursor_col++;
+
+    e->cursor_cooldown = 1.0f;
     e->text_changed = true;
 }
 
 void editor_backspace(Editor* e)
 {
-    char* line = e->lines[e->cursor_line];
+    if (editor_is_loading(e)) return;
 
     if (e->cursor_col > 0)
     {
-        memmove(&line[e->cursor_col - 1], &line[e->cursor_col], strlen(&line[e->cursor_col]) + 1);
+        editor_edit_delete(e, editor_offset(e, e->cursor_line, e->cursor_col - 1), 1);
         e->cursor_col--;
     }
     else if (e->cursor_line > 0) 
     {
-        int prev_len = strlen(e->lines[e->cursor_line - 1]);
-        if (prev_len + strlen(line) < MAX_LINE_LENGTH) 
-        {
-            strcat(e->lines[e->cursor_line - 1], line);
-            for (int i = e->cursor_line; i < e->num_lines - 1; i++) 
-            {
-                strcpy(e->lines[i], e->lines[i + 1]);
-            }
-            e->num_lines--;
-            e->cursor_line--;
-            e->cursor_col = prev_len;
-        }
+        // Join with the previous line by removing its line ending
+        int prev_len = editor_line_length(e, e->cursor_line - 1);
+        size_t eol_start = editor_offset(e, e->cursor_line - 1, prev_len);
+        size_t line_start = editor_offset(e, e->cursor_line, 0);
+
+        editor_edit_delete(e, eol_start, line_start - eol_start);
+        e->cursor_line--;
+        e->cursor_col = prev_len;
     }
 
     e->cursor_cooldown = 1.0f;
     e->text_changed = true;
 }
 
-void editor_handle_key(Editor* e, kKeycode key, kKeymod mod)
+// Moves the cursor to an offset, e.g. where an undone edit was
+static void editor_move_cursor_to_offset(Editor* e, size_t offset)
 {
-    char* line = e->lines[e->cursor_line];
+    size_t line = text_buffer_line_of_offset(e->buffer, offset);
+    size_t col = offset - text_buffer_line_start(e->buffer, line);
+    move_cursor(e, line, col < INT_MAX ? (int)col : INT_MAX, false);
+}
+
+void editor_undo(Editor* e)
+{
+    if (editor_is_loading(e)) return;
+
+    const UndoEntry* entry = undo_peek_undo(&e->undo);
+    if (entry && e->journal)
+    {
+        journal_record_delete(e->journal, entry->offset, entry->inserted_length);
+        journal_record_insert(e->journal, entry->offset, entry->removed, entry->removed_length);
+    }
 
+    size_t cursor;
+    if (!undo_undo(&e->undo, e->buffer, &cursor)) return;
+
+    editor_move_cursor_to_offset(e, cursor);
+    editor_clamp_scroll_y(e);
+    e->text_changed = true;
+}
+
+void editor_redo(Editor* e)
+{
+    if (editor_is_loading(e)) return;
+
+    const UndoEntry* entry = undo_peek_redo(&e->undo);
+    if (entry && e->journal)
+    {
+        journal_record_delete(e->journal, entry->offset, entry->removed_length);
+        journal_record_insert(e->journal, entry->offset, entry->inserted, entry->inserted_length);
+    }
+
+    size_t cursor;
+    if (!undo_redo(&e->undo, e->buffer, &cursor)) return;
+
+    editor_move_cursor_to_offset(e, cursor);
+    editor_clamp_scroll_y(e);
+    e->text_changed = true;
+}
+
+bool editor_handle_key(Editor* e, kKeycode key, kKeymod mod)
+{
+    bool changed = true;
     switch (key)
     {
         case KKEY_BACKSPACE: // Backspace
@@ -303,36 +673,30 @@ void editor_handle_key(Editor* e, kKeycode key, kKeymod mod)
             break;
 
         case KKEY_TAB: // Tab
-            editor_insert_char(e, ' ');
-            editor_insert_char(e, ' ');
-            editor_insert_char(e, ' ');
-            editor_insert_char(e, ' ');
+            for (int i = 0; i < EDITOR_TAB_WIDTH; i++) editor_insert_char(e, ' ');
             break;
 
         case KKEY_RETURN: // Return
-            if (e->num_lines < MAX_LINES) 
-            {
-                for (int i = e->num_lines; i > e->cursor_line + 1; i--) 
-                {
-                    strcpy(e->lines[i], e->lines[i - 1]);
-                }
-                strcpy(e->lines[e->cursor_line + 1], &line[e->cursor_col]);
-                line[e->cursor_col] = '\0';
-                move_cursor(e, e->cursor_line + 1, 0, false);
-                e->num_lines++;
-            }
+        {
+            if (editor_is_loading(e)) break;
+
+            const char* eol = e->buffer->eol;
+            editor_edit_insert(e, editor_offset(e, e->cursor_line, e->cursor_col), eol, strlen(eol));
+            move_cursor(e, e->cursor_line + 1, 0, false);
+            e->text_changed = true;
             break;
+        }
 
         case KKEY_LEFT:
         {
-            int new_line = e->cursor_line;
+            size_t new_line = e->cursor_line;
             int new_col  = e->cursor_col;
 
             if (new_col > 0) new_col--;
             else if (new_line > 0) 
             {
                 new_line--;
-                new_col = strlen(e->lines[new_line]);
+                new_col = editor_line_length(e, new_line);
             }
 
             move_cursor(e, new_line, new_col, mod == KKEYMOD_SHIFT);
@@ -341,12 +705,12 @@ void editor_handle_key(Editor* e, kKeycode key, kKeymod mod)
 
         case KKEY_RIGHT:
         {
-            int new_line = e->cursor_line;
+            size_t new_line = e->cursor_line;
             int new_col  = e->cursor_col;
-            int line_len = strlen(e->lines[new_line]);
+            int line_len = editor_line_length(e, new_line);
 
             if (new_col < line_len) new_col++;
-            else if (new_line + 1 < e->num_lines) 
+            else if (new_line + 1 < editor_num_lines(e)) 
             {
                 new_line++;
                 new_col = 0;
@@ -360,9 +724,9 @@ void editor_handle_key(Editor* e, kKeycode key, kKeymod mod)
         {
             if (e->cursor_line > 0)
             {
-                int new_line = e->cursor_line - 1;
+                size_t new_line = e->cursor_line - 1;
                 int new_col  = e->cursor_col;
-                int line_len = strlen(e->lines[new_line]);
+                int line_len = editor_line_length(e, new_line);
                 if (new_col > line_len) new_col = line_len;
 
                 move_cursor(e, new_line, new_col, mod == KKEYMOD_SHIFT);
@@ -376,11 +740,11 @@ void editor_handle_key(Editor* e, kKeycode key, kKeymod mod)
 
         case KKEY_DOWN:
         {
-            if (e->cursor_line + 1 < e->num_lines)
+            if (e->cursor_line + 1 < editor_num_lines(e))
             {
-                int new_line = e->cursor_line + 1;
+                size_t new_line = e->cursor_line + 1;
                 int new_col  = e->cursor_col;
-                int line_len = strlen(e->lines[new_line]);
+                int line_len = editor_line_length(e, new_line);
                 if (new_col > line_len) new_col = line_len;
 
                 move_cursor(e, new_line, new_col, mod == KKEYMOD_SHIFT);
@@ -392,47 +756,88 @@ void editor_handle_key(Editor* e, kKeycode key, kKeymod mod)
             break;
         }
 
+        case KKEY_Z:
+            if (mod == KKEYMOD_CTRL) editor_undo(e);
+            else if (mod == (KKEYMOD_CTRL | KKEYMOD_SHIFT)) editor_redo(e);
+            else changed = false;
+            break;
+
+        case KKEY_Y:
+            if (mod == KKEYMOD_CTRL) editor_redo(e);
+            else changed = false;
+            break;
+
         case KKEY_F1: // F1
-            set_current_font(e, "SourceCodePro-Bold.ttf", font_manager_get_font_size(e->current_font) - 1);
+            set_current_font(e, "SourceCodePro-Bold.ttf", e->font_size - 1);
             editor_clamp_scroll_y(e);
             break;
 
         case KKEY_F2:
-            set_current_font(e, "SourceCodePro-Bold.ttf", font_manager_get_font_size(e->current_font) + 1);
+            set_current_font(e, "SourceCodePro-Bold.ttf", e->font_size + 1);
+            editor_clamp_scroll_y(e);
+            break;
+
+        case KKEY_F8:
+            e->sdf_text = !e->sdf_text;
+            set_current_font(e, "SourceCodePro-Bold.ttf", e->font_size);
             editor_clamp_scroll_y(e);
             break;
 
         case KKEY_F5: // F5
             editor_save_file(e);
+            break;
 
         default:
+            changed = false;
             break;
     }
+    return changed;
 }
 
-void editor_handle_mouse_down(Editor* e, kMouseButtonEvent btn)
+bool editor_handle_mouse_down(Editor* e, kMouseButtonEvent btn)
 {
-    // if (btn == K_MOUSE_BUTTON_LEFT)
-    // {
-        
-    // }
+    if (btn.button != KMOUSEBUTTON_LEFT) return false;
+
+    // Ignore clicks outside the text area (infobar height = 25px)
+    int y = btn.y - e->viewport_y;
+    if (y < 0 || y >= e->viewport_height - 25) return false;
+
+    if (editor_num_lines(e) == 0) return false;
+    size_t line = editor_y_to_line(e, y + (int64_t)e->scroll_y);
+    if (line >= editor_num_lines(e)) line = editor_num_lines(e) - 1;
+
+    // Place the cursor at the column boundary nearest the click
+    int col = 0;
+    const LineAdvances* advances = editor_line_advances(e, line);
+    if (advances)
+    {
+        col = advance_cache_x_to_col(advances, btn.x - e->viewport_x - e->text_origin_x + e->scroll_offset_x);
+    }
+
+    move_cursor(e, line, col, false);
+    return true;
 }
 
-void editor_handle_scroll(Editor* e, kMouseWheelEvent wheel)
+bool editor_handle_scroll(Editor* e, kMouseWheelEvent wheel)
 {
+    int old_x = e->scroll_offset_x;
+    int64_t old_y = e->scroll_offset_y;
+
     if (wheel.mod == KKEYMOD_SHIFT)
     {
         // Horizontal scroll
-        int first_visible_line = e->scroll_offset_y / e->line_height;
-        int last_visible_line = (e->scroll_offset_y + e->viewport_height) / e->line_height + 1;
+        size_t first_visible_line = editor_y_to_line(e, e->scroll_offset_y);
+        size_t last_visible_line = editor_y_to_line(e, e->scroll_offset_y + e->viewport_height) + 1;
+        if (last_visible_line > editor_num_lines(e)) last_visible_line = editor_num_lines(e);
 
         // Find line of text with longest width
         // Only check lines currently visible
+        arena_reset(&e->line_arena);
         int max_width = 0;
-        for (int i = first_visible_line; i < last_visible_line; i++)
+        for (size_t i = first_visible_line; i < last_visible_line; i++)
         {
-            int current_line_width; 
-            TTF_SizeText(e->current_font, e->lines[i], &current_line_width, NULL);
+            const LineAdvances* advances = editor_line_advances(e, i);
+            int current_line_width = advances ? advance_cache_col_to_x(advances, advances->length) : 0;
             if (current_line_width > max_width) max_width = current_line_width;
         }
 
@@ -453,13 +858,14 @@ void editor_handle_scroll(Editor* e, kMouseWheelEvent wheel)
     else
     {
         // Vertical Scroll
-        e->scroll_offset_y -= wheel.y * e->line_height;
+        e->scroll_offset_y -= (int64_t)wheel.y * e->line_height;
 
         //TODO: Move this to clamp scroll function
         if (e->scroll_offset_y < 0) e->scroll_offset_y = 0;
 
         editor_clamp_scroll_y(e);
     }    
+    return e->scroll_offset_x != old_x || e->scroll_offset_y != old_y;
 }
 
 void editor_render(Editor* e, struct Renderer* r)
@@ -469,118 +875,166 @@ void editor_render(Editor* e, struct Renderer* r)
 
     //e->line_height = TTF_FontLineSkip(e->current_font);
 
-    // Determine width of line numbers (in pixels) for the current font
-    int max_line_number = e->num_lines;
-    char buffer[16];
-    sprintf(buffer, "%d", max_line_number);
-    int line_number_width = 0;
-    TTF_SizeText(e->current_font, buffer, &line_number_width, NULL); // get width of widest line number
+    // Lines fetched last frame are no longer needed
+    arena_reset(&e->line_arena);
+
+    if (e->atlas_prewarm) editor_prewarm_atlases(e, r);
+
+    // Determine width of line numbers (in pixels) for the current font,
+    // which only changes with the number of digits
+    int digits = 1;
+    for (size_t n = editor_num_lines(e); n >= 10; n /= 10) digits++;
+    if (digits != e->gutter_digits)
+    {
+        GlyphAtlas* atlas = editor_text_atlas(e, r);
+        e->line_number_width = atlas ? digits * glyph_atlas_digit_width(atlas) : 0;
+        e->gutter_digits = digits;
+    }
+    int line_number_width = e->line_number_width;
 
     int gutter_padding = 5; // space between line number and text
+    e->text_origin_x = e->left_margin + line_number_width + gutter_padding;
 
     SDL_Rect vp = renderer_get_viewport(r);
-    int first_visible_line = e->scroll_offset_y / e->line_height;
-    int last_visible_line = (e->scroll_offset_y + vp.h) / e->line_height + 1;
+    // Content y is 64-bit, only offsets from view_y are drawn with as int
+    int64_t view_y = (int64_t)e->scroll_y;
+    size_t first_visible_line = editor_y_to_line(e, view_y);
+    size_t last_visible_line = editor_y_to_line(e, view_y + vp.h) + 1;
+
+    if (last_visible_line > editor_num_lines(e)) last_visible_line = editor_num_lines(e);
+
+    // Normalise selection order
+    size_t start_line = e->selection_start_line;
+    size_t end_line   = e->selection_end_line;
+    int start_col  = e->selection_start_col;
+    int end_col    = e->selection_end_col;
+    if (start_line > end_line || (start_line == end_line && start_col > end_col))
+    {
+        size_t tmp_line = start_line;
+        start_line   = end_line;
+        end_line     = tmp_line;
 
-    if (last_visible_line > e->num_lines) last_visible_line = e->num_lines;
+        int tmp_col = start_col;
+        start_col   = end_col;
+        end_col     = tmp_col;
+    }
 
-    SDL_Rect lh = {e->left_margin + line_number_width + gutter_padding, e->cursor_line * e->line_height - e->scroll_offset_y, 
-                   vp.w - e->left_margin + line_number_width + gutter_padding, e->line_height};
-    SDL_Color lh_color = {25, 25, 25, 255};
-    renderer_draw_rect(r, lh.x, lh.y, lh.w, lh.h, lh_color);
+    // Lines are kept in the view texture, only those that scrolled into view
+    // or whose contents changed are drawn again
+    int layout[2] = { e->text_origin_x, e->scroll_offset_x };
+    uint64_t layout_key = ui_layer_hash(UI_LAYER_HASH_SEED, layout, sizeof(layout));
+    layout_key = ui_layer_hash(layout_key, &e->current_font, sizeof(e->current_font));
+    layout_key = ui_layer_hash(layout_key, &e->font_size, sizeof(e->font_size));
+    GlyphAtlas* text_atlas = e->sdf ? editor_text_atlas(e, r) : NULL;
+    scroll_view_begin(&e->view, r, vp.w, vp.h, e->line_height, view_y, layout_key);
 
-    for (size_t i = first_visible_line; i < last_visible_line; i++)
+    for (size_t i = e->view.first_row; i < e->view.first_row + e->view.row_count; i++)
     {
-        int y = (i * e->line_height) - e->scroll_offset_y;
+        struct {
+            uint64_t hash;
+            int exists;
+            int current;
+            int selection_start;
+            int selection_end;
+        } row = { 0, i < editor_num_lines(e), i == e->cursor_line, 0, 0 };
+
+        const LineAdvances* advances = NULL;
+        if (row.exists)
+        {
+            row.hash = text_buffer_line_hash(e->buffer, i);
+            if (e->is_selecting && i >= start_line && i <= end_line)
+            {
+                advances = editor_line_advances(e, i);
+                int line_len = advances ? advances->length : 0;
+                row.selection_start = (i == start_line) ? start_col : 0;
+                row.selection_end   = (i == end_line)   ? end_col   : line_len;
+                if (row.selection_start > line_len) row.selection_start = line_len;
+                if (row.selection_end > line_len) row.selection_end = line_len;
+            }
+        }
+
+        uint64_t key = ui_layer_hash(UI_LAYER_HASH_SEED, &row, sizeof(row)) | 1;
+        if (!scroll_view_row_dirty(&e->view, i, key)) continue;
+
+        int y = scroll_view_row_y(&e->view, i);
+        int text_x = e->text_origin_x - e->scroll_offset_x;
 
-        if (e->is_selecting)
+        // Rows are drawn over what was there before
+        SDL_Color bg = {20, 20, 20, 255};
+        renderer_draw_rect(r, 0, y, vp.w, e->line_height, bg);
+
+        if (row.current)
         {
-            int start_line = e->selection_start_line;
-            int end_line   = e->selection_end_line;
-            int start_col  = e->selection_start_col;
-            int end_col    = e->selection_end_col;
+            SDL_Color lh_color = {25, 25, 25, 255};
+            renderer_draw_rect(r, e->text_origin_x, y, vp.w - e->text_origin_x, e->line_height, lh_color);
+        }
 
-            // Normalise selection order
-            if (start_line > end_line || (start_line == end_line && start_col > end_col))
-            {
-                int tmp_line = start_line;
-                start_line   = end_line;
-                end_line     = tmp_line;
+        if (advances && row.selection_end > row.selection_start)
+        {
+            // Compute pixel positions
+            int px_start = advance_cache_col_to_x(advances, row.selection_start);
+            int px_end   = advance_cache_col_to_x(advances, row.selection_end);
 
-                int tmp_col = start_col;
-                start_col   = end_col;
-                end_col     = tmp_col;
-            }
+            SDL_Color sel_bg = {60, 90, 180, 150};
+            renderer_draw_rect(r, text_x + px_start, y, px_end - px_start, e->line_height, sel_bg);
+        }
 
-            if (i >= start_line && i<= end_line)
+        // Distance field text is drawn glyph by glyph, the row is kept in the view
+        if (text_atlas)
+        {
+            if (row.exists && editor_line_length(e, i) > 0)
             {
-                int line_start_col = (i == start_line) ? start_col : 0;
-                int line_end_col   = (i == end_line)   ? end_col   : strlen(e->lines[i]);
-
-                if (line_end_col > line_start_col)
-                {
-                    // Compute pixel positions
-                    char temp[512];
-                    int px_start = 0, px_end = 0;
-
-                    if (line_start_col > 0)
-                    {
-                        strncpy(temp, e->lines[i], line_start_col);
-                        temp[line_start_col] = '\0';
-                        TTF_SizeText(e->current_font, temp, &px_start, NULL);
-                    }
-
-                    strncpy(temp, e->lines[i], line_end_col);
-                    temp[line_end_col] = '\0';
-                    TTF_SizeText(e->current_font, temp, &px_end, NULL);
-
-                    SDL_Rect sel_rect = {
-                        e->left_margin + line_number_width + gutter_padding + px_start,
-                        y,
-                        px_end - px_start,
-                        e->line_height
-                    };
-                    SDL_Color sel_bg = {60, 90, 180, 150};
-                    renderer_draw_rect(r, sel_rect.x, sel_rect.y, sel_rect.w, sel_rect.h, sel_bg);
-                }
+                EditorLine line = editor_expand_tabs(e, editor_get_line(e, i, EDITOR_MAX_RENDER_LENGTH));
+                renderer_draw_atlas_text(r, text_atlas, line.text, line.length, text_x, y, textColor);
             }
         }
-        
-        renderer_draw_text(r, e->lines[i], e->left_margin + line_number_width + gutter_padding - e->scroll_offset_x, y, e->current_font, ALIGN_LEFT, textColor);
+        // Unchanged lines are drawn from the line cache without fetching their text
+        else if (row.exists && editor_line_length(e, i) > 0 &&
+            !renderer_draw_cached_text(r, row.hash, text_x, y, e->current_font, textColor))
+        {
+            EditorLine line = editor_expand_tabs(e, editor_get_line(e, i, EDITOR_MAX_RENDER_LENGTH));
+            renderer_cache_text(r, row.hash, line.text, text_x, y, e->current_font, textColor);
+        }
     }
 
-    int cursor_x = 0;
-    if (e->cursor_col > 0) {
-        char buffer[256];
-        // Copy text up to cursor
-        strncpy(buffer, e->lines[e->cursor_line], e->cursor_col);
-        buffer[e->cursor_col] = '\0';
+    scroll_view_end(&e->view, r);
 
-        // Get width of this substring
-        TTF_SizeText(e->current_font, buffer, &cursor_x, NULL);
+    int cursor_x = editor_col_to_x(e, e->cursor_line, e->cursor_col);
+    int64_t cursor_y = editor_line_to_y(e, e->cursor_line) - view_y;
+    if (cursor_y > -e->line_height && cursor_y < vp.h)
+    {
+        renderer_draw_cursor(r, e->text_origin_x + cursor_x - e->scroll_offset_x, (int)cursor_y, e->line_height, e->cursor_alpha);
     }
-    int cursor_y = e->cursor_line * e->line_height;
-    renderer_draw_cursor(r, e->left_margin + line_number_width + gutter_padding + cursor_x - e->scroll_offset_x, e->cursor_line * e->line_height - e->scroll_offset_y, e->line_height, e->cursor_alpha);
 
     // Rect behind line numbers
     // TODO: Remove this extra render call, use logic to NOT draw some text under?
     SDL_Color bg = {20, 20, 20, 255};
     renderer_draw_rect(r, 0, 0, e->left_margin + line_number_width - gutter_padding, vp.h, bg);
 
+    GlyphAtlas* number_atlas = editor_text_atlas(e, r);
     for (size_t i = first_visible_line; i < last_visible_line; i++)
     {
-        int y = (i * e->line_height) - e->scroll_offset_y;
+        int y = (int)(editor_line_to_y(e, i) - view_y);
 
-        char lineNumber[16];
-        snprintf(lineNumber, sizeof(lineNumber), "%4d", i + 1);
         if (i == e->cursor_line) lineNumberColor.a = 255;
         else lineNumberColor.a = 100;
 
-        
-        renderer_draw_text(r, lineNumber, line_number_width + 20, y, e->current_font, ALIGN_RIGHT, lineNumberColor);
+        renderer_draw_atlas_number(r, number_atlas, (uint64_t)i + 1, line_number_width + 20, y, lineNumberColor);
     }
     
     char info[128];
-    snprintf(info, sizeof(info), "%s%s | Line %d, Col %d", e->current_file, e->is_saved ? "" : "*", e->cursor_line + 1, e->cursor_col + 1);
+    int info_len = snprintf(info, sizeof(info), "%s%s | Line %zu, Col %d", e->current_file, e->is_saved ? "" : "*", e->cursor_line + 1, e->cursor_col + 1);
+    if (e->loader && info_len > 0 && info_len < (int)sizeof(info))
+    {
+        snprintf(info + info_len, sizeof(info) - info_len, " | Loading %d%%", (int)(file_loader_progress(e->loader) * 100.0f));
+    }
+    else if (e->saver && info_len > 0 && info_len < (int)sizeof(info))
+    {
+        snprintf(info + info_len, sizeof(info) - info_len, " | Saving...");
+    }
+    else if (e->undo_lost && info_len > 0 && info_len < (int)sizeof(info))
+    {
+        snprintf(info + info_len, sizeof(info) - info_len, " | Last edit too large to undo");
+    }
     renderer_draw_infobar(r, info);
 }
\ No newline at end of file
@@ -0,0 +1,223 @@
+#include "file_loader.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+static void batch_list_free(FileLoaderBatch* b)
+{
+    while (b)
+    {
+        FileLoaderBatch* next = b->next;
+        free(b);
+        b = next;
+    }
+}
+
+static bool file_loader_queue(FileLoader* fl, const uint32_t* lengths, const uint64_t* hashes,
+                              size_t count, size_t scanned, uint64_t tail_hash)
+{
+    // Lengths and hashes share one allocation, hashes aligned after the lengths
+    size_t lengths_size = (count * sizeof(uint32_t) + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+    FileLoaderBatch* b = malloc(sizeof(FileLoaderBatch) + lengths_size + count * sizeof(uint64_t));
+    if (!b) return false;
+
+    b->next = NULL;
+    b->scanned = scanned;
+    b->count = count;
+    b->tail_hash = tail_hash;
+    b->hashes = (uint64_t*)((char*)b->lengths + lengths_size);
+    if (count > 0)
+    {
+        memcpy(b->lengths, lengths, count * sizeof(uint32_t));
+        memcpy(b->hashes, hashes, count * sizeof(uint64_t));
+    }
+
+    SDL_LockMutex(fl->lock);
+    if (fl->queue_tail) fl->queue_tail->next = b;
+    else fl->queue_head = b;
+    fl->queue_tail = b;
+    SDL_UnlockMutex(fl->lock);
+
+    return true;
+}
+
+static int file_loader_thread(void* user)
+{
+    FileLoader* fl = user;
+
+    uint32_t* lengths = NULL;
+    uint64_t* hashes = NULL;
+    size_t capacity = 0;
+    size_t partial = 0; // Bytes of the line carried over from earlier chunks
+    uint64_t hash = 0;  // Hash of those bytes
+    size_t position = 0;
+
+    while (position < fl->length && !SDL_AtomicGet(&fl->cancel))
+    {
+        size_t end = fl->length - position < TEXT_BUFFER_INDEX_CHUNK ?
+                     fl->length : position + TEXT_BUFFER_INDEX_CHUNK;
+
+        const char* p = fl->data + position;
+        const char* chunk_end = fl->data + end;
+        const char* newline;
+        size_t count = 0;
+        const char* failed = NULL;
+
+        while (p < chunk_end && (newline = memchr(p, '\n', chunk_end - p)) != NULL)
+        {
+            if (count == capacity)
+            {
+                size_t new_capacity = capacity ? capacity * 2 : 4096;
+                uint32_t* grown_lengths = realloc(lengths, new_capacity * sizeof(uint32_t));
+                if (grown_lengths) lengths = grown_lengths;
+                uint64_t* grown_hashes = realloc(hashes, new_capacity * sizeof(uint64_t));
+                if (grown_hashes) hashes = grown_hashes;
+                if (!grown_lengths || !grown_hashes)
+                {
+                    failed = "Out of memory";
+                    break;
+                }
+                capacity = new_capacity;
+            }
+
+            size_t n = newline + 1 - p;
+            if (partial + n > LINE_INDEX_MAX_LINE)
+            {
+                failed = "Line too long to index";
+                break;
+            }
+            lengths[count] = (uint32_t)(partial + n);
+            hashes[count] = line_index_hash_bytes(hash, p, n);
+            count++;
+            partial = 0;
+            hash = 0;
+            p = newline + 1;
+        }
+
+        if (!failed && partial + (chunk_end - p) > LINE_INDEX_MAX_LINE) failed = "Line too long to index";
+
+        // Only hand over what was scanned, the rest is left for on demand indexing
+        size_t scanned = (failed ? p : chunk_end) - (fl->data + position);
+        if (!failed)
+        {
+            partial += chunk_end - p;
+            hash = line_index_hash_bytes(hash, p, chunk_end - p);
+        }
+
+        if (!file_loader_queue(fl, lengths, hashes, count, scanned, hash)) failed = "Out of memory";
+        if (failed)
+        {
+            fprintf(stderr, "[file_loader] %s, stopping at byte %zu.\n", failed, position + scanned);
+            break;
+        }
+        position = end;
+    }
+
+    free(lengths);
+    free(hashes);
+
+    SDL_LockMutex(fl->lock);
+    fl->finished = true;
+    SDL_UnlockMutex(fl->lock);
+
+    return 0;
+}
+
+FileLoader* file_loader_create(const char* data, size_t length)
+{
+    FileLoader* fl = calloc(1, sizeof(FileLoader));
+    if (!fl) return NULL;
+
+    fl->data = data;
+    fl->length = data ? length : 0;
+    fl->start_ticks = SDL_GetTicks();
+    SDL_AtomicSet(&fl->cancel, 0);
+
+    fl->lock = SDL_CreateMutex();
+    if (!fl->lock)
+    {
+        free(fl);
+        return NULL;
+    }
+
+    fl->thread = SDL_CreateThread(file_loader_thread, "file_loader", fl);
+    if (!fl->thread)
+    {
+        fprintf(stderr, "[file_loader] Failed to create thread: %s\n", SDL_GetError());
+        SDL_DestroyMutex(fl->lock);
+        free(fl);
+        return NULL;
+    }
+
+    return fl;
+}
+
+void file_loader_destroy(FileLoader* fl)
+{
+    if (!fl) return;
+
+    SDL_AtomicSet(&fl->cancel, 1);
+    SDL_WaitThread(fl->thread, NULL);
+
+    batch_list_free(fl->queue_head);
+    batch_list_free(fl->pending);
+    SDL_DestroyMutex(fl->lock);
+    free(fl);
+}
+
+bool file_loader_poll(FileLoader* fl, TextBuffer* tb)
+{
+    // Take everything queued so far
+    SDL_LockMutex(fl->lock);
+    FileLoaderBatch* head = fl->queue_head;
+    FileLoaderBatch* tail = fl->queue_tail;
+    bool finished = fl->finished;
+    fl->queue_head = NULL;
+    fl->queue_tail = NULL;
+    SDL_UnlockMutex(fl->lock);
+
+    if (head)
+    {
+        if (fl->pending_tail) fl->pending_tail->next = head;
+        else fl->pending = head;
+        fl->pending_tail = tail;
+    }
+
+    // Apply in order, stopping once over budget so a fast worker cannot stall a frame
+    Uint32 start = SDL_GetTicks();
+    while (fl->pending && SDL_GetTicks() - start < FILE_LOADER_POLL_BUDGET_MS)
+    {
+        FileLoaderBatch* b = fl->pending;
+        fl->pending = b->next;
+        if (!fl->pending) fl->pending_tail = NULL;
+
+        size_t scanned = b->scanned;
+        bool applied = text_buffer_append_lines(tb, b->lengths, b->hashes, b->count, b->scanned, b->tail_hash);
+        free(b);
+        if (!applied)
+        {
+            // Nothing after this batch can be trusted, leave the rest to on demand indexing
+            fprintf(stderr, "[file_loader] Scanned lines do not match the buffer, indexing the rest on demand.\n");
+            SDL_AtomicSet(&fl->cancel, 1);
+            batch_list_free(fl->pending);
+            fl->pending = NULL;
+            fl->pending_tail = NULL;
+            fl->failed = true;
+            return true;
+        }
+        fl->applied += scanned;
+    }
+
+    if (finished && !fl->pending)
+    {
+        printf("[file_loader] Loaded %zu bytes in %u ms.\n", fl->applied, SDL_GetTicks() - fl->start_ticks);
+        return true;
+    }
+    return false;
+}
+
+float file_loader_progress(FileLoader* fl)
+{
+    if (fl->length == 0) return 1.0f;
+    return (float)((double)fl->applied / (double)fl->length);
+}
@@ -0,0 +1,206 @@
+#include "file_saver.h"
+#include "kFile.h"
+#include <SDL.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+typedef struct {
+    kFileWriter* writer;
+    kFileSpan spans[KFILE_MAX_SPANS];
+    int count;
+    char* staging;          // Copies of small spans
+    size_t staged;
+} SaveBatch;
+
+static bool batch_flush(SaveBatch* b)
+{
+    bool ok = b->count == 0 || kFileWriter_write(b->writer, b->spans, b->count);
+    b->count = 0;
+    b->staged = 0;
+    return ok;
+}
+
+static bool batch_add(const char* data, size_t length, void* user)
+{
+    SaveBatch* b = user;
+
+    if (length < FILE_SAVER_SMALL_SPAN && b->staging)
+    {
+        if (b->staged + length > FILE_SAVER_STAGING_SIZE && !batch_flush(b)) return false;
+
+        // Grow the previous span if it ends where this copy will start
+        kFileSpan* last = b->count > 0 ? &b->spans[b->count - 1] : NULL;
+        bool extend = last && (const char*)last->data + last->size == b->staging + b->staged;
+        if (!extend && b->count == KFILE_MAX_SPANS && !batch_flush(b)) return false;
+
+        char* dest = b->staging + b->staged;
+        memcpy(dest, data, length);
+        b->staged += length;
+
+        if (extend)
+        {
+            last->size += length;
+            return true;
+        }
+        data = dest;
+    }
+    else if (b->count == KFILE_MAX_SPANS && !batch_flush(b))
+    {
+        return false;
+    }
+
+    b->spans[b->count].data = data;
+    b->spans[b->count].size = length;
+    b->count++;
+    return true;
+}
+
+// Flushes the data and copies the mapped original, so that replacing the file
+// once the buffer lets go of it is all that is left for the UI thread
+static bool file_saver_prepare_commit(FileSaver* fs)
+{
+    if (!kFileWriter_flush(&fs->writer)) return false;
+
+    fs->original_copy = malloc(fs->original_length > 0 ? fs->original_length : 1);
+    if (!fs->original_copy) return false;
+    memcpy(fs->original_copy, fs->original, fs->original_length);
+
+    fs->commit_pending = true;
+    return true;
+}
+
+static int file_saver_thread(void* user)
+{
+    FileSaver* fs = user;
+    Uint64 start = SDL_GetPerformanceCounter();
+    fs->result = 0;
+
+    kFileWriter* writer = &fs->writer;
+    if (!kFileWriter_open(writer, fs->path))
+    {
+        fprintf(stderr, "[file_saver] Failed to create temporary file for %s\n", fs->path);
+        SDL_AtomicSet(&fs->done, 1);
+        return 0;
+    }
+
+    SaveBatch batch;
+    batch.writer = writer;
+    batch.count = 0;
+    batch.staging = malloc(FILE_SAVER_STAGING_SIZE); // Without it every span is written in place
+    batch.staged = 0;
+
+    bool written = true;
+    for (size_t i = 0; i < fs->snapshot.count && written; i++)
+    {
+        written = batch_add(fs->snapshot.spans[i].data, fs->snapshot.spans[i].size, &batch);
+    }
+    written = written && batch_flush(&batch);
+    size_t bytes = writer->written;
+    free(batch.staging);
+
+    if (!written)
+    {
+        fprintf(stderr, "[file_saver] Failed to write %s\n", fs->path);
+        kFileWriter_abort(writer);
+    }
+    else if (fs->original && !file_saver_prepare_commit(fs))
+    {
+        fprintf(stderr, "[file_saver] Failed to prepare replacing %s\n", fs->path);
+        kFileWriter_abort(writer);
+    }
+    else if (!fs->commit_pending && !kFileWriter_commit(writer))
+    {
+        fprintf(stderr, "[file_saver] Failed to replace %s\n", fs->path);
+    }
+    else
+    {
+        double seconds = (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+        double mb = bytes / (1024.0 * 1024.0);
+        printf("[file_saver] Saved %s: %.1f MB in %.3f s (%.1f MB/s)\n",
+               fs->path, mb, seconds, seconds > 0.0 ? mb / seconds : 0.0);
+
+        fs->stats.bytes = bytes;
+        fs->stats.seconds = seconds;
+        fs->result = 1;
+    }
+
+    SDL_AtomicSet(&fs->done, 1);
+    return 0;
+}
+
+FileSaver* file_saver_start(TextBuffer* tb, const char* path)
+{
+    FileSaver* fs = calloc(1, sizeof(FileSaver));
+    if (!fs) return NULL;
+
+    // The file being replaced may be mapped as the buffer's original text,
+    // the worker copies it rather than stalling the UI thread
+    if (KFILE_MAPPED_FILES_LOCKED && tb->original_map.data)
+    {
+        fs->original = tb->original;
+        fs->original_length = tb->original_length;
+    }
+
+    size_t len = strlen(path);
+    fs->path = malloc(len + 1);
+    if (!fs->path || !text_buffer_snapshot(tb, &fs->snapshot))
+    {
+        free(fs->path);
+        free(fs);
+        return NULL;
+    }
+    memcpy(fs->path, path, len + 1);
+
+    fs->stats.generation = fs->snapshot.generation;
+    fs->stats.hash = fs->snapshot.hash;
+    SDL_AtomicSet(&fs->done, 0);
+
+    fs->thread = SDL_CreateThread(file_saver_thread, "file_saver", fs);
+    if (!fs->thread)
+    {
+        fprintf(stderr, "[file_saver] Failed to create thread: %s\n", SDL_GetError());
+        text_buffer_snapshot_free(&fs->snapshot);
+        free(fs->path);
+        free(fs);
+        return NULL;
+    }
+
+    return fs;
+}
+
+bool file_saver_is_done(FileSaver* fs)
+{
+    return SDL_AtomicGet(&fs->done) != 0;
+}
+
+int file_saver_finish(FileSaver* fs, TextBuffer* tb, FileSaveStats* stats)
+{
+    SDL_WaitThread(fs->thread, NULL);
+
+    if (fs->commit_pending)
+    {
+        // The buffer takes the copy and unmaps the file, which can then be replaced
+        bool detached = text_buffer_detach_file(tb, fs->original_copy) != 0;
+        fs->original_copy = NULL;
+        if (!detached)
+        {
+            kFileWriter_abort(&fs->writer);
+            fs->result = 0;
+        }
+        else if (!kFileWriter_commit(&fs->writer))
+        {
+            fprintf(stderr, "[file_saver] Failed to replace %s\n", fs->path);
+            fs->result = 0;
+        }
+    }
+    free(fs->original_copy);
+
+    int result = fs->result;
+    if (stats) *stats = fs->stats;
+
+    text_buffer_snapshot_free(&fs->snapshot);
+    free(fs->path);
+    free(fs);
+    return result;
+}
@@ -3,105 +3,559 @@
 #include <string.h>
 #include <stdio.h>
 
+#define FONT_MANAGER_MIN_TABLE 64
+
 static FontManager* instance = NULL;
 
-FontManager* font_manager_get()
+static uint64_t hash_string(const char* s)
 {
-    if (!instance)
+    uint64_t h = 14695981039346656037ull; // FNV-1a
+    for (; *s; s++)
     {
-        instance = malloc(sizeof(FontManager));
-        instance->fonts = NULL;
-        instance->sizes = NULL;
-        instance->paths = NULL;
-        instance->count = 0;
+        h ^= (unsigned char)*s;
+        h *= 1099511628211ull;
     }
-    return instance;
+    return h;
 }
 
-void font_manager_load_font(const char* path, int size)
+static uint64_t hash_bytes(const char* data, size_t length)
 {
-    FontManager* fm = font_manager_get();
+    uint64_t h = 14695981039346656037ull; // FNV-1a
+    for (size_t i = 0; i < length; i++)
+    {
+        h ^= (unsigned char)data[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
 
-    // Check if font is already loaded
-    for (size_t i = 0; i < fm->count; i++)
+static uint64_t hash_int(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33;
+    return x;
+}
+
+static uint64_t hash_font_key(int path, int size)
+{
+    return hash_int(((uint64_t)(uint32_t)path << 32) | (uint32_t)size);
+}
+
+static uint64_t hash_pointer(const TTF_Font* font)
+{
+    return hash_int((uint64_t)(uintptr_t)font);
+}
+
+static int* new_table(int size)
+{
+    int* table = malloc(size * sizeof(int));
+    if (table) memset(table, -1, size * sizeof(int));
+    return table;
+}
+
+// Slot holding the path, or the empty slot it would go in
+static int* find_path_slot(FontManager* fm, const char* path)
+{
+    int mask = fm->path_table_size - 1;
+    for (int i = (int)(hash_string(path) & mask); ; i = (i + 1) & mask)
+    {
+        int* slot = &fm->path_table[i];
+        if (*slot < 0 || strcmp(fm->paths[*slot].path, path) == 0) return slot;
+    }
+}
+
+static int* find_font_slot(FontManager* fm, int path, int size)
+{
+    int mask = fm->font_table_size - 1;
+    for (int i = (int)(hash_font_key(path, size) & mask); ; i = (i + 1) & mask)
+    {
+        int* slot = &fm->font_table[i];
+        if (*slot < 0 || (fm->entries[*slot].path == path && fm->entries[*slot].size == size)) return slot;
+    }
+}
+
+static int* find_pointer_slot(FontManager* fm, const TTF_Font* font)
+{
+    int mask = fm->font_table_size - 1;
+    for (int i = (int)(hash_pointer(font) & mask); ; i = (i + 1) & mask)
+    {
+        int* slot = &fm->pointer_table[i];
+        if (*slot < 0 || fm->entries[*slot].font == font) return slot;
+    }
+}
+
+// Keeps tables at most half full, rehashing everything into bigger ones
+static int grow_path_table(FontManager* fm)
+{
+    if ((fm->path_count + 1) * 2 <= fm->path_table_size) return 1;
+
+    int size = fm->path_table_size ? fm->path_table_size * 2 : FONT_MANAGER_MIN_TABLE;
+    int* table = new_table(size);
+    if (!table) return 0;
+
+    free(fm->path_table);
+    fm->path_table = table;
+    fm->path_table_size = size;
+    for (int i = 0; i < fm->path_count; i++) *find_path_slot(fm, fm->paths[i].path) = i;
+    return 1;
+}
+
+static int grow_font_tables(FontManager* fm)
+{
+    if ((fm->count + 1) * 2 <= fm->font_table_size) return 1;
+
+    int size = fm->font_table_size ? fm->font_table_size * 2 : FONT_MANAGER_MIN_TABLE;
+    int* fonts = new_table(size);
+    int* pointers = new_table(size);
+    if (!fonts || !pointers)
+    {
+        free(fonts);
+        free(pointers);
+        return 0;
+    }
+
+    free(fm->font_table);
+    free(fm->pointer_table);
+    fm->font_table = fonts;
+    fm->pointer_table = pointers;
+    fm->font_table_size = size;
+    for (int i = 0; i < fm->count; i++)
+    {
+        *find_font_slot(fm, fm->entries[i].path, fm->entries[i].size) = i;
+        if (fm->entries[i].font) *find_pointer_slot(fm, fm->entries[i].font) = i;
+    }
+    return 1;
+}
+
+// Index of the interned copy of a path, interning it if needed
+static int intern_path(FontManager* fm, const char* path)
+{
+    if (!grow_path_table(fm)) return -1;
+
+    int* slot = find_path_slot(fm, path);
+    if (*slot >= 0) return *slot;
+
+    if (fm->path_count == fm->path_capacity)
+    {
+        int new_capacity = fm->path_capacity ? fm->path_capacity * 2 : 8;
+        FontFile* paths = realloc(fm->paths, new_capacity * sizeof(FontFile));
+        if (!paths) return -1;
+        fm->paths = paths;
+        fm->path_capacity = new_capacity;
+    }
+
+    char* copy = strdup(path);
+    if (!copy) return -1;
+
+    memset(&fm->paths[fm->path_count], 0, sizeof(FontFile));
+    fm->paths[fm->path_count].path = copy;
+    *slot = fm->path_count;
+    return fm->path_count++;
+}
+
+// Opens a size of a font, from its mapped file when there is one
+static TTF_Font* open_font(FontManager* fm, const char* path, const char* data, size_t length, int size)
+{
+    SDL_LockMutex(fm->open_lock);
+    TTF_Font* font = NULL;
+    if (data)
+    {
+        SDL_RWops* rw = SDL_RWFromConstMem(data, (int)length);
+        if (rw) font = TTF_OpenFontRW(rw, 1, size);
+    }
+    else
+    {
+        font = TTF_OpenFont(path, size);
+    }
+    SDL_UnlockMutex(fm->open_lock);
+    return font;
+}
+
+// Maps a font file the first time one of its sizes is opened
+static void map_file(FontFile* file)
+{
+    if (file->mapped || file->map_failed) return;
+
+    if (kFileMap_open(&file->map, file->path) && file->map.data)
+    {
+        file->mapped = true;
+        file->hash = hash_bytes(file->map.data, file->map.size);
+        if (file->hash == 0) file->hash = 1; // 0 means unknown
+    }
+    else
+    {
+        file->map_failed = true;
+    }
+}
+
+static int font_manager_worker(void* user)
+{
+    FontManager* fm = user;
+
+    SDL_LockMutex(fm->lock);
+    for (;;)
     {
-        if (fm->sizes[i] == size && strcmp(fm->paths[i], path) == 0)
+        while (!fm->stop && fm->request_count == 0) SDL_CondWait(fm->wake, fm->lock);
+        if (fm->stop) break;
+
+        fm->working = fm->requests[0];
+        fm->busy = true;
+        fm->request_count--;
+        memmove(fm->requests, fm->requests + 1, fm->request_count * sizeof(FontPrewarm));
+        SDL_UnlockMutex(fm->lock);
+
+        FontPrewarm* w = &fm->working;
+        w->font = open_font(fm, w->path_name, w->data, w->length, w->size);
+        if (w->font)
         {
-            return; // Font already loaded
+            // The UI thread only measures glyphs with this font, their pixels
+            // are rendered into the atlas by the raster pool's own copies
+            int minx, maxx, miny, maxy, advance;
+            for (Uint32 c = FONT_PREWARM_FIRST_GLYPH; c <= FONT_PREWARM_LAST_GLYPH; c++)
+            {
+                TTF_GlyphMetrics32(w->font, c, &minx, &maxx, &miny, &maxy, &advance);
+            }
         }
+
+        SDL_LockMutex(fm->lock);
+        fm->ready[fm->ready_count++] = *w;
+        fm->busy = false;
+        SDL_CondBroadcast(fm->done);
     }
+    SDL_UnlockMutex(fm->lock);
 
-    TTF_Font* font = TTF_OpenFont(path, size);
-    if (!font)
+    return 0;
+}
+
+static bool start_worker(FontManager* fm)
+{
+    if (fm->worker) return true;
+    if (!fm->lock) return false;
+
+    fm->wake = SDL_CreateCond();
+    fm->done = SDL_CreateCond();
+    fm->worker = fm->wake && fm->done ? SDL_CreateThread(font_manager_worker, "font_manager", fm) : NULL;
+    if (!fm->worker)
     {
-        fprintf(stderr, "Failed to load font: %s\n", TTF_GetError());
-        return;
+        fprintf(stderr, "[font_manager] Failed to create thread: %s\n", SDL_GetError());
+        if (fm->wake) SDL_DestroyCond(fm->wake);
+        if (fm->done) SDL_DestroyCond(fm->done);
+        fm->wake = NULL;
+        fm->done = NULL;
+        return false;
     }
+    return true;
+}
 
-    fm->fonts = realloc(fm->fonts, sizeof(TTF_Font*) * (fm->count + 1));
-    fm->sizes = realloc(fm->sizes, sizeof(int) * (fm->count + 1));
-    fm->paths = realloc(fm->paths, sizeof(char*) * (fm->count + 1));
+// Adds a font under a new handle, the slot must be the empty one for its key
+static FontHandle add_entry(FontManager* fm, int* slot, int path, int size, TTF_Font* font)
+{
+    if (fm->count == fm->capacity)
+    {
+        int new_capacity = fm->capacity ? fm->capacity * 2 : 16;
+        FontEntry* entries = realloc(fm->entries, new_capacity * sizeof(FontEntry));
+        if (!entries) return FONT_HANDLE_INVALID;
+        fm->entries = entries;
+        fm->capacity = new_capacity;
+    }
 
-    fm->fonts[fm->count] = font;
-    fm->sizes[fm->count] = size;
-    fm->paths[fm->count] = strdup(path);
-    fm->count++;
+    FontHandle handle = fm->count++;
+    fm->entries[handle].font = font;
+    fm->entries[handle].size = size;
+    fm->entries[handle].path = path;
+    *slot = handle;
+    if (font) *find_pointer_slot(fm, font) = handle;
+    return handle;
 }
 
-TTF_Font* font_manager_get_font(const char* path, int size)
+// Takes the fonts opened in the background
+static void collect_ready(FontManager* fm)
 {
-    FontManager* fm = font_manager_get();
+    if (!fm->worker) return;
+
+    FontPrewarm ready[FONT_PREWARM_QUEUE];
+    SDL_LockMutex(fm->lock);
+    int count = fm->ready_count;
+    memcpy(ready, fm->ready, count * sizeof(FontPrewarm));
+    fm->ready_count = 0;
+    SDL_UnlockMutex(fm->lock);
 
-    font_manager_load_font(path, size);
-    for (size_t i = 0; i < fm->count; i++)
+    for (int i = 0; i < count; i++)
     {
-        if (fm->sizes[i] == size && strcmp(fm->paths[i], path) == 0)
+        int* slot = grow_font_tables(fm) ? find_font_slot(fm, ready[i].path, ready[i].size) : NULL;
+        if (slot && *slot < 0 && add_entry(fm, slot, ready[i].path, ready[i].size, ready[i].font) != FONT_HANDLE_INVALID)
         {
-            return fm->fonts[i];
+            continue;
         }
+
+        SDL_LockMutex(fm->open_lock);
+        if (ready[i].font) TTF_CloseFont(ready[i].font);
+        SDL_UnlockMutex(fm->open_lock);
     }
-    return NULL;
 }
 
-const char* font_manager_get_font_path(TTF_Font* font)
+// Withdraws a queued request, or waits for it if the worker is already on it
+static void cancel_prewarm(FontManager* fm, int path, int size)
 {
-    FontManager* fm = font_manager_get();
-    for (size_t i = 0; i < fm->count; i++)
+    if (!fm->worker) return;
+
+    SDL_LockMutex(fm->lock);
+    for (int i = 0; i < fm->request_count; i++)
     {
-        if (fm->fonts[i] == font)
+        if (fm->requests[i].path == path && fm->requests[i].size == size)
         {
-            return fm->paths[i];
+            fm->request_count--;
+            memmove(fm->requests + i, fm->requests + i + 1, (fm->request_count - i) * sizeof(FontPrewarm));
+            break;
         }
     }
-    return NULL;
+    while (fm->busy && fm->working.path == path && fm->working.size == size) SDL_CondWait(fm->done, fm->lock);
+    SDL_UnlockMutex(fm->lock);
+
+    collect_ready(fm);
 }
 
-int font_manager_get_font_size(TTF_Font* font)
+FontManager* font_manager_get()
 {
-    FontManager* fm = font_manager_get();
-    for (size_t i = 0; i < fm->count; i++)
+    if (!instance)
     {
-        if (fm->fonts[i] == font)
+        instance = calloc(1, sizeof(FontManager));
+        if (instance)
         {
-            return fm->sizes[i];
+            instance->open_lock = SDL_CreateMutex();
+            instance->lock = SDL_CreateMutex();
         }
     }
-    return -1;
+    return instance;
+}
+
+FontHandle font_manager_load(const char* path, int size)
+{
+    FontManager* fm = font_manager_get();
+    if (!fm || !path) return FONT_HANDLE_INVALID;
+
+    collect_ready(fm);
+
+    int path_index = intern_path(fm, path);
+    if (path_index < 0 || !grow_font_tables(fm)) return FONT_HANDLE_INVALID;
+
+    // Check if font is already loaded
+    int* slot = find_font_slot(fm, path_index, size);
+    if (*slot < 0)
+    {
+        cancel_prewarm(fm, path_index, size);
+        if (!grow_font_tables(fm)) return FONT_HANDLE_INVALID;
+        slot = find_font_slot(fm, path_index, size);
+    }
+    if (*slot >= 0) return fm->entries[*slot].font ? *slot : FONT_HANDLE_INVALID;
+
+    FontFile* file = &fm->paths[path_index];
+    map_file(file);
+
+    TTF_Font* font = open_font(fm, path, file->mapped ? file->map.data : NULL, file->map.size, size);
+    if (!font)
+    {
+        fprintf(stderr, "Failed to load font: %s\n", TTF_GetError());
+    }
+
+    // Failures are remembered too, so they are not retried every frame
+    FontHandle handle = add_entry(fm, slot, path_index, size, font);
+    if (handle == FONT_HANDLE_INVALID)
+    {
+        if (font) TTF_CloseFont(font);
+        return FONT_HANDLE_INVALID;
+    }
+    return font ? handle : FONT_HANDLE_INVALID;
+}
+
+SdfFont* font_manager_sdf(const char* path)
+{
+    FontManager* fm = font_manager_get();
+    if (!fm || !path) return NULL;
+
+    FontHandle base = font_manager_load(path, SDF_FONT_BASE_SIZE);
+    if (base == FONT_HANDLE_INVALID) return NULL;
+
+    FontFile* file = &fm->paths[fm->entries[base].path];
+    if (!file->sdf) file->sdf = sdf_font_create(fm->entries[base].font);
+    return file->sdf;
+}
+
+void font_manager_prewarm(const char* path, int size)
+{
+    FontManager* fm = font_manager_get();
+    if (!fm || !path || size <= 0) return;
+
+    collect_ready(fm);
+
+    int path_index = intern_path(fm, path);
+    if (path_index < 0 || !grow_font_tables(fm)) return;
+    if (*find_font_slot(fm, path_index, size) >= 0) return;
+    if (!start_worker(fm)) return;
+
+    FontFile* file = &fm->paths[path_index];
+    map_file(file);
+
+    SDL_LockMutex(fm->lock);
+    bool known = fm->busy && fm->working.path == path_index && fm->working.size == size;
+    for (int i = 0; i < fm->request_count && !known; i++)
+    {
+        known = fm->requests[i].path == path_index && fm->requests[i].size == size;
+    }
+    for (int i = 0; i < fm->ready_count && !known; i++)
+    {
+        known = fm->ready[i].path == path_index && fm->ready[i].size == size;
+    }
+
+    // Ready fonts are only taken on the UI thread, leave room for every request
+    if (!known && fm->request_count + fm->ready_count + fm->busy < FONT_PREWARM_QUEUE)
+    {
+        FontPrewarm* r = &fm->requests[fm->request_count++];
+        r->path = path_index;
+        r->path_name = file->path;
+        r->size = size;
+        r->data = file->mapped ? file->map.data : NULL;
+        r->length = file->map.size;
+        r->font = NULL;
+        SDL_CondSignal(fm->wake);
+    }
+    SDL_UnlockMutex(fm->lock);
+}
+
+TTF_Font* font_manager_peek(const char* path, int size)
+{
+    FontManager* fm = font_manager_get();
+    if (!fm || !path) return NULL;
+
+    collect_ready(fm);
+
+    int path_index = intern_path(fm, path);
+    if (path_index < 0 || !grow_font_tables(fm)) return NULL;
+
+    int handle = *find_font_slot(fm, path_index, size);
+    return handle >= 0 ? fm->entries[handle].font : NULL;
+}
+
+TTF_Font* font_manager_font(FontHandle handle)
+{
+    if (!instance || handle < 0 || handle >= instance->count) return NULL;
+    return instance->entries[handle].font;
+}
+
+int font_manager_size(FontHandle handle)
+{
+    if (!instance || handle < 0 || handle >= instance->count) return -1;
+    return instance->entries[handle].size;
+}
+
+const char* font_manager_path(FontHandle handle)
+{
+    if (!instance || handle < 0 || handle >= instance->count) return NULL;
+    return instance->paths[instance->entries[handle].path].path;
+}
+
+uint64_t font_manager_file_hash(FontHandle handle)
+{
+    if (!instance || handle < 0 || handle >= instance->count) return 0;
+    return instance->paths[instance->entries[handle].path].hash;
+}
+
+bool font_manager_source(FontHandle handle, FontSource* source)
+{
+    if (!instance || handle < 0 || handle >= instance->count || !instance->entries[handle].font) return false;
+
+    const FontFile* file = &instance->paths[instance->entries[handle].path];
+    source->path = file->path;
+    source->data = file->mapped ? file->map.data : NULL;
+    source->length = file->map.size;
+    source->size = instance->entries[handle].size;
+    return true;
+}
+
+TTF_Font* font_manager_open_source(const FontSource* source)
+{
+    if (!instance || !source) return NULL;
+    return open_font(instance, source->path, source->data, source->length, source->size);
+}
+
+void font_manager_close_font(TTF_Font* font)
+{
+    if (!instance || !font) return;
+
+    SDL_LockMutex(instance->open_lock);
+    TTF_CloseFont(font);
+    SDL_UnlockMutex(instance->open_lock);
+}
+
+FontHandle font_manager_find(TTF_Font* font)
+{
+    if (!instance || !font || instance->font_table_size == 0) return FONT_HANDLE_INVALID;
+
+    int handle = *find_pointer_slot(instance, font);
+    return handle >= 0 ? handle : FONT_HANDLE_INVALID;
+}
+
+void font_manager_load_font(const char* path, int size)
+{
+    font_manager_load(path, size);
+}
+
+TTF_Font* font_manager_get_font(const char* path, int size)
+{
+    return font_manager_font(font_manager_load(path, size));
+}
+
+const char* font_manager_get_font_path(TTF_Font* font)
+{
+    return font_manager_path(font_manager_find(font));
+}
+
+int font_manager_get_font_size(TTF_Font* font)
+{
+    return font_manager_size(font_manager_find(font));
 }
 
 void font_manager_destroy()
 {
     if (!instance) return;
 
-    for (size_t i = 0; i < instance->count; i++)
+    if (instance->worker)
+    {
+        SDL_LockMutex(instance->lock);
+        instance->stop = true;
+        SDL_CondSignal(instance->wake);
+        SDL_UnlockMutex(instance->lock);
+        SDL_WaitThread(instance->worker, NULL);
+
+        for (int i = 0; i < instance->ready_count; i++)
+        {
+            if (instance->ready[i].font) TTF_CloseFont(instance->ready[i].font);
+        }
+        SDL_DestroyCond(instance->wake);
+        SDL_DestroyCond(instance->done);
+    }
+
+    for (int i = 0; i < instance->path_count; i++) sdf_font_destroy(instance->paths[i].sdf);
+    for (int i = 0; i < instance->count; i++)
+    {
+        if (instance->entries[i].font) TTF_CloseFont(instance->entries[i].font);
+    }
+
+    // Fonts read from the mappings, so they go after every font is closed
+    for (int i = 0; i < instance->path_count; i++)
     {
-        if (instance->fonts[i]) TTF_CloseFont(instance->fonts[i]);
-        free(instance->paths[i]);
+        if (instance->paths[i].mapped) kFileMap_close(&instance->paths[i].map);
+        free(instance->paths[i].path);
     }
 
-    free(instance->fonts);
-    free(instance->sizes);
+    if (instance->lock) SDL_DestroyMutex(instance->lock);
+    if (instance->open_lock) SDL_DestroyMutex(instance->open_lock);
+    free(instance->entries);
     free(instance->paths);
+    free(instance->path_table);
+    free(instance->font_table);
+    free(instance->pointer_table);
     free(instance);
     instance = NULL;
-}
\ No newline at end of file
+}
@@ -0,0 +1,378 @@
+#include "glyph_atlas.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+static SDL_Texture* atlas_create_page_texture(GlyphAtlas* atlas)
+{
+    SDL_Texture* page = SDL_CreateTexture(atlas->renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC,
+                                          GLYPH_ATLAS_PAGE_SIZE, GLYPH_ATLAS_PAGE_SIZE);
+    if (!page)
+    {
+        fprintf(stderr, "[glyph_atlas] Failed to create page: %s\n", SDL_GetError());
+        return NULL;
+    }
+    SDL_SetTextureBlendMode(page, SDL_BLENDMODE_BLEND);
+    return page;
+}
+
+static bool atlas_add_page(GlyphAtlas* atlas)
+{
+    if (atlas->page_count == GLYPH_ATLAS_MAX_PAGES) return false;
+
+    SDL_Texture* page = atlas_create_page_texture(atlas);
+    if (!page) return false;
+
+    Uint8* alpha = calloc((size_t)GLYPH_ATLAS_PAGE_SIZE * GLYPH_ATLAS_PAGE_SIZE, 1);
+    if (!alpha)
+    {
+        fprintf(stderr, "[glyph_atlas] Failed to allocate page coverage.\n");
+        SDL_DestroyTexture(page);
+        return false;
+    }
+
+    // Start transparent, glyph uploads only cover their own rects
+    void* clear = calloc((size_t)GLYPH_ATLAS_PAGE_SIZE * GLYPH_ATLAS_PAGE_SIZE, 4);
+    if (clear)
+    {
+        SDL_UpdateTexture(page, NULL, clear, GLYPH_ATLAS_PAGE_SIZE * 4);
+        free(clear);
+    }
+
+    atlas->page_alpha[atlas->page_count] = alpha;
+    atlas->pages[atlas->page_count++] = page;
+    atlas->shelf_x = 0;
+    atlas->shelf_y = 0;
+    atlas->shelf_height = 0;
+    return true;
+}
+
+// Finds room for a w x h rect, starting new shelves and pages as needed
+static bool atlas_allocate(GlyphAtlas* atlas, int w, int h, SDL_Rect* out)
+{
+    if (w > GLYPH_ATLAS_PAGE_SIZE || h > GLYPH_ATLAS_PAGE_SIZE) return false;
+
+    if (atlas->page_count == 0 && !atlas_add_page(atlas)) return false;
+
+    if (atlas->shelf_x + w > GLYPH_ATLAS_PAGE_SIZE)
+    {
+        atlas->shelf_x = 0;
+        atlas->shelf_y += atlas->shelf_height;
+        atlas->shelf_height = 0;
+    }
+
+    if (atlas->shelf_y + h > GLYPH_ATLAS_PAGE_SIZE && !atlas_add_page(atlas)) return false;
+
+    out->x = atlas->shelf_x;
+    out->y = atlas->shelf_y;
+    out->w = w;
+    out->h = h;
+
+    atlas->shelf_x += w + 1; // 1px gap so filtering never bleeds between glyphs
+    if (h + 1 > atlas->shelf_height) atlas->shelf_height = h + 1;
+    return true;
+}
+
+// Uploads white ARGB8888 glyph pixels to the last page, keeping their coverage
+static void atlas_store(GlyphAtlas* atlas, const SDL_Rect* rect, const void* pixels, int pitch)
+{
+    int page = atlas->page_count - 1;
+    SDL_UpdateTexture(atlas->pages[page], rect, pixels, pitch);
+
+    for (int y = 0; y < rect->h; y++)
+    {
+        const Uint32* src = (const Uint32*)((const Uint8*)pixels + y * pitch);
+        Uint8* dst = atlas->page_alpha[page] + (rect->y + y) * GLYPH_ATLAS_PAGE_SIZE + rect->x;
+        for (int x = 0; x < rect->w; x++) dst[x] = (Uint8)(src[x] >> 24);
+    }
+}
+
+static void atlas_store_glyph(GlyphAtlas* atlas, unsigned char c, AtlasGlyph* glyph, SDL_Surface* surface)
+{
+    SDL_Rect rect;
+    if (atlas_allocate(atlas, surface->w, surface->h, &rect))
+    {
+        atlas_store(atlas, &rect, surface->pixels, surface->pitch);
+        glyph->page = atlas->page_count - 1;
+        glyph->src = rect;
+    }
+    else
+    {
+        fprintf(stderr, "[glyph_atlas] No room for glyph %u\n", c);
+    }
+}
+
+static void atlas_load_sdf_glyph(GlyphAtlas* atlas, unsigned char c, AtlasGlyph* glyph)
+{
+    glyph->advance = sdf_font_advance(atlas->sdf, c, atlas->size);
+
+    int w, h;
+    sdf_font_glyph_box(atlas->sdf, c, atlas->size, &glyph->offset_x, &w, &h);
+    if (w <= 0 || h <= 0) return;
+
+    Uint32* pixels = malloc((size_t)w * h * sizeof(Uint32));
+    SDL_Rect rect;
+    if (pixels && sdf_font_resample(atlas->sdf, c, atlas->size, pixels, w * (int)sizeof(Uint32)) &&
+        atlas_allocate(atlas, w, h, &rect))
+    {
+        atlas_store(atlas, &rect, pixels, w * (int)sizeof(Uint32));
+        glyph->page = atlas->page_count - 1;
+        glyph->src = rect;
+    }
+    else
+    {
+        fprintf(stderr, "[glyph_atlas] No room for glyph %u\n", c);
+    }
+    free(pixels);
+}
+
+static void atlas_load_glyph(GlyphAtlas* atlas, unsigned char c, AtlasGlyph* glyph)
+{
+    glyph->loaded = true;
+    glyph->pending = false;
+    glyph->page = -1;
+    glyph->offset_x = 0;
+    glyph->advance = 0;
+    atlas->dirty = true;
+
+    if (atlas->sdf)
+    {
+        atlas_load_sdf_glyph(atlas, c, glyph);
+        return;
+    }
+
+    int minx, maxx, miny, maxy, advance;
+    if (TTF_GlyphMetrics32(atlas->font, c, &minx, &maxx, &miny, &maxy, &advance) != 0) return;
+    glyph->advance = advance;
+    glyph->offset_x = minx < 0 ? minx : 0;
+
+    if (maxx <= minx) return; // Nothing to draw, e.g. a space
+
+    // Metrics are enough to lay the glyph out, its pixels follow later
+    if (atlas->pool && raster_pool_submit(atlas->pool, atlas, &atlas->source, c))
+    {
+        glyph->pending = true;
+        atlas->pending_count++;
+        return;
+    }
+
+    SDL_Color white = { 255, 255, 255, 255 };
+    SDL_Surface* surface = TTF_RenderGlyph32_Blended(atlas->font, c, white);
+    if (!surface) return;
+
+    SDL_Surface* converted = surface;
+    if (surface->format->format != SDL_PIXELFORMAT_ARGB8888)
+    {
+        converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+    }
+
+    if (converted) atlas_store_glyph(atlas, c, glyph, converted);
+
+    if (converted && converted != surface) SDL_FreeSurface(converted);
+    SDL_FreeSurface(surface);
+}
+
+GlyphAtlas* glyph_atlas_create(SDL_Renderer* renderer, TTF_Font* font)
+{
+    GlyphAtlas* atlas = calloc(1, sizeof(GlyphAtlas));
+    if (!atlas)
+    {
+        fprintf(stderr, "[glyph_atlas] Failed to allocate GlyphAtlas.\n");
+        return NULL;
+    }
+
+    atlas->font = font;
+    atlas->renderer = renderer;
+    atlas->height = TTF_FontHeight(font);
+
+    // Fixed pitch fonts are laid out on a grid, without kerning
+    atlas->kerning = TTF_GetFontKerning(font) && !TTF_FontFaceIsFixedWidth(font);
+    return atlas;
+}
+
+GlyphAtlas* glyph_atlas_create_sdf(SDL_Renderer* renderer, SdfFont* sdf, int size)
+{
+    GlyphAtlas* atlas = calloc(1, sizeof(GlyphAtlas));
+    if (!atlas)
+    {
+        fprintf(stderr, "[glyph_atlas] Failed to allocate GlyphAtlas.\n");
+        return NULL;
+    }
+
+    atlas->sdf = sdf;
+    atlas->size = size;
+    atlas->renderer = renderer;
+    atlas->height = sdf_font_height(sdf, size);
+    atlas->kerning = sdf->kerning;
+    return atlas;
+}
+
+void glyph_atlas_destroy(GlyphAtlas* atlas)
+{
+    if (!atlas) return;
+
+    for (int i = 0; i < atlas->page_count; i++)
+    {
+        SDL_DestroyTexture(atlas->pages[i]);
+        free(atlas->page_alpha[i]);
+    }
+    free(atlas);
+}
+
+bool glyph_atlas_reload(GlyphAtlas* atlas)
+{
+    Uint32* pixels = malloc((size_t)GLYPH_ATLAS_PAGE_SIZE * GLYPH_ATLAS_PAGE_SIZE * sizeof(Uint32));
+    if (!pixels) return false;
+
+    bool ok = true;
+    for (int i = 0; i < atlas->page_count && ok; i++)
+    {
+        SDL_Texture* page = atlas_create_page_texture(atlas);
+        if (!page)
+        {
+            ok = false;
+            break;
+        }
+
+        const Uint8* alpha = atlas->page_alpha[i];
+        for (int p = 0; p < GLYPH_ATLAS_PAGE_SIZE * GLYPH_ATLAS_PAGE_SIZE; p++)
+        {
+            pixels[p] = ((Uint32)alpha[p] << 24) | 0x00FFFFFF;
+        }
+        ok = SDL_UpdateTexture(page, NULL, pixels, GLYPH_ATLAS_PAGE_SIZE * (int)sizeof(Uint32)) == 0;
+
+        SDL_DestroyTexture(atlas->pages[i]);
+        atlas->pages[i] = page;
+    }
+
+    free(pixels);
+    return ok;
+}
+
+void glyph_atlas_set_pool(GlyphAtlas* atlas, RasterPool* pool, const FontSource* source)
+{
+    // Distance field glyphs are resampled, there is nothing to rasterize
+    if (atlas->sdf) return;
+
+    atlas->pool = pool;
+    if (source) atlas->source = *source;
+}
+
+bool glyph_atlas_complete(GlyphAtlas* atlas, unsigned char c, SDL_Surface* surface)
+{
+    AtlasGlyph* glyph = &atlas->glyphs[c];
+    if (!glyph->pending) return false;
+
+    glyph->pending = false;
+    atlas->pending_count--;
+    atlas->dirty = true;
+    if (surface) atlas_store_glyph(atlas, c, glyph, surface);
+    return true;
+}
+
+bool glyph_atlas_upload_page(GlyphAtlas* atlas, const Uint8* alpha, int rows)
+{
+    if (rows < 0 || rows > GLYPH_ATLAS_PAGE_SIZE || !atlas_add_page(atlas)) return false;
+    if (rows == 0) return true;
+
+    Uint32* pixels = malloc((size_t)GLYPH_ATLAS_PAGE_SIZE * rows * sizeof(Uint32));
+    if (!pixels) return false;
+
+    for (int i = 0; i < GLYPH_ATLAS_PAGE_SIZE * rows; i++) pixels[i] = ((Uint32)alpha[i] << 24) | 0x00FFFFFF;
+
+    SDL_Rect rect = { 0, 0, GLYPH_ATLAS_PAGE_SIZE, rows };
+    atlas_store(atlas, &rect, pixels, GLYPH_ATLAS_PAGE_SIZE * (int)sizeof(Uint32));
+    free(pixels);
+    return true;
+}
+
+const AtlasGlyph* glyph_atlas_get(GlyphAtlas* atlas, unsigned char c)
+{
+    AtlasGlyph* glyph = &atlas->glyphs[c];
+    if (!glyph->loaded) atlas_load_glyph(atlas, c, glyph);
+    return glyph;
+}
+
+int glyph_atlas_kerning(GlyphAtlas* atlas, unsigned char prev, unsigned char c)
+{
+    if (!atlas->kerning) return 0;
+    if (atlas->sdf) return sdf_font_kerning(atlas->sdf, prev, c, atlas->size);
+    return TTF_GetFontKerningSizeGlyphs32(atlas->font, prev, c);
+}
+
+int glyph_atlas_digit_width(GlyphAtlas* atlas)
+{
+    if (atlas->digit_width == 0)
+    {
+        for (unsigned char c = '0'; c <= '9'; c++)
+        {
+            int advance = glyph_atlas_get(atlas, c)->advance;
+            if (advance > atlas->digit_width) atlas->digit_width = advance;
+        }
+    }
+    return atlas->digit_width;
+}
+
+int glyph_atlas_measure(GlyphAtlas* atlas, const char* text, size_t length)
+{
+    int width = 0;
+    unsigned char prev = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        unsigned char c = (unsigned char)text[i];
+        if (i > 0) width += glyph_atlas_kerning(atlas, prev, c);
+        width += glyph_atlas_get(atlas, c)->advance;
+        prev = c;
+    }
+    return width;
+}
+
+SDL_Surface* glyph_atlas_render_text(GlyphAtlas* atlas, const char* text, size_t length, SDL_Color color)
+{
+    int width = glyph_atlas_measure(atlas, text, length);
+    if (width <= 0 || atlas->height <= 0) return NULL;
+
+    if (atlas->pending_count > 0)
+    {
+        for (size_t i = 0; i < length; i++)
+        {
+            if (atlas->glyphs[(unsigned char)text[i]].pending) return NULL;
+        }
+    }
+
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, width, atlas->height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (!surface) return NULL;
+    SDL_memset(surface->pixels, 0, (size_t)surface->pitch * surface->h);
+
+    Uint32 rgb = ((Uint32)color.r << 16) | ((Uint32)color.g << 8) | color.b;
+    int pen = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        unsigned char c = (unsigned char)text[i];
+        if (i > 0) pen += glyph_atlas_kerning(atlas, (unsigned char)text[i - 1], c);
+
+        const AtlasGlyph* glyph = glyph_atlas_get(atlas, c);
+        if (glyph->page >= 0)
+        {
+            // Glyphs may overhang the text's box, those pixels are clipped
+            int x0 = pen + glyph->offset_x;
+            int rows = glyph->src.h < surface->h ? glyph->src.h : surface->h;
+            for (int y = 0; y < rows; y++)
+            {
+                const Uint8* src = atlas->page_alpha[glyph->page] + (glyph->src.y + y) * GLYPH_ATLAS_PAGE_SIZE + glyph->src.x;
+                Uint32* dst = (Uint32*)((Uint8*)surface->pixels + y * surface->pitch);
+                for (int x = 0; x < glyph->src.w; x++)
+                {
+                    int dx = x0 + x;
+                    if (dx < 0 || dx >= width || src[x] == 0) continue;
+
+                    // Overlapping glyphs keep the stronger coverage
+                    Uint32 a = (Uint32)src[x] * color.a / 255;
+                    if (a > dst[dx] >> 24) dst[dx] = (a << 24) | rgb;
+                }
+            }
+        }
+        pen += glyph->advance;
+    }
+    return surface;
+}
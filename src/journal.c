@@ -0,0 +1,319 @@
+#include "journal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define JOURNAL_INSERT 1
+#define JOURNAL_DELETE 2
+
+static const char journal_magic[4] = { 'K', 'S', 'W', 'P' };
+
+static char* journal_path(const char* file_path)
+{
+    size_t len = strlen(file_path);
+    char* path = malloc(len + sizeof(JOURNAL_SUFFIX));
+    if (!path) return NULL;
+
+    memcpy(path, file_path, len);
+    memcpy(path + len, JOURNAL_SUFFIX, sizeof(JOURNAL_SUFFIX));
+    return path;
+}
+
+// FNV-1a, enough to tell a torn write from a record
+static uint32_t journal_checksum(uint32_t h, const void* data, size_t length)
+{
+    const unsigned char* p = data;
+    for (size_t i = 0; i < length; i++)
+    {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void journal_make_header(char* header, uint64_t base_length, uint64_t base_hash)
+{
+    uint32_t version = JOURNAL_VERSION;
+    memcpy(header, journal_magic, 4);
+    memcpy(header + 4, &version, 4);
+    memcpy(header + 8, &base_length, 8);
+    memcpy(header + 16, &base_hash, 8);
+}
+
+static bool buffer_append(char** data, size_t* length, size_t* capacity, const void* src, size_t size)
+{
+    if (size == 0) return true;
+
+    if (*length + size > *capacity)
+    {
+        size_t new_capacity = *capacity ? *capacity * 2 : 4096;
+        while (new_capacity < *length + size) new_capacity *= 2;
+
+        char* grown = realloc(*data, new_capacity);
+        if (!grown) return false;
+        *data = grown;
+        *capacity = new_capacity;
+    }
+
+    memcpy(*data + *length, src, size);
+    *length += size;
+    return true;
+}
+
+static int journal_thread(void* user)
+{
+    Journal* j = user;
+    char* batch = NULL;
+    size_t batch_capacity = 0;
+
+    SDL_LockMutex(j->lock);
+    for (;;)
+    {
+        // Sleep until something is queued, then let records pile up for a
+        // while so each sync covers many of them
+        while (!j->stop && j->pending_length == 0 && !j->rewrite) SDL_CondWait(j->wake, j->lock);
+        if (!j->stop) SDL_CondWaitTimeout(j->wake, j->lock, JOURNAL_FLUSH_INTERVAL_MS);
+
+        bool stopping = j->stop;
+        bool rewrite = j->rewrite;
+        char header[JOURNAL_HEADER_SIZE];
+        memcpy(header, j->header, sizeof(header));
+
+        // Swap buffers so recording can continue while this batch is written
+        char* data = j->pending;
+        size_t length = j->pending_length;
+        size_t capacity = j->pending_capacity;
+        j->pending = batch;
+        j->pending_length = 0;
+        j->pending_capacity = batch_capacity;
+        j->rewrite = false;
+        batch = data;
+        batch_capacity = capacity;
+
+        if (rewrite || length > 0)
+        {
+            SDL_UnlockMutex(j->lock);
+
+            bool ok = true;
+            if (rewrite)
+            {
+                ok = kFileAppender_truncate(&j->file, 0) &&
+                     kFileAppender_write(&j->file, header, sizeof(header));
+            }
+            ok = ok && (length == 0 || kFileAppender_write(&j->file, data, length));
+            ok = ok && kFileAppender_sync(&j->file);
+            if (!ok) fprintf(stderr, "[journal] Failed to write %s\n", j->path);
+
+            SDL_LockMutex(j->lock);
+            j->flushes++;
+            j->written = (rewrite ? sizeof(header) : j->written) + length;
+        }
+
+        if (stopping) break;
+    }
+    SDL_UnlockMutex(j->lock);
+
+    free(batch);
+    return 0;
+}
+
+static void journal_record(Journal* j, uint8_t type, size_t offset, const char* text, size_t length)
+{
+    char header[JOURNAL_RECORD_HEADER];
+    uint64_t offset64 = offset;
+    uint64_t length64 = length;
+    header[0] = (char)type;
+    memcpy(header + 1, &offset64, 8);
+    memcpy(header + 9, &length64, 8);
+
+    size_t text_length = type == JOURNAL_INSERT ? length : 0;
+    uint32_t checksum = journal_checksum(2166136261u, header, sizeof(header));
+    checksum = journal_checksum(checksum, text, text_length);
+
+    SDL_LockMutex(j->lock);
+    bool idle = j->pending_length == 0 && !j->rewrite;
+    bool ok = buffer_append(&j->pending, &j->pending_length, &j->pending_capacity, header, sizeof(header)) &&
+              buffer_append(&j->pending, &j->pending_length, &j->pending_capacity, text, text_length) &&
+              buffer_append(&j->pending, &j->pending_length, &j->pending_capacity, &checksum, sizeof(checksum));
+    if (idle) SDL_CondSignal(j->wake); // Starts the flush interval
+    SDL_UnlockMutex(j->lock);
+
+    if (j->saving)
+    {
+        ok = buffer_append(&j->since_save, &j->since_save_length, &j->since_save_capacity, header, sizeof(header)) &&
+             buffer_append(&j->since_save, &j->since_save_length, &j->since_save_capacity, text, text_length) &&
+             buffer_append(&j->since_save, &j->since_save_length, &j->since_save_capacity, &checksum, sizeof(checksum)) &&
+             ok;
+    }
+
+    if (!ok) fprintf(stderr, "[journal] Failed to queue record for %s\n", j->path);
+}
+
+bool journal_replay(const char* file_path, TextBuffer* tb, JournalReplayStats* stats)
+{
+    char* path = journal_path(file_path);
+    if (!path) return false;
+
+    kFileMap map;
+    if (!kFileMap_open(&map, path))
+    {
+        free(path); // No journal, nothing to recover
+        return false;
+    }
+
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    // Only replay onto the exact text the journal was recorded against
+    char expected[JOURNAL_HEADER_SIZE];
+    journal_make_header(expected, text_buffer_length(tb), text_buffer_hash(tb));
+    if (map.size < JOURNAL_HEADER_SIZE || memcmp(map.data, expected, JOURNAL_HEADER_SIZE) != 0)
+    {
+        printf("[journal] Ignoring %s, it was recorded against different text\n", path);
+        kFileMap_close(&map);
+        free(path);
+        return false;
+    }
+
+    size_t records = 0;
+    size_t pos = JOURNAL_HEADER_SIZE;
+    while (map.size - pos >= JOURNAL_RECORD_HEADER + JOURNAL_CHECKSUM_SIZE)
+    {
+        const char* record = map.data + pos;
+        uint8_t type = (uint8_t)record[0];
+        uint64_t offset, length;
+        memcpy(&offset, record + 1, 8);
+        memcpy(&length, record + 9, 8);
+
+        size_t available = map.size - pos - JOURNAL_RECORD_HEADER - JOURNAL_CHECKSUM_SIZE;
+        if ((type != JOURNAL_INSERT && type != JOURNAL_DELETE) || (type == JOURNAL_INSERT && length > available)) break;
+        size_t text_length = type == JOURNAL_INSERT ? length : 0;
+
+        uint32_t checksum;
+        memcpy(&checksum, record + JOURNAL_RECORD_HEADER + text_length, sizeof(checksum));
+        if (journal_checksum(2166136261u, record, JOURNAL_RECORD_HEADER + text_length) != checksum) break;
+
+        size_t doc_length = text_buffer_length(tb);
+        if (offset > doc_length || (type == JOURNAL_DELETE && length > doc_length - offset)) break;
+
+        if (type == JOURNAL_INSERT) text_buffer_insert(tb, offset, record + JOURNAL_RECORD_HEADER, length);
+        else text_buffer_delete(tb, offset, length);
+
+        records++;
+        pos += JOURNAL_RECORD_HEADER + text_length + JOURNAL_CHECKSUM_SIZE;
+    }
+
+    double seconds = (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+    printf("[journal] Replayed %zu edits from %s (%.1f KB, %zu bytes torn) in %.3f ms\n",
+           records, path, pos / 1024.0, map.size - pos, seconds * 1000.0);
+
+    if (stats)
+    {
+        stats->records = records;
+        stats->bytes = pos;
+        stats->seconds = seconds;
+    }
+
+    kFileMap_close(&map);
+    free(path);
+    return true;
+}
+
+Journal* journal_open(const char* file_path, size_t base_length, uint64_t base_hash, size_t keep)
+{
+    Journal* j = calloc(1, sizeof(Journal));
+    if (!j) return NULL;
+
+    j->path = journal_path(file_path);
+    if (!j->path || !kFileAppender_open(&j->file, j->path))
+    {
+        fprintf(stderr, "[journal] Failed to open journal for %s\n", file_path);
+        free(j->path);
+        free(j);
+        return NULL;
+    }
+
+    journal_make_header(j->header, base_length, base_hash);
+    if (keep >= JOURNAL_HEADER_SIZE && kFileAppender_truncate(&j->file, keep))
+    {
+        j->written = keep; // Drops a torn record left at the end
+    }
+    else
+    {
+        j->rewrite = true;
+    }
+
+    j->lock = SDL_CreateMutex();
+    j->wake = SDL_CreateCond();
+    j->thread = j->lock && j->wake ? SDL_CreateThread(journal_thread, "journal", j) : NULL;
+    if (!j->thread)
+    {
+        fprintf(stderr, "[journal] Failed to create thread: %s\n", SDL_GetError());
+        if (j->wake) SDL_DestroyCond(j->wake);
+        if (j->lock) SDL_DestroyMutex(j->lock);
+        kFileAppender_close(&j->file);
+        free(j->path);
+        free(j);
+        return NULL;
+    }
+
+    return j;
+}
+
+void journal_close(Journal* j, bool remove_file)
+{
+    if (!j) return;
+
+    SDL_LockMutex(j->lock);
+    j->stop = true;
+    SDL_CondSignal(j->wake);
+    SDL_UnlockMutex(j->lock);
+    SDL_WaitThread(j->thread, NULL);
+
+    kFileAppender_close(&j->file);
+    printf("[journal] Closed %s: %zu flushes, %.1f KB\n", j->path, j->flushes, j->written / 1024.0);
+    if (remove_file) remove(j->path);
+
+    SDL_DestroyCond(j->wake);
+    SDL_DestroyMutex(j->lock);
+    free(j->pending);
+    free(j->since_save);
+    free(j->path);
+    free(j);
+}
+
+void journal_record_insert(Journal* j, size_t offset, const char* text, size_t length)
+{
+    if (length > 0) journal_record(j, JOURNAL_INSERT, offset, text, length);
+}
+
+void journal_record_delete(Journal* j, size_t offset, size_t length)
+{
+    if (length > 0) journal_record(j, JOURNAL_DELETE, offset, NULL, length);
+}
+
+void journal_begin_save(Journal* j)
+{
+    j->saving = true;
+    j->since_save_length = 0;
+}
+
+void journal_end_save(Journal* j, const FileSaveStats* stats)
+{
+    if (!j->saving) return;
+    j->saving = false;
+    if (!stats) return;
+
+    // Edits made while the save was written still apply on top of it
+    SDL_LockMutex(j->lock);
+    journal_make_header(j->header, stats->bytes, stats->hash);
+    j->pending_length = 0;
+    if (!buffer_append(&j->pending, &j->pending_length, &j->pending_capacity, j->since_save, j->since_save_length))
+    {
+        fprintf(stderr, "[journal] Failed to restart %s\n", j->path);
+    }
+    j->rewrite = true;
+    SDL_CondSignal(j->wake);
+    SDL_UnlockMutex(j->lock);
+
+    j->since_save_length = 0;
+}
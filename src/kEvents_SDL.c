@@ -63,19 +63,16 @@ static kKeycode translate_key(SDL_Keycode sym)
 
 static kKeymod translate_mod(Uint16 mod)
 {
-    kKeycode m = KMOD_NONE;
-    if (mod & KKEYMOD_SHIFT) m |= KKEYMOD_SHIFT;
-    if (mod & KKEYMOD_CTRL)  m |= KKEYMOD_CTRL;
-    if (mod & KKEYMOD_ALT)   m |= KKEYMOD_ALT;
+    kKeymod m = KKEYMOD_NONE;
+    if (mod & KMOD_SHIFT) m |= KKEYMOD_SHIFT;
+    if (mod & KMOD_CTRL)  m |= KKEYMOD_CTRL;
+    if (mod & KMOD_ALT)   m |= KKEYMOD_ALT;
     return m;
 }
 
-int kPollEvent(kEvent* ev)
+static void translate_event(const SDL_Event* sdl_ev, kEvent* ev)
 {
-    SDL_Event sdl_ev;
-    if (!SDL_PollEvent(&sdl_ev)) return 0;
-
-    switch (sdl_ev.type)
+    switch (sdl_ev->type)
     {
         case SDL_QUIT:
             ev->type = KEVENT_QUIT;
@@ -83,57 +80,89 @@ int kPollEvent(kEvent* ev)
 
         case SDL_KEYDOWN:
             ev->type = KEVENT_KEYDOWN;
-            ev->key.sym = translate_key(sdl_ev.key.keysym.sym);
-            ev->key.mod = translate_mod(sdl_ev.key.keysym.mod);
+            ev->key.sym = translate_key(sdl_ev->key.keysym.sym);
+            ev->key.mod = translate_mod(sdl_ev->key.keysym.mod);
             break;
 
         case SDL_KEYUP:
             ev->type = KEVENT_KEYUP;
-            ev->key.sym = translate_key(sdl_ev.key.keysym.sym);
-            ev->key.mod = translate_mod(sdl_ev.key.keysym.mod);
+            ev->key.sym = translate_key(sdl_ev->key.keysym.sym);
+            ev->key.mod = translate_mod(sdl_ev->key.keysym.mod);
             break;
 
         case SDL_MOUSEBUTTONDOWN:
             ev->type = KEVENT_MOUSEBUTTONDOWN;
-            ev->button.x = sdl_ev.button.x;
-            ev->button.y = sdl_ev.button.y;
-            ev->button.button = sdl_ev.button.button; // already matches
-            ev->button.clicks = sdl_ev.button.clicks;
+            ev->button.x = sdl_ev->button.x;
+            ev->button.y = sdl_ev->button.y;
+            ev->button.button = sdl_ev->button.button; // already matches
+            ev->button.clicks = sdl_ev->button.clicks;
             break;
 
         case SDL_MOUSEBUTTONUP:
             ev->type = KEVENT_MOUSEBUTTONUP;
-            ev->button.x = sdl_ev.button.x;
-            ev->button.y = sdl_ev.button.y;
-            ev->button.button = sdl_ev.button.button;
+            ev->button.x = sdl_ev->button.x;
+            ev->button.y = sdl_ev->button.y;
+            ev->button.button = sdl_ev->button.button;
             break;
 
         case SDL_MOUSEMOTION:
             ev->type = KEVENT_MOUSEMOTION;
-            ev->motion.x = sdl_ev.motion.x;
-            ev->motion.y = sdl_ev.motion.y;
-            ev->motion.dx = sdl_ev.motion.xrel;
-            ev->motion.dy = sdl_ev.motion.yrel;
+            ev->motion.x = sdl_ev->motion.x;
+            ev->motion.y = sdl_ev->motion.y;
+            ev->motion.dx = sdl_ev->motion.xrel;
+            ev->motion.dy = sdl_ev->motion.yrel;
             break;
 
         case SDL_MOUSEWHEEL:
             ev->type = KEVENT_MOUSEWHEEL;
-            ev->wheel.x = sdl_ev.wheel.x;
-            ev->wheel.y = sdl_ev.wheel.y;
+            ev->wheel.x = sdl_ev->wheel.x;
+            ev->wheel.y = sdl_ev->wheel.y;
             ev->wheel.mod = translate_mod(SDL_GetModState());
             break;
 
         case SDL_TEXTINPUT:
             ev->type = KEVENT_TEXTINPUT;
-            size_t len = strlen(sdl_ev.text.text);
+            size_t len = strlen(sdl_ev->text.text);
             size_t copy_len = (len < KTEXTINPUTEVENT_TEXT_SIZE - 1) ? len : KTEXTINPUTEVENT_TEXT_SIZE;
-            memcpy(ev->text.text, sdl_ev.text.text, copy_len);
+            memcpy(ev->text.text, sdl_ev->text.text, copy_len);
             ev->text.text[copy_len] = '\0';
             break;
 
+        case SDL_WINDOWEVENT:
+            ev->type = KEVENT_WINDOW;
+            break;
+
+        case SDL_RENDER_TARGETS_RESET:
+            ev->type = KEVENT_RENDER_RESET;
+            ev->reset.device_lost = 0;
+            break;
+
+        case SDL_RENDER_DEVICE_RESET:
+            ev->type = KEVENT_RENDER_RESET;
+            ev->reset.device_lost = 1;
+            break;
+
         default:
             ev->type = KEVENT_NONE;
             break;
     }
+}
+
+int kPollEvent(kEvent* ev)
+{
+    SDL_Event sdl_ev;
+    if (!SDL_PollEvent(&sdl_ev)) return 0;
+
+    translate_event(&sdl_ev, ev);
+    return 1;
+}
+
+int kWaitEventTimeout(kEvent* ev, int timeout_ms)
+{
+    SDL_Event sdl_ev;
+    int got = timeout_ms < 0 ? SDL_WaitEvent(&sdl_ev) : SDL_WaitEventTimeout(&sdl_ev, timeout_ms);
+    if (!got) return 0;
+
+    translate_event(&sdl_ev, ev);
     return 1;
 }
\ No newline at end of file
@@ -0,0 +1,391 @@
+/*
+    Platform specific file handling (Win32 and POSIX).
+*/
+
+#include "kFile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/uio.h>
+    #include <errno.h>
+#endif
+
+#define KFILE_TEMP_SUFFIX ".ktmp"
+
+static bool writer_init_paths(kFileWriter* w, const char* path)
+{
+    size_t len = strlen(path);
+    w->path = malloc(len + 1);
+    w->temp_path = malloc(len + sizeof(KFILE_TEMP_SUFFIX));
+    w->written = 0;
+    if (!w->path || !w->temp_path)
+    {
+        free(w->path);
+        free(w->temp_path);
+        return false;
+    }
+
+    memcpy(w->path, path, len + 1);
+    memcpy(w->temp_path, path, len);
+    memcpy(w->temp_path + len, KFILE_TEMP_SUFFIX, sizeof(KFILE_TEMP_SUFFIX));
+    return true;
+}
+
+static void writer_free_paths(kFileWriter* w)
+{
+    free(w->path);
+    free(w->temp_path);
+    w->path = NULL;
+    w->temp_path = NULL;
+}
+
+#ifdef _WIN32
+
+bool kFileMap_open(kFileMap* map, const char* path)
+{
+    memset(map, 0, sizeof(*map));
+
+    // Allow the file to be renamed/replaced while mapped
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    if (size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    const char* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    map->data = data;
+    map->size = (size_t)size.QuadPart;
+    map->file = file;
+    map->mapping = mapping;
+    return true;
+}
+
+void kFileMap_close(kFileMap* map)
+{
+    if (map->data) UnmapViewOfFile(map->data);
+    if (map->mapping) CloseHandle(map->mapping);
+    if (map->file) CloseHandle(map->file);
+    memset(map, 0, sizeof(*map));
+}
+
+bool kFileWriter_open(kFileWriter* w, const char* path)
+{
+    if (!writer_init_paths(w, path)) return false;
+
+    w->file = CreateFileA(w->temp_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                          FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (w->file == INVALID_HANDLE_VALUE)
+    {
+        writer_free_paths(w);
+        return false;
+    }
+    return true;
+}
+
+bool kFileWriter_write(kFileWriter* w, const kFileSpan* spans, int count)
+{
+    // WriteFileGather needs unbuffered, page aligned I/O, so write spans one by one
+    for (int i = 0; i < count; i++)
+    {
+        const char* data = spans[i].data;
+        size_t remaining = spans[i].size;
+        while (remaining > 0)
+        {
+            DWORD chunk = remaining > 0x40000000 ? 0x40000000 : (DWORD)remaining;
+            DWORD done = 0;
+            if (!WriteFile(w->file, data, chunk, &done, NULL) || done == 0) return false;
+
+            data += done;
+            remaining -= done;
+            w->written += done;
+        }
+    }
+    return true;
+}
+
+bool kFileWriter_flush(kFileWriter* w)
+{
+    return FlushFileBuffers(w->file) != 0;
+}
+
+bool kFileWriter_commit(kFileWriter* w)
+{
+    bool ok = FlushFileBuffers(w->file) != 0;
+    ok = CloseHandle(w->file) != 0 && ok;
+    ok = ok && MoveFileExA(w->temp_path, w->path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+
+    if (!ok) DeleteFileA(w->temp_path);
+    writer_free_paths(w);
+    return ok;
+}
+
+void kFileWriter_abort(kFileWriter* w)
+{
+    CloseHandle(w->file);
+    DeleteFileA(w->temp_path);
+    writer_free_paths(w);
+}
+
+bool kFileAppender_open(kFileAppender* a, const char* path)
+{
+    a->file = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS,
+                          FILE_ATTRIBUTE_NORMAL, NULL);
+    if (a->file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER zero = { 0 };
+    if (!SetFilePointerEx(a->file, zero, NULL, FILE_END))
+    {
+        CloseHandle(a->file);
+        return false;
+    }
+    return true;
+}
+
+bool kFileAppender_write(kFileAppender* a, const void* data, size_t size)
+{
+    const char* p = data;
+    while (size > 0)
+    {
+        DWORD chunk = size > 0x40000000 ? 0x40000000 : (DWORD)size;
+        DWORD done = 0;
+        if (!WriteFile(a->file, p, chunk, &done, NULL) || done == 0) return false;
+
+        p += done;
+        size -= done;
+    }
+    return true;
+}
+
+bool kFileAppender_truncate(kFileAppender* a, size_t size)
+{
+    LARGE_INTEGER position;
+    position.QuadPart = (LONGLONG)size;
+    return SetFilePointerEx(a->file, position, NULL, FILE_BEGIN) && SetEndOfFile(a->file);
+}
+
+bool kFileAppender_sync(kFileAppender* a)
+{
+    return FlushFileBuffers(a->file) != 0;
+}
+
+void kFileAppender_close(kFileAppender* a)
+{
+    CloseHandle(a->file);
+    a->file = NULL;
+}
+
+#else
+
+bool kFileMap_open(kFileMap* map, const char* path)
+{
+    memset(map, 0, sizeof(*map));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        close(fd);
+        return false;
+    }
+
+    if (st.st_size == 0)
+    {
+        close(fd);
+        return true;
+    }
+
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file referenced
+    if (data == MAP_FAILED) return false;
+
+    map->data = data;
+    map->size = (size_t)st.st_size;
+    return true;
+}
+
+void kFileMap_close(kFileMap* map)
+{
+    if (map->data) munmap((void*)map->data, map->size);
+    memset(map, 0, sizeof(*map));
+}
+
+bool kFileWriter_open(kFileWriter* w, const char* path)
+{
+    if (!writer_init_paths(w, path)) return false;
+
+    // Keep the permissions of the file being replaced
+    mode_t mode = 0666;
+    struct stat st;
+    if (stat(path, &st) == 0) mode = st.st_mode & 07777;
+
+    w->fd = open(w->temp_path, O_WRONLY | O_CREAT | O_TRUNC, mode);
+    if (w->fd < 0)
+    {
+        writer_free_paths(w);
+        return false;
+    }
+    fchmod(w->fd, mode); // Not subject to umask
+    return true;
+}
+
+bool kFileWriter_write(kFileWriter* w, const kFileSpan* spans, int count)
+{
+    struct iovec iov[KFILE_MAX_SPANS];
+    int n = 0;
+    for (int i = 0; i < count && n < KFILE_MAX_SPANS; i++)
+    {
+        if (spans[i].size == 0) continue;
+        iov[n].iov_base = (void*)spans[i].data;
+        iov[n].iov_len = spans[i].size;
+        n++;
+    }
+
+    // One writev per batch, resuming after partial writes
+    struct iovec* next = iov;
+    while (n > 0)
+    {
+        ssize_t done = writev(w->fd, next, n);
+        if (done < 0)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        w->written += (size_t)done;
+
+        while (n > 0 && (size_t)done >= next->iov_len)
+        {
+            done -= next->iov_len;
+            next++;
+            n--;
+        }
+        if (n > 0)
+        {
+            next->iov_base = (char*)next->iov_base + done;
+            next->iov_len -= done;
+        }
+    }
+    return true;
+}
+
+bool kFileWriter_flush(kFileWriter* w)
+{
+    return fsync(w->fd) == 0;
+}
+
+bool kFileWriter_commit(kFileWriter* w)
+{
+    bool ok = fsync(w->fd) == 0;
+    ok = close(w->fd) == 0 && ok;
+    ok = ok && rename(w->temp_path, w->path) == 0;
+
+    if (ok)
+    {
+        // Make the rename itself durable
+        char* slash = strrchr(w->path, '/');
+        if (slash) *slash = '\0';
+        int dir = open(slash ? (slash == w->path ? "/" : w->path) : ".", O_RDONLY);
+        if (dir >= 0)
+        {
+            fsync(dir);
+            close(dir);
+        }
+    }
+    else
+    {
+        unlink(w->temp_path);
+    }
+
+    writer_free_paths(w);
+    return ok;
+}
+
+void kFileWriter_abort(kFileWriter* w)
+{
+    close(w->fd);
+    unlink(w->temp_path);
+    writer_free_paths(w);
+}
+
+bool kFileAppender_open(kFileAppender* a, const char* path)
+{
+    // The file holds unsaved text, keep it private
+    a->fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0600);
+    return a->fd >= 0;
+}
+
+bool kFileAppender_write(kFileAppender* a, const void* data, size_t size)
+{
+    const char* p = data;
+    while (size > 0)
+    {
+        ssize_t done = write(a->fd, p, size);
+        if (done < 0)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        p += done;
+        size -= (size_t)done;
+    }
+    return true;
+}
+
+bool kFileAppender_truncate(kFileAppender* a, size_t size)
+{
+    // O_APPEND moves every write to the new end
+    return ftruncate(a->fd, (off_t)size) == 0;
+}
+
+bool kFileAppender_sync(kFileAppender* a)
+{
+#ifdef __linux__
+    return fdatasync(a->fd) == 0; // The file's metadata is not needed to read it back
+#else
+    return fsync(a->fd) == 0;
+#endif
+}
+
+void kFileAppender_close(kFileAppender* a)
+{
+    close(a->fd);
+    a->fd = -1;
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include "kFileDialog.h"
+#include <stdlib.h> // used for _fullpath / realpath
 #include <string.h>
 #include <dirent.h>
 #include <sys/stat.h>
@@ -45,7 +46,11 @@ static void load_directory(kFileDialog* dialog, const char* path)
 
     // Resolve absolute path
     char abs_path[PATH_MAX];
+#ifdef _WIN32
     if(_fullpath(abs_path, path, PATH_MAX) != NULL)
+#else
+    if(realpath(path, abs_path) != NULL)
+#endif
     {
         strncpy(dialog->current_path, abs_path, sizeof(dialog->current_path) - 1);
         dialog->current_path[sizeof(dialog->current_path) - 1] = '\0';
@@ -80,6 +85,7 @@ void kFileDialog_init(kFileDialog* dialog, const char* start_path, int x, int y,
     dialog->y = y;
     dialog->w = width;
     dialog->h = height;
+    dialog->font = font_manager_load(FONT_DEFAULT_PATH, 14);
     load_directory(dialog, start_path);
 }
 
@@ -139,9 +145,9 @@ static void kFileDialog_clamp_scroll(kFileDialog* dialog)
     }
 }
 
-void kFileDialog_handle_event(kFileDialog* dialog, kEvent* event)
+bool kFileDialog_handle_event(kFileDialog* dialog, kEvent* event)
 {
-    if (!dialog->is_open) return;
+    if (!dialog->is_open) return false;
 
     if (event->type == KEVENT_MOUSEBUTTONDOWN && event->button.button == KMOUSEBUTTON_LEFT)
     {
@@ -154,7 +160,7 @@ void kFileDialog_handle_event(kFileDialog* dialog, kEvent* event)
         // Check if click is within dialog
         if ((mx < dialog->x || mx > dialog->x + dialog->w) || (my < dialog->y + FILE_DIALOG_INFOBAR_HEIGHT || my > dialog->y + dialog->h))
         {
-            return;
+            return false;
         }
 
         // Directly map y-coordinate to line index
@@ -178,6 +184,7 @@ void kFileDialog_handle_event(kFileDialog* dialog, kEvent* event)
                     set_selected_file(dialog);
                 }
             }
+            return true;
         }
     }
     else if (event->type == KEVENT_KEYDOWN)
@@ -219,13 +226,17 @@ void kFileDialog_handle_event(kFileDialog* dialog, kEvent* event)
 
         kFileDialog_ensure_selection_visible(dialog);
         kFileDialog_clamp_scroll(dialog);
+        return true;
     }
     else if (event->type == KEVENT_MOUSEWHEEL)
     {
+        int old_offset = dialog->scroll_offset;
         dialog->scroll_offset -= event->wheel.y * (FILE_DIALOG_LINE_HEIGHT + FILE_DIALOG_PADDING);
 
         kFileDialog_clamp_scroll(dialog);
+        return dialog->scroll_offset != old_offset;
     }
+    return false;
 }
 
 void kFileDialog_render(kFileDialog* dialog, Renderer* renderer)
@@ -238,7 +249,7 @@ void kFileDialog_render(kFileDialog* dialog, Renderer* renderer)
     SDL_Color infobar_bg = {30, 30, 30, 255};
     renderer_draw_rect(renderer, dialog->x, 0, dialog->w, FILE_DIALOG_INFOBAR_HEIGHT, infobar_bg);
 
-    renderer_draw_text(renderer, dialog->current_path, 10, 5, font_manager_get_font("resources/fonts/SourceCodePro-Bold.ttf", 14), ALIGN_LEFT, COLOR_WHITE);
+    renderer_draw_text(renderer, dialog->current_path, 10, 5, font_manager_font(dialog->font), ALIGN_LEFT, COLOR_WHITE);
 
     for (int i = 0; i < dialog->num_entries; i++)
     {
@@ -253,7 +264,7 @@ void kFileDialog_render(kFileDialog* dialog, Renderer* renderer)
             renderer_draw_rect(renderer, dialog->x + FILE_DIALOG_PADDING, item_y, dialog->w - FILE_DIALOG_PADDING * 2, FILE_DIALOG_LINE_HEIGHT, highlight);
         }
         renderer_draw_text(renderer, dialog->entries[i], dialog->x + FILE_DIALOG_PADDING + 10, item_y + 5, 
-                           font_manager_get_font("resources/fonts/SourceCodePro-Bold.ttf", 14), 
+                           font_manager_font(dialog->font), 
                            ALIGN_LEFT, color);
     }
 }
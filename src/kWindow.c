@@ -1,6 +1,8 @@
 #include "kWindow.h"
 #include "font_manager.h"
 
+#include <string.h>
+
 static void close_button_clicked(kWindowButton* btn)
 {
     SDL_Event quit_event;
@@ -26,6 +28,8 @@ kWindow window_create(const char* title, int x, int y, int w, int h, Uint32 flag
     win.num_window_buttons = 0;
     win.capacity_window_buttons = 0;
 
+    ui_layer_init(&win.titlebar_layer);
+
     SDL_Color base_btn_color = {20, 20, 20, 255};
 
     // Create close button
@@ -63,8 +67,9 @@ void window_destroy(kWindow* win)
     }
 }
 
-void window_update(kWindow* win, float dt)
+bool window_update(kWindow* win, float dt)
 {
+    bool animated = false;
     for (size_t i = 0; i < win->num_window_buttons; i++)
     {
         kWindowButton* current_btn = &win->window_buttons[i];
@@ -72,18 +77,19 @@ void window_update(kWindow* win, float dt)
         if (current_btn->color_transition.active)
         {
             color_transition_update(&current_btn->color_transition, dt);
+            animated = true;
         }
     }
+    return animated;
 }
 
-void window_render(kWindow* win, Renderer* r)
+static void window_render_titlebar(kWindow* win, Renderer* r)
 {
-    // Titlebar
     SDL_Color titlebar_color = {10, 10, 10, 255};
     renderer_draw_rect(r, 0, 0, win->width, TITLEBAR_HEIGHT, titlebar_color);
 
     SDL_Color titlebar_title_color = {255, 255, 255, 255};
-    TTF_Font* title_font = font_manager_get_font("resources/fonts/SourceCodePro-Bold.ttf", 16);
+    TTF_Font* title_font = font_manager_get_font(FONT_DEFAULT_PATH, 16);
     renderer_draw_text(r, win->title, 10, TITLEBAR_HEIGHT / 2 - 10, title_font, ALIGN_LEFT, titlebar_title_color);
 
     for (size_t i = 0; i < win->num_window_buttons; i++)
@@ -104,6 +110,29 @@ void window_render(kWindow* win, Renderer* r)
     }
 }
 
+// Key of everything the titlebar shows
+static uint64_t window_titlebar_key(kWindow* win)
+{
+    uint64_t key = ui_layer_hash(UI_LAYER_HASH_SEED, win->title, strlen(win->title));
+    for (size_t i = 0; i < win->num_window_buttons; i++)
+    {
+        kWindowButton* current_btn = &win->window_buttons[i];
+        SDL_Color btn_color = color_transition_get(&current_btn->color_transition);
+        key = ui_layer_hash(key, &btn_color, sizeof(btn_color));
+        if (current_btn->text) key = ui_layer_hash(key, current_btn->text, strlen(current_btn->text));
+    }
+    return key;
+}
+
+void window_render(kWindow* win, Renderer* r)
+{
+    if (ui_layer_begin(&win->titlebar_layer, r, 0, 0, win->width, TITLEBAR_HEIGHT, window_titlebar_key(win)))
+    {
+        window_render_titlebar(win, r);
+    }
+    ui_layer_end(&win->titlebar_layer, r);
+}
+
 void window_add_button(kWindow* win, kWindowButton btn)
 {
     if (win->num_window_buttons >= win->capacity_window_buttons)
@@ -116,10 +145,15 @@ void window_add_button(kWindow* win, kWindowButton btn)
     win->window_buttons[win->num_window_buttons++] = btn;
 }
 
-void window_handle_event(kWindow* win, kEvent* e)
+bool window_handle_event(kWindow* win, kEvent* e)
 {
+    bool changed = false;
     switch (e->type)
     {
+        case KEVENT_WINDOW:
+            changed = true; // Shown, exposed, resized or focus changed
+            break;
+
         case KEVENT_MOUSEBUTTONDOWN:
             if (e->button.button == KMOUSEBUTTON_LEFT)
             {
@@ -135,6 +169,7 @@ void window_handle_event(kWindow* win, kEvent* e)
                     if (win->window_buttons[i].is_hovered && win->window_buttons[i].on_click)
                     {
                         win->window_buttons[i].on_click(&win->window_buttons[i]);
+                        changed = true;
                     }
                 }
 
@@ -187,16 +222,19 @@ void window_handle_event(kWindow* win, kEvent* e)
                     if (hovering && !win->window_buttons[i].is_hovered)
                     {
                         color_transition_start(&win->window_buttons[i].color_transition, true);
+                        changed = true;
                     }
                     else if (!hovering && win->window_buttons[i].is_hovered)
                     {
                         color_transition_start(&win->window_buttons[i].color_transition, false);
+                        changed = true;
                     }
                     win->window_buttons[i].is_hovered = hovering;
                 }
             }
             break;
     }
+    return changed;
 }
 
 void window_maximise(kWindow* win)
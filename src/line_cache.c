@@ -0,0 +1,209 @@
+#include "line_cache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define LINE_CACHE_MIN_BUCKETS 256
+
+static size_t entry_bytes(const LineCacheEntry* e)
+{
+    return (size_t)e->width * (size_t)e->height * 4;
+}
+
+static uint64_t key_hash(LineCacheKey key)
+{
+    uint64_t h = key.hash;
+    h ^= (uint64_t)(uintptr_t)key.font * 0x9E3779B97F4A7C15ull;
+    h ^= (uint64_t)key.color * 0xC2B2AE3D27D4EB4Full;
+    h ^= h >> 29;
+    return h;
+}
+
+static bool key_equal(LineCacheKey a, LineCacheKey b)
+{
+    return a.hash == b.hash && a.font == b.font && a.color == b.color;
+}
+
+static void lru_unlink(LineCache* c, int i)
+{
+    LineCacheEntry* e = &c->entries[i];
+    if (e->prev >= 0) c->entries[e->prev].next = e->next;
+    else c->lru_head = e->next;
+    if (e->next >= 0) c->entries[e->next].prev = e->prev;
+    else c->lru_tail = e->prev;
+    e->prev = e->next = -1;
+}
+
+static void lru_push_front(LineCache* c, int i)
+{
+    LineCacheEntry* e = &c->entries[i];
+    e->prev = -1;
+    e->next = c->lru_head;
+    if (c->lru_head >= 0) c->entries[c->lru_head].prev = i;
+    c->lru_head = i;
+    if (c->lru_tail < 0) c->lru_tail = i;
+}
+
+static void bucket_remove(LineCache* c, int i)
+{
+    int* link = &c->buckets[key_hash(c->entries[i].key) & (c->bucket_count - 1)];
+    while (*link >= 0 && *link != i) link = &c->entries[*link].chain;
+    if (*link == i) *link = c->entries[i].chain;
+}
+
+static void evict(LineCache* c, int i)
+{
+    LineCacheEntry* e = &c->entries[i];
+    bucket_remove(c, i);
+    lru_unlink(c, i);
+
+    c->bytes -= entry_bytes(e);
+    SDL_DestroyTexture(e->texture);
+    e->texture = NULL;
+
+    e->chain = c->free_list;
+    c->free_list = i;
+    c->evictions++;
+}
+
+static void evict_to_budget(LineCache* c, size_t incoming)
+{
+    while (c->lru_tail >= 0 && c->bytes + incoming > c->budget) evict(c, c->lru_tail);
+}
+
+static bool grow_buckets(LineCache* c)
+{
+    int count = c->bucket_count ? c->bucket_count * 2 : LINE_CACHE_MIN_BUCKETS;
+    int* buckets = malloc(count * sizeof(int));
+    if (!buckets) return false;
+
+    for (int i = 0; i < count; i++) buckets[i] = -1;
+
+    // Rehash live entries, found through the LRU list
+    for (int i = c->lru_head; i >= 0; i = c->entries[i].next)
+    {
+        int b = (int)(key_hash(c->entries[i].key) & (count - 1));
+        c->entries[i].chain = buckets[b];
+        buckets[b] = i;
+    }
+
+    free(c->buckets);
+    c->buckets = buckets;
+    c->bucket_count = count;
+    return true;
+}
+
+LineCache* line_cache_create(size_t budget)
+{
+    LineCache* c = calloc(1, sizeof(LineCache));
+    if (!c)
+    {
+        fprintf(stderr, "[line_cache] Failed to allocate LineCache.\n");
+        return NULL;
+    }
+
+    c->free_list = -1;
+    c->lru_head = -1;
+    c->lru_tail = -1;
+    c->budget = budget;
+
+    if (!grow_buckets(c))
+    {
+        free(c);
+        return NULL;
+    }
+    return c;
+}
+
+void line_cache_destroy(LineCache* c)
+{
+    if (!c) return;
+
+    printf("[line_cache] %zu hits, %zu misses, %zu evictions\n", c->hits, c->misses, c->evictions);
+
+    for (int i = c->lru_head; i >= 0; i = c->entries[i].next) SDL_DestroyTexture(c->entries[i].texture);
+    free(c->entries);
+    free(c->buckets);
+    free(c);
+}
+
+void line_cache_clear(LineCache* c)
+{
+    while (c->lru_tail >= 0) evict(c, c->lru_tail);
+}
+
+void line_cache_set_budget(LineCache* c, size_t budget)
+{
+    c->budget = budget;
+    evict_to_budget(c, 0);
+}
+
+LineCacheKey line_cache_key(uint64_t hash, TTF_Font* font, SDL_Color color)
+{
+    LineCacheKey key;
+    key.hash = hash;
+    key.font = font;
+    key.color = ((Uint32)color.r << 24) | ((Uint32)color.g << 16) | ((Uint32)color.b << 8) | color.a;
+    return key;
+}
+
+const LineCacheEntry* line_cache_find(LineCache* c, LineCacheKey key)
+{
+    int i = c->buckets[key_hash(key) & (c->bucket_count - 1)];
+    while (i >= 0 && !key_equal(c->entries[i].key, key)) i = c->entries[i].chain;
+
+    if (i < 0)
+    {
+        c->misses++;
+        return NULL;
+    }
+
+    c->hits++;
+    lru_unlink(c, i);
+    lru_push_front(c, i);
+    return &c->entries[i];
+}
+
+const LineCacheEntry* line_cache_insert(LineCache* c, LineCacheKey key, SDL_Texture* texture, int width, int height)
+{
+    size_t bytes = (size_t)width * (size_t)height * 4;
+    evict_to_budget(c, bytes);
+
+    int i = c->free_list;
+    if (i >= 0)
+    {
+        c->free_list = c->entries[i].chain;
+    }
+    else
+    {
+        if (c->entry_count == c->entry_capacity)
+        {
+            int new_capacity = c->entry_capacity ? c->entry_capacity * 2 : 256;
+            LineCacheEntry* entries = realloc(c->entries, new_capacity * sizeof(LineCacheEntry));
+            if (!entries)
+            {
+                SDL_DestroyTexture(texture);
+                return NULL;
+            }
+            c->entries = entries;
+            c->entry_capacity = new_capacity;
+        }
+        i = c->entry_count++;
+    }
+
+    // Keep chains short, at most one entry per bucket on average
+    if (c->entry_count > c->bucket_count) grow_buckets(c);
+
+    LineCacheEntry* e = &c->entries[i];
+    e->key = key;
+    e->texture = texture;
+    e->width = width;
+    e->height = height;
+    c->bytes += bytes;
+
+    int b = (int)(key_hash(key) & (c->bucket_count - 1));
+    e->chain = c->buckets[b];
+    c->buckets[b] = i;
+    lru_push_front(c, i);
+    return e;
+}
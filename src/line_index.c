@@ -0,0 +1,527 @@
+#include "line_index.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+// ----------------------------------------------------------------
+// Block treap
+// ----------------------------------------------------------------
+
+static unsigned int next_priority(LineIndex* li)
+{
+    // xorshift32
+    unsigned int x = li->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    li->seed = x;
+    return x;
+}
+
+static size_t block_lines(LineBlock* b)
+{
+    return b ? b->total_lines : 0;
+}
+
+static size_t block_bytes(LineBlock* b)
+{
+    return b ? b->total_bytes : 0;
+}
+
+static uint64_t block_hash(LineBlock* b)
+{
+    return b ? b->total_hash : 0;
+}
+
+static uint64_t block_power(LineBlock* b)
+{
+    return b ? b->total_power : 1;
+}
+
+static void block_update(LineBlock* b)
+{
+    b->total_lines = block_lines(b->left) + b->count + block_lines(b->right);
+    b->total_bytes = block_bytes(b->left) + b->bytes + block_bytes(b->right);
+
+    // hash(left, block, right) = (hash(left) * L^count + hash(block)) * L^lines(right) + hash(right)
+    uint64_t right_power = block_power(b->right);
+    b->total_hash = (block_hash(b->left) * b->power + b->hash) * right_power + block_hash(b->right);
+    b->total_power = block_power(b->left) * b->power * right_power;
+}
+
+// Recomputes a block's own hash after its lines changed
+static void block_rehash(LineBlock* b)
+{
+    uint64_t hash = 0;
+    uint64_t power = 1;
+    for (uint32_t i = 0; i < b->count; i++)
+    {
+        hash = hash * LINE_INDEX_HASH_LINE + b->hashes[i];
+        power *= LINE_INDEX_HASH_LINE;
+    }
+    b->hash = hash;
+    b->power = power;
+}
+
+static LineBlock* block_new(LineIndex* li)
+{
+    LineBlock* b = pool_alloc(&li->blocks);
+    if (!b)
+    {
+        fprintf(stderr, "[line_index] Failed to allocate block.\n");
+        return NULL;
+    }
+
+    b->left = NULL;
+    b->right = NULL;
+    b->priority = next_priority(li);
+    b->count = 0;
+    b->bytes = 0;
+    b->hash = 0;
+    b->power = 1;
+    b->total_lines = 0;
+    b->total_bytes = 0;
+    b->total_hash = 0;
+    b->total_power = 1;
+
+    return b;
+}
+
+static void block_free(LineIndex* li, LineBlock* b)
+{
+    pool_free(&li->blocks, b);
+}
+
+static LineBlock* block_merge(LineBlock* a, LineBlock* b)
+{
+    if (!a) return b;
+    if (!b) return a;
+
+    if (a->priority > b->priority)
+    {
+        a->right = block_merge(a->right, b);
+        block_update(a);
+        return a;
+    }
+
+    b->left = block_merge(a, b->left);
+    block_update(b);
+    return b;
+}
+
+// Splits a subtree after the given number of lines, which must fall on a block boundary
+static void block_split(LineBlock* b, size_t lines, LineBlock** l, LineBlock** r)
+{
+    if (!b)
+    {
+        *l = NULL;
+        *r = NULL;
+        return;
+    }
+
+    size_t left_lines = block_lines(b->left);
+    if (lines <= left_lines)
+    {
+        block_split(b->left, lines, l, &b->left);
+        block_update(b);
+        *r = b;
+    }
+    else
+    {
+        block_split(b->right, lines - left_lines - b->count, &b->right, r);
+        block_update(b);
+        *l = b;
+    }
+}
+
+// Finds the block holding a line. On return *line is the index within the block,
+// and first_line/first_offset describe where the block begins in the document.
+static LineBlock* block_locate(LineBlock* b, size_t* line, size_t* first_line, size_t* first_offset)
+{
+    size_t base_line = 0;
+    size_t base_offset = 0;
+
+    while (b)
+    {
+        size_t left_lines = block_lines(b->left);
+        if (*line < left_lines)
+        {
+            b = b->left;
+        }
+        else if (*line < left_lines + b->count)
+        {
+            *line -= left_lines;
+            base_line += left_lines;
+            base_offset += block_bytes(b->left);
+            break;
+        }
+        else
+        {
+            *line -= left_lines + b->count;
+            base_line += left_lines + b->count;
+            base_offset += block_bytes(b->left) + b->bytes;
+            b = b->right;
+        }
+    }
+
+    if (first_line) *first_line = base_line;
+    if (first_offset) *first_offset = base_offset;
+    return b;
+}
+
+// ----------------------------------------------------------------
+// Block builder, packs a sequence of lines into blocks
+// ----------------------------------------------------------------
+
+typedef struct {
+    LineIndex* li;
+    LineBlock* root;        // Completed blocks
+    LineBlock* current;     // Block being filled
+    size_t remaining;       // Lines still to be pushed, 0 if not known
+    size_t target;          // Lines the current block is filled to
+} BlockBuilder;
+
+static void builder_flush(BlockBuilder* bb)
+{
+    if (!bb->current) return;
+
+    block_rehash(bb->current);
+    block_update(bb->current);
+    bb->root = block_merge(bb->root, bb->current);
+    bb->current = NULL;
+}
+
+static void builder_push(BlockBuilder* bb, uint32_t length, uint64_t hash)
+{
+    if (!bb->current || bb->current->count == bb->target)
+    {
+        builder_flush(bb);
+        bb->current = block_new(bb->li);
+        if (!bb->current) return;
+
+        // When the number of lines is known, share them evenly between the
+        // blocks still needed instead of leaving a nearly empty last one
+        bb->target = LINE_INDEX_BLOCK_SIZE;
+        if (bb->remaining > 0)
+        {
+            size_t blocks = (bb->remaining + LINE_INDEX_BLOCK_SIZE - 1) / LINE_INDEX_BLOCK_SIZE;
+            bb->target = (bb->remaining + blocks - 1) / blocks;
+        }
+    }
+    if (bb->remaining > 0) bb->remaining--;
+
+    bb->current->lengths[bb->current->count] = length;
+    bb->current->hashes[bb->current->count] = hash;
+    bb->current->count++;
+    bb->current->bytes += length;
+}
+
+typedef struct {
+    BlockBuilder* builder;
+    size_t next_line;       // Document line of the next visited entry
+    size_t line;            // First replaced line
+    size_t remove_count;
+    const uint32_t* lengths;
+    const uint64_t* hashes;
+    size_t insert_count;
+    bool inserted;
+} SpliceState;
+
+static void splice_insert(SpliceState* s)
+{
+    if (s->inserted) return;
+
+    for (size_t i = 0; i < s->insert_count; i++)
+    {
+        builder_push(s->builder, s->lengths[i], s->hashes ? s->hashes[i] : 0);
+    }
+    s->inserted = true;
+}
+
+// Feeds the lines of a detached subtree through the splice and frees its blocks
+static void splice_visit(LineIndex* li, LineBlock* b, SpliceState* s)
+{
+    if (!b) return;
+
+    splice_visit(li, b->left, s);
+
+    for (uint32_t i = 0; i < b->count; i++, s->next_line++)
+    {
+        if (s->next_line == s->line) splice_insert(s);
+
+        bool removed = s->next_line >= s->line && s->next_line < s->line + s->remove_count;
+        if (!removed) builder_push(s->builder, b->lengths[i], b->hashes[i]);
+    }
+
+    LineBlock* right = b->right;
+    block_free(li, b);
+    splice_visit(li, right, s);
+}
+
+// ----------------------------------------------------------------
+// Public API
+// ----------------------------------------------------------------
+
+void line_index_init(LineIndex* li)
+{
+    li->root = NULL;
+    li->seed = 0x2545F491u;
+    pool_init(&li->blocks, sizeof(LineBlock));
+
+    line_index_build(li, NULL, 0);
+}
+
+void line_index_destroy(LineIndex* li)
+{
+    pool_destroy(&li->blocks);
+    li->root = NULL;
+}
+
+void line_index_build(LineIndex* li, const char* text, size_t length)
+{
+    // Drop every block at once
+    pool_destroy(&li->blocks);
+    pool_init(&li->blocks, sizeof(LineBlock));
+    li->root = NULL;
+
+    BlockBuilder bb = { li, NULL, NULL, 0, 0 };
+
+    const char* line = text;
+    const char* end = text + length;
+    const char* newline;
+    while (line < end && (newline = memchr(line, '\n', end - line)) != NULL)
+    {
+        size_t n = newline + 1 - line;
+        builder_push(&bb, (uint32_t)n, line_index_hash_bytes(0, line, n));
+        line = newline + 1;
+    }
+
+    // Last line has no terminator (and may be empty)
+    builder_push(&bb, (uint32_t)(end - line), line_index_hash_bytes(0, line, end - line));
+    builder_flush(&bb);
+
+    li->root = bb.root;
+}
+
+uint64_t line_index_hash_bytes(uint64_t hash, const char* data, size_t length)
+{
+    static const uint64_t Q1 = LINE_INDEX_HASH_BYTE;
+    static const uint64_t Q2 = LINE_INDEX_HASH_BYTE * LINE_INDEX_HASH_BYTE;
+    static const uint64_t Q3 = LINE_INDEX_HASH_BYTE * LINE_INDEX_HASH_BYTE * LINE_INDEX_HASH_BYTE;
+    static const uint64_t Q4 = LINE_INDEX_HASH_BYTE * LINE_INDEX_HASH_BYTE *
+                               LINE_INDEX_HASH_BYTE * LINE_INDEX_HASH_BYTE;
+
+    // hash = hash * Q + (byte + 1) for every byte, four bytes per step to
+    // shorten the multiply chain
+    const unsigned char* p = (const unsigned char*)data;
+    size_t i = 0;
+    for (; i + 4 <= length; i += 4)
+    {
+        hash = hash * Q4 + (p[i] + 1u) * Q3 + (p[i + 1] + 1u) * Q2 +
+               (p[i + 2] + 1u) * Q1 + (p[i + 3] + 1u);
+    }
+    for (; i < length; i++)
+    {
+        hash = hash * Q1 + (p[i] + 1u);
+    }
+    return hash;
+}
+
+uint64_t line_index_hash(LineIndex* li)
+{
+    return block_hash(li->root);
+}
+
+uint64_t line_index_line_hash(LineIndex* li, size_t line)
+{
+    if (line >= line_index_count(li)) return 0;
+
+    LineBlock* b = block_locate(li->root, &line, NULL, NULL);
+    return b->hashes[line];
+}
+
+// Sets a line's hash and updates the combined hashes on the way back up
+static void block_set_hash(LineBlock* b, size_t line, uint64_t hash)
+{
+    size_t left_lines = block_lines(b->left);
+    if (line < left_lines)
+    {
+        block_set_hash(b->left, line, hash);
+    }
+    else if (line < left_lines + b->count)
+    {
+        b->hashes[line - left_lines] = hash;
+        block_rehash(b);
+    }
+    else
+    {
+        block_set_hash(b->right, line - left_lines - b->count, hash);
+    }
+    block_update(b);
+}
+
+void line_index_set_hash(LineIndex* li, size_t line, uint64_t hash)
+{
+    if (line >= line_index_count(li)) return;
+    block_set_hash(li->root, line, hash);
+}
+
+size_t line_index_count(LineIndex* li)
+{
+    return block_lines(li->root);
+}
+
+size_t line_index_bytes(LineIndex* li)
+{
+    return block_bytes(li->root);
+}
+
+size_t line_index_start(LineIndex* li, size_t line)
+{
+    if (line >= line_index_count(li)) return line_index_bytes(li);
+
+    size_t offset;
+    LineBlock* b = block_locate(li->root, &line, NULL, &offset);
+
+    for (size_t i = 0; i < line; i++)
+    {
+        offset += b->lengths[i];
+    }
+    return offset;
+}
+
+size_t line_index_length(LineIndex* li, size_t line)
+{
+    if (line >= line_index_count(li)) return 0;
+
+    LineBlock* b = block_locate(li->root, &line, NULL, NULL);
+    return b->lengths[line];
+}
+
+size_t line_index_find(LineIndex* li, size_t offset)
+{
+    LineBlock* b = li->root;
+    size_t line = 0;
+
+    while (b)
+    {
+        size_t left_bytes = block_bytes(b->left);
+        if (offset < left_bytes)
+        {
+            b = b->left;
+        }
+        else if (offset < left_bytes + b->bytes)
+        {
+            offset -= left_bytes;
+            line += block_lines(b->left);
+
+            for (uint32_t i = 0; i < b->count; i++)
+            {
+                if (offset < b->lengths[i]) return line + i;
+                offset -= b->lengths[i];
+            }
+            break;
+        }
+        else
+        {
+            offset -= left_bytes + b->bytes;
+            line += block_lines(b->left) + b->count;
+            b = b->right;
+        }
+    }
+
+    // At or past the end of the document
+    return line_index_count(li) - 1;
+}
+
+void line_index_resize(LineIndex* li, size_t line, ptrdiff_t delta)
+{
+    if (line >= line_index_count(li)) return;
+
+    // Walk down to the block, adjusting byte totals on the way
+    LineBlock* b = li->root;
+    while (b)
+    {
+        b->total_bytes += delta;
+
+        size_t left_lines = block_lines(b->left);
+        if (line < left_lines)
+        {
+            b = b->left;
+        }
+        else if (line < left_lines + b->count)
+        {
+            line -= left_lines;
+            b->lengths[line] += delta;
+            b->bytes += delta;
+            return;
+        }
+        else
+        {
+            line -= left_lines + b->count;
+            b = b->right;
+        }
+    }
+}
+
+void line_index_splice(LineIndex* li, size_t line, size_t remove_count,
+                       const uint32_t* lengths, const uint64_t* hashes, size_t insert_count)
+{
+    size_t count = line_index_count(li);
+    if (line > count) line = count;
+    if (remove_count > count - line) remove_count = count - line;
+
+    // Detach the run of blocks covering the affected lines
+    size_t first = line < count ? line : count - 1;
+    size_t last = remove_count > 0 ? line + remove_count - 1 : first;
+
+    size_t first_block_line;
+    size_t last_block_line;
+    size_t local = first;
+    block_locate(li->root, &local, &first_block_line, NULL);
+    local = last;
+    LineBlock* last_block = block_locate(li->root, &local, &last_block_line, NULL);
+    size_t end_line = last_block_line + last_block->count;
+
+    // Take in neighbouring blocks until the repacked lines fill at least one
+    // block to LINE_INDEX_BLOCK_MIN, so edits cannot leave a trail of small blocks
+    size_t repacked = end_line - first_block_line - remove_count + insert_count;
+    while (repacked < LINE_INDEX_BLOCK_MIN)
+    {
+        if (end_line < count)
+        {
+            local = end_line;
+            LineBlock* next = block_locate(li->root, &local, NULL, NULL);
+            end_line += next->count;
+            repacked += next->count;
+        }
+        else if (first_block_line > 0)
+        {
+            local = first_block_line - 1;
+            LineBlock* previous = block_locate(li->root, &local, &first_block_line, NULL);
+            repacked += previous->count;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    LineBlock* before;
+    LineBlock* middle;
+    LineBlock* after;
+    block_split(li->root, first_block_line, &before, &middle);
+    block_split(middle, end_line - first_block_line, &middle, &after);
+
+    // Repack the detached lines with the replacement applied
+    BlockBuilder bb = { li, NULL, NULL, repacked, 0 };
+    SpliceState s = { &bb, first_block_line, line, remove_count, lengths, hashes, insert_count, false };
+    splice_visit(li, middle, &s);
+    splice_insert(&s); // Inserting after the last line
+    builder_flush(&bb);
+
+    li->root = block_merge(block_merge(before, bb.root), after);
+
+    // Always keep at least one line
+    if (!li->root) line_index_build(li, NULL, 0);
+}
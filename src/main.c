@@ -1,11 +1,47 @@
 #include "app.h"
 
-int SDL_main(int argc, char* argv[])
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Reads command line options:
+ *     [--headless] [--frames N] [--dump DIR] [--scroll] [FILE]
+ *
+ * @return Whether every option was understood
+ */
+static bool parse_options(int argc, char* argv[], AppOptions* options)
 {
+    memset(options, 0, sizeof(AppOptions));
+    options->file = "test.txt";
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--headless") == 0) options->headless = true;
+        else if (strcmp(argv[i], "--scroll") == 0) options->scroll = true;
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) options->frames = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc) options->dump_dir = argv[++i];
+        else if (argv[i][0] != '-') options->file = argv[i];
+        else return false;
+    }
+    return true;
+}
+
+// SDL renames main to SDL_main where it provides the entry point itself
+int main(int argc, char* argv[])
+{
+    AppOptions options;
+    if (!parse_options(argc, argv, &options))
+    {
+        fprintf(stderr, "Usage: %s [--headless] [--frames N] [--dump DIR] [--scroll] [FILE]\n", argv[0]);
+        return -1;
+    }
+
     App app;
-    if (!app_init(&app)) return -1;
+    if (!app_init(&app, &options)) return -1;
 
     app_run(&app);
 
     app_cleanup(&app);
-}
\ No newline at end of file
+    return 0;
+}
@@ -0,0 +1,217 @@
+#include "raster_pool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+// The worker's copy of a font, opening it if needed
+static TTF_Font* worker_font(RasterWorker* w, const FontSource* source)
+{
+    for (int i = 0; i < w->font_count; i++)
+    {
+        if (w->fonts[i].path == source->path && w->fonts[i].size == source->size) return w->fonts[i].font;
+    }
+
+    TTF_Font* font = font_manager_open_source(source);
+    if (!font) return NULL;
+
+    RasterFont* slot;
+    if (w->font_count < RASTER_POOL_FONTS)
+    {
+        slot = &w->fonts[w->font_count++];
+    }
+    else
+    {
+        slot = &w->fonts[w->next_evict];
+        w->next_evict = (w->next_evict + 1) % RASTER_POOL_FONTS;
+        font_manager_close_font(slot->font);
+    }
+    slot->path = source->path;
+    slot->size = source->size;
+    slot->font = font;
+    return font;
+}
+
+static void rasterize(RasterWorker* w, RasterJob* job)
+{
+    TTF_Font* font = worker_font(w, &job->source);
+    if (!font) return;
+
+    SDL_Color white = { 255, 255, 255, 255 };
+    SDL_Surface* surface = TTF_RenderGlyph32_Blended(font, job->ch, white);
+    if (surface && surface->format->format != SDL_PIXELFORMAT_ARGB8888)
+    {
+        SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+        SDL_FreeSurface(surface);
+        surface = converted;
+    }
+    job->surface = surface;
+}
+
+// Pushes a finished job, the UI thread may be taking the stack at the same time
+static void push_finished(RasterPool* pool, RasterJob* job)
+{
+    void* head;
+    do
+    {
+        head = SDL_AtomicGetPtr(&pool->finished);
+        job->next = head;
+    } while (!SDL_AtomicCASPtr(&pool->finished, head, job));
+}
+
+static int raster_pool_worker(void* user)
+{
+    RasterWorker* w = user;
+    RasterPool* pool = w->pool;
+
+    SDL_LockMutex(pool->lock);
+    for (;;)
+    {
+        while (!pool->stop && !pool->queue_head) SDL_CondWait(pool->wake, pool->lock);
+        if (pool->stop) break;
+
+        RasterJob* job = pool->queue_head;
+        pool->queue_head = job->next;
+        if (!pool->queue_head) pool->queue_tail = NULL;
+        SDL_UnlockMutex(pool->lock);
+
+        rasterize(w, job);
+        push_finished(pool, job);
+
+        SDL_LockMutex(pool->lock);
+    }
+    SDL_UnlockMutex(pool->lock);
+
+    for (int i = 0; i < w->font_count; i++) font_manager_close_font(w->fonts[i].font);
+    w->font_count = 0;
+    return 0;
+}
+
+static void free_jobs(RasterJob* job)
+{
+    while (job)
+    {
+        RasterJob* next = job->next;
+        raster_pool_release(job);
+        job = next;
+    }
+}
+
+RasterPool* raster_pool_create(int workers)
+{
+    if (workers <= 0) workers = SDL_GetCPUCount() - 1; // The UI thread keeps a core
+    if (workers < 1) workers = 1;
+    if (workers > RASTER_POOL_MAX_WORKERS) workers = RASTER_POOL_MAX_WORKERS;
+
+    RasterPool* pool = calloc(1, sizeof(RasterPool));
+    if (!pool)
+    {
+        fprintf(stderr, "[raster_pool] Failed to allocate RasterPool.\n");
+        return NULL;
+    }
+
+    pool->lock = SDL_CreateMutex();
+    pool->wake = SDL_CreateCond();
+    if (!pool->lock || !pool->wake)
+    {
+        fprintf(stderr, "[raster_pool] Failed to create lock: %s\n", SDL_GetError());
+        raster_pool_destroy(pool);
+        return NULL;
+    }
+
+    for (int i = 0; i < workers; i++)
+    {
+        RasterWorker* w = &pool->workers[pool->worker_count];
+        w->pool = pool;
+        w->thread = SDL_CreateThread(raster_pool_worker, "raster_pool", w);
+        if (!w->thread)
+        {
+            fprintf(stderr, "[raster_pool] Failed to create thread: %s\n", SDL_GetError());
+            break;
+        }
+        pool->worker_count++;
+    }
+
+    if (pool->worker_count == 0)
+    {
+        raster_pool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void raster_pool_destroy(RasterPool* pool)
+{
+    if (!pool) return;
+
+    if (pool->worker_count > 0)
+    {
+        SDL_LockMutex(pool->lock);
+        pool->stop = true;
+        SDL_CondBroadcast(pool->wake);
+        SDL_UnlockMutex(pool->lock);
+        for (int i = 0; i < pool->worker_count; i++) SDL_WaitThread(pool->workers[i].thread, NULL);
+    }
+
+    free_jobs(pool->queue_head);
+    free_jobs(SDL_AtomicSetPtr(&pool->finished, NULL));
+    free_jobs(pool->taken);
+
+    if (pool->wake) SDL_DestroyCond(pool->wake);
+    if (pool->lock) SDL_DestroyMutex(pool->lock);
+    free(pool);
+}
+
+bool raster_pool_submit(RasterPool* pool, void* owner, const FontSource* source, Uint32 ch)
+{
+    RasterJob* job = calloc(1, sizeof(RasterJob));
+    if (!job) return false;
+
+    job->owner = owner;
+    job->source = *source;
+    job->ch = ch;
+
+    SDL_LockMutex(pool->lock);
+    if (pool->queue_tail) pool->queue_tail->next = job;
+    else pool->queue_head = job;
+    pool->queue_tail = job;
+    SDL_AtomicAdd(&pool->outstanding, 1);
+    SDL_CondSignal(pool->wake);
+    SDL_UnlockMutex(pool->lock);
+    return true;
+}
+
+RasterJob* raster_pool_take(RasterPool* pool)
+{
+    if (!pool->taken)
+    {
+        // Take the whole stack at once and put it back in finishing order
+        RasterJob* job = SDL_AtomicSetPtr(&pool->finished, NULL);
+        while (job)
+        {
+            RasterJob* next = job->next;
+            job->next = pool->taken;
+            pool->taken = job;
+            job = next;
+        }
+        if (!pool->taken) return NULL;
+    }
+
+    RasterJob* job = pool->taken;
+    pool->taken = job->next;
+    job->next = NULL;
+    SDL_AtomicAdd(&pool->outstanding, -1);
+    return job;
+}
+
+void raster_pool_release(RasterJob* job)
+{
+    if (!job) return;
+
+    if (job->surface) SDL_FreeSurface(job->surface);
+    free(job);
+}
+
+int raster_pool_outstanding(RasterPool* pool)
+{
+    return pool ? SDL_AtomicGet(&pool->outstanding) : 0;
+}
@@ -4,17 +4,32 @@
 #include <SDL_ttf.h>
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-Renderer* renderer_create(SDL_Window* window)
+// Software renderer drawing into a framebuffer the size of the window
+static SDL_Renderer* renderer_create_headless(Renderer* renderer, SDL_Window* window)
 {
-    Renderer* renderer = malloc(sizeof(Renderer));
+    int w, h;
+    SDL_GetWindowSize(window, &w, &h);
+
+    renderer->framebuffer = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (!renderer->framebuffer) return NULL;
+    return SDL_CreateSoftwareRenderer(renderer->framebuffer);
+}
+
+Renderer* renderer_create(SDL_Window* window, RendererBackend backend)
+{
+    Renderer* renderer = calloc(1, sizeof(Renderer));
     if (!renderer)
     {
         fprintf(stderr, "[renderer] Failed to allocate Renderer.\n");
         return NULL;
     }
 
-    renderer->sdl_renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    renderer->backend = backend;
+    if (backend == RENDERER_BACKEND_HEADLESS) renderer->sdl_renderer = renderer_create_headless(renderer, window);
+    else renderer->sdl_renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
     if (!renderer->sdl_renderer)
     {
         fprintf(stderr, "[renderer] Failed to create SDL renderer: %s\n", SDL_GetError());
@@ -22,8 +37,33 @@ Renderer* renderer_create(SDL_Window* window)
         return NULL;
     }
     SDL_SetRenderDrawBlendMode(renderer->sdl_renderer, SDL_BLENDMODE_BLEND);
+    renderer->draw_blend = SDL_BLENDMODE_BLEND;
+
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(renderer->sdl_renderer, &info) == 0) renderer->max_texture_width = info.max_texture_width;
+
+    ui_layer_init(&renderer->infobar_layer);
+
+    renderer->line_cache = line_cache_create(LINE_CACHE_DEFAULT_BUDGET);
+    if (!renderer->line_cache)
+    {
+        fprintf(stderr, "[renderer] Failed to create line cache.\n");
+        renderer_destroy(renderer);
+        return NULL;
+    }
 
-    renderer->font = TTF_OpenFont("resources/fonts/SourceCodePro-Bold.ttf", 16);
+    // Glyphs rasterized by earlier sessions, so the first frame needs none
+    atlas_cache_open(&renderer->atlas_cache, ATLAS_CACHE_PATH);
+
+    // New glyphs are rasterized by workers, or inline if there are none.
+    // Headless frames are compared against golden images, each is drawn complete
+    if (backend == RENDERER_BACKEND_GPU)
+    {
+        renderer->raster_pool = raster_pool_create(0);
+        if (!renderer->raster_pool) fprintf(stderr, "[renderer] Rasterizing glyphs on the UI thread.\n");
+    }
+
+    renderer->font = font_manager_get_font(FONT_DEFAULT_PATH, 16);
     if (!renderer->font)
     {
         fprintf(stderr, "[renderer] Failed to open font: %s\n", TTF_GetError());
@@ -32,73 +72,515 @@ Renderer* renderer_create(SDL_Window* window)
     }
 
     printf("[renderer] TTF font created.\n");
-    printf("[renderer] Renderer created.\n");
+    printf("[renderer] %s renderer created.\n", backend == RENDERER_BACKEND_HEADLESS ? "Headless" : "GPU");
     return renderer;
 }
 
+// Writes every atlas to the atlas cache for the next start
+static void renderer_save_atlases(Renderer* r)
+{
+    int count = r->atlas_count + RENDERER_SDF_ATLASES;
+    GlyphAtlas** atlases = malloc(count * sizeof(GlyphAtlas*));
+    if (atlases)
+    {
+        if (r->atlas_count > 0) memcpy(atlases, r->atlases, r->atlas_count * sizeof(GlyphAtlas*));
+        memcpy(atlases + r->atlas_count, r->sdf_atlases, sizeof(r->sdf_atlases));
+        printf("[renderer] %zu atlases were restored from the atlas cache\n", r->atlas_cache.restored);
+        atlas_cache_save(&r->atlas_cache, ATLAS_CACHE_PATH, atlases, count);
+        free(atlases);
+    }
+    atlas_cache_close(&r->atlas_cache);
+}
+
 void renderer_destroy(Renderer* r)
 {
     if (!r) return;
-    if (r->font) TTF_CloseFont(r->font);
+    ui_layer_destroy(&r->infobar_layer);
+    line_cache_destroy(r->line_cache);
+    raster_pool_destroy(r->raster_pool); // Glyphs still pending are left out of the cache
+    renderer_save_atlases(r);
+    for (int i = 0; i < r->atlas_count; i++) glyph_atlas_destroy(r->atlases[i]);
+    for (int i = 0; i < RENDERER_SDF_ATLASES; i++) glyph_atlas_destroy(r->sdf_atlases[i]);
+    free(r->atlases);
+    free(r->vertices);
+    free(r->indices);
+    free(r->queue);
+    free(r->batches);
     if (r->sdl_renderer) SDL_DestroyRenderer(r->sdl_renderer);
+    if (r->framebuffer) SDL_FreeSurface(r->framebuffer);
     free(r);
 }
 
+void renderer_reset(Renderer* r, bool device_lost)
+{
+    if (!device_lost)
+    {
+        ui_layer_invalidate(&r->infobar_layer);
+        return;
+    }
+
+    // Every texture went with the device, only what is kept in memory can be restored
+    line_cache_clear(r->line_cache);
+    ui_layer_destroy(&r->infobar_layer);
+    for (int i = 0; i < r->atlas_count; i++) glyph_atlas_reload(r->atlases[i]);
+    for (int i = 0; i < RENDERER_SDF_ATLASES; i++)
+    {
+        if (r->sdf_atlases[i]) glyph_atlas_reload(r->sdf_atlases[i]);
+    }
+    printf("[renderer] Render device was reset, textures recreated.\n");
+}
+
+GlyphAtlas* renderer_get_atlas(Renderer* r, TTF_Font* font)
+{
+    if (r->last_atlas && r->last_atlas->font == font) return r->last_atlas;
+
+    for (int i = 0; i < r->atlas_count; i++)
+    {
+        if (r->atlases[i]->font == font)
+        {
+            r->last_atlas = r->atlases[i];
+            return r->last_atlas;
+        }
+    }
+
+    if (r->atlas_count == r->atlas_capacity)
+    {
+        int new_capacity = r->atlas_capacity ? r->atlas_capacity * 2 : 8;
+        GlyphAtlas** atlases = realloc(r->atlases, new_capacity * sizeof(GlyphAtlas*));
+        if (!atlases) return NULL;
+        r->atlases = atlases;
+        r->atlas_capacity = new_capacity;
+    }
+
+    GlyphAtlas* atlas = glyph_atlas_create(r->sdl_renderer, font);
+    if (!atlas) return NULL;
+
+    FontHandle handle = font_manager_find(font);
+    atlas->size = font_manager_size(handle);
+    atlas->font_hash = font_manager_file_hash(handle);
+    atlas_cache_restore(&r->atlas_cache, atlas);
+
+    FontSource source;
+    if (r->raster_pool && font_manager_source(handle, &source)) glyph_atlas_set_pool(atlas, r->raster_pool, &source);
+
+    r->atlases[r->atlas_count++] = atlas;
+    r->last_atlas = atlas;
+    return atlas;
+}
+
+void renderer_prewarm_atlas(Renderer* r, TTF_Font* font)
+{
+    if (!r->raster_pool || !font) return;
+
+    // Keep the lookup cache on the font being drawn with
+    GlyphAtlas* last = r->last_atlas;
+    GlyphAtlas* atlas = renderer_get_atlas(r, font);
+    if (last) r->last_atlas = last;
+    if (!atlas) return;
+
+    // Glyphs restored from the atlas cache are already loaded and skipped
+    for (int c = FONT_PREWARM_FIRST_GLYPH; c <= FONT_PREWARM_LAST_GLYPH; c++) glyph_atlas_get(atlas, (unsigned char)c);
+}
+
+bool renderer_upload_glyphs(Renderer* r, Uint32 budget_ms)
+{
+    if (!r->raster_pool) return false;
+
+    Uint32 start = SDL_GetTicks();
+    int uploaded = 0;
+    RasterJob* job;
+    while ((uploaded == 0 || SDL_GetTicks() - start < budget_ms) && (job = raster_pool_take(r->raster_pool)))
+    {
+        // Font atlases live as long as the renderer, so the owner is still there
+        GlyphAtlas* atlas = job->owner;
+        if (glyph_atlas_complete(atlas, (unsigned char)job->ch, job->surface)) uploaded++;
+        raster_pool_release(job);
+    }
+
+    if (uploaded == 0) return false;
+    r->glyph_generation++;
+    return true;
+}
+
+bool renderer_glyphs_pending(Renderer* r)
+{
+    return raster_pool_outstanding(r->raster_pool) > 0;
+}
+
+GlyphAtlas* renderer_get_sdf_atlas(Renderer* r, SdfFont* sdf, int size)
+{
+    if (!sdf || size <= 0) return NULL;
+
+    int i = 0;
+    while (i < RENDERER_SDF_ATLASES - 1 && r->sdf_atlases[i] &&
+           (r->sdf_atlases[i]->sdf != sdf || r->sdf_atlases[i]->size != size))
+    {
+        i++;
+    }
+
+    GlyphAtlas* atlas = r->sdf_atlases[i];
+    if (!atlas || atlas->sdf != sdf || atlas->size != size)
+    {
+        // The least recently used size goes, quads queued from it are drawn first
+        if (atlas)
+        {
+            renderer_flush(r);
+            glyph_atlas_destroy(atlas);
+        }
+        atlas = glyph_atlas_create_sdf(r->sdl_renderer, sdf, size);
+        if (!atlas)
+        {
+            r->sdf_atlases[i] = NULL;
+            return NULL;
+        }
+        atlas->font_hash = font_manager_file_hash(font_manager_find(sdf->font));
+        atlas_cache_restore(&r->atlas_cache, atlas);
+    }
+
+    // Move to the front
+    memmove(&r->sdf_atlases[1], &r->sdf_atlases[0], i * sizeof(GlyphAtlas*));
+    r->sdf_atlases[0] = atlas;
+    return atlas;
+}
+
+static bool renderer_reserve_quads(Renderer* r, int count)
+{
+    if (count <= r->quad_capacity) return true;
+
+    int new_capacity = r->quad_capacity ? r->quad_capacity : 256;
+    while (new_capacity < count) new_capacity *= 2;
+
+    SDL_Vertex* vertices = realloc(r->vertices, (size_t)new_capacity * 4 * sizeof(SDL_Vertex));
+    if (!vertices) return false;
+    r->vertices = vertices;
+
+    int* indices = realloc(r->indices, (size_t)new_capacity * 6 * sizeof(int));
+    if (!indices) return false;
+    r->indices = indices;
+
+    // Every quad is two triangles over its own 4 vertices
+    for (int i = r->quad_capacity; i < new_capacity; i++)
+    {
+        int v = i * 4;
+        int* idx = &r->indices[i * 6];
+        idx[0] = v;     idx[1] = v + 1; idx[2] = v + 2;
+        idx[3] = v + 2; idx[4] = v + 1; idx[5] = v + 3;
+    }
+
+    r->quad_capacity = new_capacity;
+    return true;
+}
+
+// Finds a batch the quad can join without changing what ends up on screen,
+// or starts a new one
+static int renderer_find_batch(Renderer* r, SDL_Texture* texture, SDL_BlendMode blend, const SDL_FRect* dest)
+{
+    for (int i = r->batch_count - 1; i >= 0 && i >= r->batch_count - RENDERER_BATCH_LOOKBACK; i--)
+    {
+        RenderBatch* b = &r->batches[i];
+        if (b->texture == texture && b->blend == blend)
+        {
+            SDL_UnionFRect(&b->bounds, dest, &b->bounds);
+            return i;
+        }
+
+        // Drawing under a later batch would change the result
+        if (SDL_HasIntersectionF(&b->bounds, dest)) break;
+    }
+
+    if (r->batch_count == r->batch_capacity)
+    {
+        int new_capacity = r->batch_capacity ? r->batch_capacity * 2 : 64;
+        RenderBatch* batches = realloc(r->batches, new_capacity * sizeof(RenderBatch));
+        if (!batches) return -1;
+        r->batches = batches;
+        r->batch_capacity = new_capacity;
+    }
+
+    RenderBatch* b = &r->batches[r->batch_count];
+    b->texture = texture;
+    b->blend = blend;
+    b->bounds = *dest;
+    b->quad_count = 0;
+    return r->batch_count++;
+}
+
+// Queues a quad showing the uv rect of a texture (or a solid colour if NULL)
+static void renderer_queue_quad(Renderer* r, SDL_Texture* texture, SDL_FRect dest,
+                                float u0, float v0, float u1, float v1, SDL_Color color)
+{
+    if (dest.w <= 0.0f || dest.h <= 0.0f) return;
+
+    if (r->queue_count == r->queue_capacity)
+    {
+        int new_capacity = r->queue_capacity ? r->queue_capacity * 2 : 1024;
+        RenderQuad* queue = realloc(r->queue, new_capacity * sizeof(RenderQuad));
+        if (!queue) return;
+        r->queue = queue;
+        r->queue_capacity = new_capacity;
+    }
+
+    SDL_BlendMode blend = r->draw_blend;
+    if (texture) SDL_GetTextureBlendMode(texture, &blend);
+
+    int batch = renderer_find_batch(r, texture, blend, &dest);
+    if (batch < 0) return;
+    r->batches[batch].quad_count++;
+
+    RenderQuad* q = &r->queue[r->queue_count++];
+    float x0 = dest.x, y0 = dest.y, x1 = dest.x + dest.w, y1 = dest.y + dest.h;
+    q->batch = batch;
+    q->vertices[0] = (SDL_Vertex){ { x0, y0 }, color, { u0, v0 } };
+    q->vertices[1] = (SDL_Vertex){ { x1, y0 }, color, { u1, v0 } };
+    q->vertices[2] = (SDL_Vertex){ { x0, y1 }, color, { u0, v1 } };
+    q->vertices[3] = (SDL_Vertex){ { x1, y1 }, color, { u1, v1 } };
+}
+
+void renderer_flush(Renderer* r)
+{
+    if (r->queue_count == 0) return;
+
+    if (renderer_reserve_quads(r, r->queue_count))
+    {
+        // Counting sort of the quads by batch, keeping draw order within each
+        int first = 0;
+        for (int i = 0; i < r->batch_count; i++)
+        {
+            int count = r->batches[i].quad_count;
+            r->batches[i].quad_count = first;
+            first += count;
+        }
+
+        for (int i = 0; i < r->queue_count; i++)
+        {
+            int slot = r->batches[r->queue[i].batch].quad_count++;
+            memcpy(&r->vertices[slot * 4], r->queue[i].vertices, sizeof(r->queue[i].vertices));
+        }
+
+        // Each batch's quad_count now holds where the next one starts
+        first = 0;
+        for (int i = 0; i < r->batch_count; i++)
+        {
+            int end = r->batches[i].quad_count;
+            int quads = end - first;
+            if (quads > 0)
+            {
+                SDL_RenderGeometry(r->sdl_renderer, r->batches[i].texture,
+                                   &r->vertices[first * 4], quads * 4, r->indices, quads * 6);
+                r->stats.draw_calls++;
+                r->stats.vertices += quads * 4;
+                r->stats.quads += quads;
+            }
+            first = end;
+        }
+    }
+
+    r->queue_count = 0;
+    r->batch_count = 0;
+}
+
 void renderer_clear(Renderer* r)
 {
+    // Anything still queued would be cleared anyway
+    r->queue_count = 0;
+    r->batch_count = 0;
+
     SDL_SetRenderDrawColor(r->sdl_renderer, 20, 20, 20, 255);
     SDL_RenderClear(r->sdl_renderer);
 }
 
 void renderer_present(Renderer* r)
 {
+    renderer_flush(r);
+
+    r->last_stats = r->stats;
+    memset(&r->stats, 0, sizeof(r->stats));
+
     SDL_RenderPresent(r->sdl_renderer);
 }
 
-void renderer_draw_text(Renderer* r, const char* text, int x, int y, TTF_Font* font, TextAlign align, SDL_Color color)
+bool renderer_dump_frame(Renderer* r, const char* path)
 {
-    int text_width, text_height;
-    TTF_SizeText(font, text, &text_width, &text_height);
+    renderer_flush(r);
 
-    SDL_Surface* surface = TTF_RenderText_Blended(font, text, color);
-    if (!surface) return;
+    SDL_Surface* frame = r->framebuffer;
+    if (!frame)
+    {
+        int w, h;
+        if (SDL_GetRendererOutputSize(r->sdl_renderer, &w, &h) != 0) return false;
+
+        frame = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+        if (frame && SDL_RenderReadPixels(r->sdl_renderer, NULL, SDL_PIXELFORMAT_ARGB8888, frame->pixels, frame->pitch) != 0)
+        {
+            SDL_FreeSurface(frame);
+            frame = NULL;
+        }
+    }
+
+    bool ok = frame && SDL_SaveBMP(frame, path) == 0;
+    if (!ok) fprintf(stderr, "[renderer] Failed to dump frame to %s: %s\n", path, SDL_GetError());
+    if (frame && frame != r->framebuffer) SDL_FreeSurface(frame);
+    return ok;
+}
+
+void renderer_set_viewport(Renderer* r, const SDL_Rect* rect)
+{
+    renderer_flush(r);
+    SDL_RenderSetViewport(r->sdl_renderer, rect);
+}
+
+void renderer_set_target(Renderer* r, SDL_Texture* target)
+{
+    renderer_flush(r);
+    SDL_SetRenderTarget(r->sdl_renderer, target);
+}
+
+RenderStats renderer_get_stats(Renderer* r)
+{
+    return r->last_stats;
+}
+
+void renderer_draw_texture(Renderer* r, SDL_Texture* texture, int x, int y, int w, int h)
+{
+    SDL_Color white = { 255, 255, 255, 255 };
+    SDL_FRect dest = { (float)x, (float)y, (float)w, (float)h };
+    renderer_queue_quad(r, texture, dest, 0.0f, 0.0f, 1.0f, 1.0f, white);
+}
+
+bool renderer_draw_cached_text(Renderer* r, uint64_t hash, int x, int y, TTF_Font* font, SDL_Color color)
+{
+    const LineCacheEntry* entry = line_cache_find(r->line_cache, line_cache_key(hash, font, color));
+    if (!entry) return false;
+
+    renderer_draw_texture(r, entry->texture, x, y, entry->width, entry->height);
+    return true;
+}
+
+void renderer_cache_text(Renderer* r, uint64_t hash, const char* text, int x, int y, TTF_Font* font, SDL_Color color)
+{
+    if (!text || !font || text[0] == '\0') return;
+
+    // Composed from the font's atlas, only glyphs never seen are rasterized
+    GlyphAtlas* atlas = renderer_get_atlas(r, font);
+    if (!atlas) return;
+    size_t length = strlen(text);
+
+    // Lines wider than a texture can be are drawn glyph by glyph every frame
+    if (r->max_texture_width > 0 && glyph_atlas_measure(atlas, text, length) > r->max_texture_width)
+    {
+        renderer_draw_atlas_text(r, atlas, text, length, x, y, color);
+        return;
+    }
+
+    SDL_Surface* surface = glyph_atlas_render_text(atlas, text, length, color);
+    if (!surface)
+    {
+        // Some glyphs are still being rasterized, draw what there is without caching it
+        renderer_draw_atlas_text(r, atlas, text, length, x, y, color);
+        return;
+    }
     SDL_Texture* texture = SDL_CreateTextureFromSurface(r->sdl_renderer, surface);
-    int tex_w, tex_h;
-    SDL_QueryTexture(texture, NULL, NULL, &tex_w, &tex_h);
+    int w = surface->w, h = surface->h;
+    SDL_FreeSurface(surface);
+    if (!texture)
+    {
+        fprintf(stderr, "[renderer] Failed to create line texture: %s\n", SDL_GetError());
+        renderer_draw_atlas_text(r, atlas, text, length, x, y, color);
+        return;
+    }
+
+    // Making room may evict textures queued this frame, draw them first
+    if (r->line_cache->bytes + (size_t)w * h * 4 > r->line_cache->budget) renderer_flush(r);
+
+    const LineCacheEntry* entry = line_cache_insert(r->line_cache, line_cache_key(hash, font, color), texture, w, h);
+    if (!entry) return;
+
+    renderer_draw_texture(r, entry->texture, x, y, w, h);
+}
+
+static void renderer_queue_glyph(Renderer* r, GlyphAtlas* atlas, const AtlasGlyph* glyph, int pen, int y, SDL_Color color)
+{
+    if (glyph->page < 0) return;
+
+    const float scale = 1.0f / GLYPH_ATLAS_PAGE_SIZE;
+    SDL_Rect src = glyph->src;
+    SDL_FRect dest = { (float)(pen + glyph->offset_x), (float)y, (float)src.w, (float)src.h };
+    renderer_queue_quad(r, atlas->pages[glyph->page], dest, src.x * scale, src.y * scale,
+                        (src.x + src.w) * scale, (src.y + src.h) * scale, color);
+}
+
+void renderer_draw_atlas_text(Renderer* r, GlyphAtlas* atlas, const char* text, size_t length, int x, int y, SDL_Color color)
+{
+    if (!atlas || !text) return;
+
+    int pen = x;
+    for (size_t i = 0; i < length; i++)
+    {
+        unsigned char c = (unsigned char)text[i];
+        if (i > 0) pen += glyph_atlas_kerning(atlas, (unsigned char)text[i - 1], c);
+
+        const AtlasGlyph* glyph = glyph_atlas_get(atlas, c);
+        renderer_queue_glyph(r, atlas, glyph, pen, y, color);
+        pen += glyph->advance;
+    }
+}
+
+void renderer_draw_text(Renderer* r, const char* text, int x, int y, TTF_Font* font, TextAlign align, SDL_Color color)
+{
+    if (!text || !font || text[0] == '\0') return;
+
+    GlyphAtlas* atlas = renderer_get_atlas(r, font);
+    size_t length = strlen(text);
+    if (!atlas) return;
 
     switch (align)
     {
         case ALIGN_CENTER:
-            x -= text_width / 2;
+            x -= glyph_atlas_measure(atlas, text, length) / 2;
             break;
         case ALIGN_RIGHT:
-            x -= text_width;
+            x -= glyph_atlas_measure(atlas, text, length);
             break;
         case ALIGN_LEFT:
         default:
             break;
     }
 
-    SDL_Rect dest = { x, y, surface->w, surface->h };
-    SDL_FreeSurface(surface);
-    // Visualise text bounds
-    //renderer_draw_rect(r, dest.x, dest.y, dest.w, dest.h, color);
-    SDL_RenderCopy(r->sdl_renderer, texture, NULL, &dest);
-    SDL_DestroyTexture(texture);
+    renderer_draw_atlas_text(r, atlas, text, length, x, y, color);
+}
+
+void renderer_draw_atlas_number(Renderer* r, GlyphAtlas* atlas, uint64_t number, int x, int y, SDL_Color color)
+{
+    if (!atlas) return;
+
+    // Digits from the right, each centred in its cell
+    int cell = glyph_atlas_digit_width(atlas);
+    int pen = x;
+    do
+    {
+        const AtlasGlyph* glyph = glyph_atlas_get(atlas, (unsigned char)('0' + number % 10));
+        pen -= cell;
+        renderer_queue_glyph(r, atlas, glyph, pen + (cell - glyph->advance) / 2, y, color);
+        number /= 10;
+    } while (number > 0);
+}
+
+void renderer_draw_number(Renderer* r, int number, int x, int y, TTF_Font* font, SDL_Color color)
+{
+    if (!font || number < 0) return;
+    renderer_draw_atlas_number(r, renderer_get_atlas(r, font), (uint64_t)number, x, y, color);
 }
 
 void renderer_draw_rect(Renderer* r, int x, int y, int w, int h, SDL_Color color)
 {
-    SDL_Rect rect = { x, y, w, h };
-    SDL_SetRenderDrawColor(r->sdl_renderer, color.r, color.g, color.b, color.a);
-    SDL_RenderFillRect(r->sdl_renderer, &rect);
+    SDL_FRect dest = { (float)x, (float)y, (float)w, (float)h };
+    renderer_queue_quad(r, NULL, dest, 0.0f, 0.0f, 0.0f, 0.0f, color);
 }
 
 void renderer_draw_cursor(Renderer* r, int x, int y, int height, float alpha)
 {
-    SDL_Rect cursor_rect = { x, y, 2, height };
-    SDL_SetRenderDrawColor(r->sdl_renderer, 200, 200, 200, (Uint8)(alpha * 255));
-    SDL_RenderFillRect(r->sdl_renderer, &cursor_rect);
+    SDL_Color cursor_color = { 200, 200, 200, (Uint8)(alpha * 255) };
+    renderer_draw_rect(r, x, y, 2, height, cursor_color);
 }
 
 void renderer_draw_infobar(Renderer* r, const char* text)
@@ -106,13 +588,17 @@ void renderer_draw_infobar(Renderer* r, const char* text)
     SDL_Rect vp;
     SDL_RenderGetViewport(r->sdl_renderer, &vp);
 
-    SDL_Rect rect = { 0, vp.h - 25, vp.w, 25};
-    SDL_SetRenderDrawColor(r->sdl_renderer, 30, 30, 30, 255);
-    SDL_RenderFillRect(r->sdl_renderer, &rect);
+    uint64_t key = ui_layer_hash(UI_LAYER_HASH_SEED, text, strlen(text));
+    if (ui_layer_begin(&r->infobar_layer, r, 0, vp.h - 25, vp.w, 25, key))
+    {
+        SDL_Color infobar_color = { 30, 30, 30, 255 };
+        renderer_draw_rect(r, 0, 0, vp.w, 25, infobar_color);
 
-    SDL_Color info_text_color = { 200, 200, 200, 255 };
-    TTF_Font* text_font = font_manager_get_font("resources/fonts/SourceCodePro-Bold.ttf", 16);
-    renderer_draw_text(r, text, 5, vp.h - 25, text_font, ALIGN_LEFT, info_text_color);
+        SDL_Color info_text_color = { 200, 200, 200, 255 };
+        TTF_Font* text_font = font_manager_get_font(FONT_DEFAULT_PATH, 16);
+        renderer_draw_text(r, text, 5, 0, text_font, ALIGN_LEFT, info_text_color);
+    }
+    ui_layer_end(&r->infobar_layer, r);
 }
 
 SDL_Rect renderer_get_viewport(Renderer* r)
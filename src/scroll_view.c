@@ -0,0 +1,167 @@
+#include "scroll_view.h"
+#include "renderer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void scroll_view_init(ScrollView* v)
+{
+    memset(v, 0, sizeof(ScrollView));
+}
+
+static void scroll_view_destroy_textures(ScrollView* v)
+{
+    if (v->front) SDL_DestroyTexture(v->front);
+    if (v->back) SDL_DestroyTexture(v->back);
+    v->front = NULL;
+    v->back = NULL;
+}
+
+void scroll_view_destroy(ScrollView* v)
+{
+    scroll_view_destroy_textures(v);
+    free(v->row_keys);
+    free(v->spare_keys);
+    scroll_view_init(v);
+}
+
+void scroll_view_invalidate(ScrollView* v)
+{
+    if (v->row_keys) memset(v->row_keys, 0, v->row_capacity * sizeof(uint64_t));
+}
+
+static SDL_Texture* scroll_view_create_texture(struct Renderer* r, int w, int h)
+{
+    SDL_Texture* texture = SDL_CreateTexture(r->sdl_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, w, h);
+    if (texture) SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE); // Rows are opaque, copy as is
+    return texture;
+}
+
+static bool scroll_view_reserve_rows(ScrollView* v, int count)
+{
+    if (count <= v->row_capacity) return true;
+
+    uint64_t* keys = realloc(v->row_keys, count * sizeof(uint64_t));
+    if (!keys) return false;
+    v->row_keys = keys;
+
+    uint64_t* spare = realloc(v->spare_keys, count * sizeof(uint64_t));
+    if (!spare) return false;
+    v->spare_keys = spare;
+
+    memset(v->row_keys + v->row_capacity, 0, (count - v->row_capacity) * sizeof(uint64_t));
+    v->row_capacity = count;
+    return true;
+}
+
+void scroll_view_begin(ScrollView* v, struct Renderer* r, int w, int h, int row_height, int64_t scroll_y, uint64_t layout_key)
+{
+    v->drawing = true;
+    v->rows_drawn = 0;
+
+    int64_t old_scroll_y = v->scroll_y;
+    size_t old_first = v->first_row;
+    int old_count = v->row_count;
+
+    // Rows drawn before their glyphs arrived from the raster pool are out of date
+    layout_key = ui_layer_hash(layout_key, &r->glyph_generation, sizeof(r->glyph_generation));
+
+    bool resized = v->w != w || v->h != h;
+    bool full = resized || v->row_height != row_height || v->layout_key != layout_key || !v->front;
+
+    if (!v->direct && (resized || !v->front))
+    {
+        scroll_view_destroy_textures(v);
+        v->front = scroll_view_create_texture(r, w, h);
+        v->back = scroll_view_create_texture(r, w, h);
+        if (!v->front || !v->back)
+        {
+            fprintf(stderr, "[scroll_view] Failed to create view textures, drawing directly: %s\n", SDL_GetError());
+            scroll_view_destroy_textures(v);
+            v->direct = true;
+        }
+    }
+
+    v->w = w;
+    v->h = h;
+    v->row_height = row_height > 0 ? row_height : 1;
+    v->layout_key = layout_key;
+    if (scroll_y < 0) scroll_y = 0;
+    v->scroll_y = scroll_y;
+    v->first_row = (size_t)(scroll_y / v->row_height);
+    v->row_count = (int)((scroll_y + h - 1) / v->row_height - (int64_t)v->first_row + 1);
+    if (v->row_count < 0) v->row_count = 0;
+
+    if (!scroll_view_reserve_rows(v, v->row_count))
+    {
+        v->row_count = 0;
+        full = true;
+    }
+
+    if (v->direct) return;
+
+    v->viewport = renderer_get_viewport(r);
+
+    // Shift the pixels still in view, keeping the rows that were fully drawn
+    int64_t dy = scroll_y - old_scroll_y;
+    if (!full && dy != 0 && dy > -h && dy < h)
+    {
+        renderer_set_target(r, v->back);
+        renderer_draw_texture(r, v->front, 0, (int)-dy, w, h);
+
+        SDL_Texture* shifted = v->back;
+        v->back = v->front;
+        v->front = shifted;
+
+        for (int i = 0; i < v->row_count; i++)
+        {
+            size_t row = v->first_row + i;
+            int64_t old_index = (int64_t)row - (int64_t)old_first;
+            int64_t old_y = (int64_t)row * v->row_height - old_scroll_y;
+            bool kept = old_index >= 0 && old_index < old_count && old_y >= 0 && old_y + v->row_height <= h;
+            v->spare_keys[i] = kept ? v->row_keys[old_index] : 0;
+        }
+
+        uint64_t* keys = v->row_keys;
+        v->row_keys = v->spare_keys;
+        v->spare_keys = keys;
+    }
+    else if (full || dy != 0)
+    {
+        scroll_view_invalidate(v);
+    }
+
+    renderer_set_target(r, v->front);
+}
+
+bool scroll_view_row_dirty(ScrollView* v, size_t row, uint64_t key)
+{
+    if (row < v->first_row || row - v->first_row >= (size_t)v->row_count) return false;
+    int i = (int)(row - v->first_row);
+
+    if (!v->direct)
+    {
+        if (v->row_keys[i] == key) return false;
+        v->row_keys[i] = key;
+    }
+
+    v->rows_drawn++;
+    return true;
+}
+
+int scroll_view_row_y(const ScrollView* v, size_t row)
+{
+    return (int)((int64_t)row * v->row_height - v->scroll_y);
+}
+
+void scroll_view_end(ScrollView* v, struct Renderer* r)
+{
+    if (!v->drawing) return;
+    v->drawing = false;
+
+    if (v->direct) return;
+
+    renderer_set_target(r, NULL);
+    renderer_set_viewport(r, &v->viewport);
+    renderer_draw_texture(r, v->front, 0, 0, v->w, v->h);
+}
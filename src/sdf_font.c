@@ -0,0 +1,262 @@
+#include "sdf_font.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+static float scale_of(int size)
+{
+    return (float)size / SDF_FONT_BASE_SIZE;
+}
+
+static int scaled(int value, int size)
+{
+    return (int)lroundf(value * scale_of(size));
+}
+
+static SdfGlyph* load_metrics(SdfFont* f, unsigned char c)
+{
+    SdfGlyph* g = &f->glyphs[c];
+    if (g->loaded) return g;
+
+    g->loaded = true;
+    int minx, maxx, miny, maxy, advance;
+    if (TTF_GlyphMetrics32(f->font, c, &minx, &maxx, &miny, &maxy, &advance) != 0) return g;
+
+    // Same box as the glyph atlas: the rendered glyph is as tall as the font
+    g->advance = advance;
+    g->offset_x = minx < 0 ? minx : 0;
+    return g;
+}
+
+// Distance from every pixel to the nearest pixel whose inside flag is want,
+// propagated in two passes from each pixel's neighbours (dead reckoning)
+static void distance_to(const bool* inside, bool want, float* dist, int* nearest, int w, int h)
+{
+    static const int forward[4][2] = { { -1, -1 }, { 0, -1 }, { 1, -1 }, { -1, 0 } };
+    static const int backward[4][2] = { { 1, 0 }, { -1, 1 }, { 0, 1 }, { 1, 1 } };
+
+    for (int i = 0; i < w * h; i++)
+    {
+        dist[i] = inside[i] == want ? 0.0f : 1e9f;
+        nearest[i] = inside[i] == want ? i : -1;
+    }
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        const int (*step)[2] = pass == 0 ? forward : backward;
+        for (int n = 0; n < w * h; n++)
+        {
+            int i = pass == 0 ? n : w * h - 1 - n;
+            int x = i % w, y = i / w;
+            for (int k = 0; k < 4; k++)
+            {
+                int nx = x + step[k][0], ny = y + step[k][1];
+                if (nx < 0 || ny < 0 || nx >= w || ny >= h) continue;
+
+                int seed = nearest[ny * w + nx];
+                if (seed < 0) continue;
+
+                float d = hypotf((float)(x - seed % w), (float)(y - seed / w));
+                if (d < dist[i])
+                {
+                    dist[i] = d;
+                    nearest[i] = seed;
+                }
+            }
+        }
+    }
+}
+
+// Rasterises a glyph at the base size and turns its coverage into a field
+static void build_field(SdfFont* f, unsigned char c, SdfGlyph* g)
+{
+    g->has_field = true;
+
+    SDL_Color white = { 255, 255, 255, 255 };
+    SDL_Surface* surface = TTF_RenderGlyph32_Blended(f->font, c, white);
+    if (!surface) return;
+
+    SDL_Surface* converted = surface;
+    if (surface->format->format != SDL_PIXELFORMAT_ARGB8888)
+    {
+        converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+    }
+
+    int pw = converted ? converted->w + 2 * SDF_FONT_SPREAD : 0;
+    int ph = converted ? converted->h + 2 * SDF_FONT_SPREAD : 0;
+    unsigned char* alpha = calloc((size_t)pw * ph, 1);
+    bool* inside = calloc((size_t)pw * ph, sizeof(bool));
+    float* to_outside = malloc((size_t)pw * ph * sizeof(float));
+    float* to_inside = malloc((size_t)pw * ph * sizeof(float));
+    int* nearest = malloc((size_t)pw * ph * sizeof(int));
+    g->field = malloc((size_t)pw * ph);
+
+    if (converted && alpha && inside && to_outside && to_inside && nearest && g->field)
+    {
+        for (int y = 0; y < converted->h; y++)
+        {
+            const Uint32* row = (const Uint32*)((const Uint8*)converted->pixels + y * converted->pitch);
+            for (int x = 0; x < converted->w; x++)
+            {
+                int i = (y + SDF_FONT_SPREAD) * pw + x + SDF_FONT_SPREAD;
+                alpha[i] = (unsigned char)(row[x] >> 24);
+                inside[i] = alpha[i] >= 128;
+            }
+        }
+
+        distance_to(inside, false, to_outside, nearest, pw, ph);
+        distance_to(inside, true, to_inside, nearest, pw, ph);
+
+        for (int i = 0; i < pw * ph; i++)
+        {
+            // Pixels on the outline know where it is more precisely from their coverage
+            float d = inside[i] ? to_outside[i] - 0.5f : 0.5f - to_inside[i];
+            if (alpha[i] > 0 && alpha[i] < 255) d = alpha[i] / 255.0f - 0.5f;
+
+            float v = 128.0f + d * (127.0f / SDF_FONT_SPREAD);
+            g->field[i] = (unsigned char)(v < 0.0f ? 0.0f : v > 255.0f ? 255.0f : v + 0.5f);
+        }
+
+        g->width = converted->w;
+        g->height = converted->h;
+    }
+    else
+    {
+        fprintf(stderr, "[sdf_font] Failed to build glyph %u\n", c);
+        free(g->field);
+        g->field = NULL;
+    }
+
+    free(alpha);
+    free(inside);
+    free(to_outside);
+    free(to_inside);
+    free(nearest);
+    if (converted && converted != surface) SDL_FreeSurface(converted);
+    SDL_FreeSurface(surface);
+}
+
+static SdfGlyph* load_field(SdfFont* f, unsigned char c)
+{
+    SdfGlyph* g = load_metrics(f, c);
+    if (g->has_field) return g;
+
+    int minx, maxx, miny, maxy, advance;
+    if (TTF_GlyphMetrics32(f->font, c, &minx, &maxx, &miny, &maxy, &advance) != 0 || maxx <= minx)
+    {
+        g->has_field = true; // Nothing to draw, e.g. a space
+        return g;
+    }
+
+    build_field(f, c, g);
+    return g;
+}
+
+SdfFont* sdf_font_create(TTF_Font* font)
+{
+    if (!font) return NULL;
+
+    SdfFont* f = calloc(1, sizeof(SdfFont));
+    if (!f)
+    {
+        fprintf(stderr, "[sdf_font] Failed to allocate SdfFont.\n");
+        return NULL;
+    }
+
+    f->font = font;
+    f->height = TTF_FontHeight(font);
+    f->line_skip = TTF_FontLineSkip(font);
+    f->kerning = TTF_GetFontKerning(font) && !TTF_FontFaceIsFixedWidth(font);
+    return f;
+}
+
+void sdf_font_destroy(SdfFont* f)
+{
+    if (!f) return;
+
+    for (int i = 0; i < SDF_FONT_GLYPHS; i++) free(f->glyphs[i].field);
+    free(f);
+}
+
+int sdf_font_advance(SdfFont* f, unsigned char c, int size)
+{
+    return scaled(load_metrics(f, c)->advance, size);
+}
+
+int sdf_font_kerning(SdfFont* f, unsigned char prev, unsigned char c, int size)
+{
+    if (!f->kerning) return 0;
+    return scaled(TTF_GetFontKerningSizeGlyphs32(f->font, prev, c), size);
+}
+
+int sdf_font_height(SdfFont* f, int size)
+{
+    return scaled(f->height, size);
+}
+
+int sdf_font_line_skip(SdfFont* f, int size)
+{
+    return scaled(f->line_skip, size);
+}
+
+void sdf_font_glyph_box(SdfFont* f, unsigned char c, int size, int* offset_x, int* w, int* h)
+{
+    SdfGlyph* g = load_field(f, c);
+    float s = scale_of(size);
+
+    *offset_x = (int)floorf(g->offset_x * s);
+    *w = g->field ? (int)ceilf(g->width * s) : 0;
+    *h = g->field ? (int)ceilf(g->height * s) : 0;
+}
+
+// Bilinear sample of a field, in padded field pixels
+static float sample(const SdfGlyph* g, float x, float y)
+{
+    int pw = g->width + 2 * SDF_FONT_SPREAD;
+    int ph = g->height + 2 * SDF_FONT_SPREAD;
+
+    int x0 = (int)floorf(x), y0 = (int)floorf(y);
+    float fx = x - x0, fy = y - y0;
+    float v[2][2];
+    for (int j = 0; j < 2; j++)
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            int sx = x0 + i, sy = y0 + j;
+            v[j][i] = (sx < 0 || sy < 0 || sx >= pw || sy >= ph) ? 0.0f : g->field[sy * pw + sx];
+        }
+    }
+
+    float top = v[0][0] + (v[0][1] - v[0][0]) * fx;
+    float bottom = v[1][0] + (v[1][1] - v[1][0]) * fx;
+    return top + (bottom - top) * fy;
+}
+
+bool sdf_font_resample(SdfFont* f, unsigned char c, int size, Uint32* pixels, int pitch)
+{
+    int offset_x, w, h;
+    sdf_font_glyph_box(f, c, size, &offset_x, &w, &h);
+    if (w <= 0 || h <= 0) return false;
+
+    const SdfGlyph* g = &f->glyphs[c];
+    float s = scale_of(size);
+
+    for (int oy = 0; oy < h; oy++)
+    {
+        Uint32* row = (Uint32*)((Uint8*)pixels + oy * pitch);
+        float v = (oy + 0.5f) / s - 0.5f + SDF_FONT_SPREAD;
+        for (int ox = 0; ox < w; ox++)
+        {
+            // Output pixel centre, back in the base glyph's pixels
+            float u = (offset_x + ox + 0.5f) / s - g->offset_x - 0.5f + SDF_FONT_SPREAD;
+            float d = (sample(g, u, v) - 128.0f) * (SDF_FONT_SPREAD / 127.0f);
+
+            // Coverage ramps across one output pixel around the outline
+            float a = 0.5f + d * s;
+            Uint32 alpha = a <= 0.0f ? 0 : a >= 1.0f ? 255 : (Uint32)(a * 255.0f + 0.5f);
+            row[ox] = (alpha << 24) | 0x00FFFFFF;
+        }
+    }
+    return true;
+}
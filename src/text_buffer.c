@@ -0,0 +1,911 @@
+#include "text_buffer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+    #define TEXT_BUFFER_DEFAULT_EOL "\r\n"
+#else
+    #define TEXT_BUFFER_DEFAULT_EOL "\n"
+#endif
+
+// ----------------------------------------------------------------
+// Piece treap
+// ----------------------------------------------------------------
+
+static unsigned int next_priority(TextBuffer* tb)
+{
+    // xorshift32
+    unsigned int x = tb->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    tb->seed = x;
+    return x;
+}
+
+static size_t piece_total(Piece* p)
+{
+    return p ? p->total : 0;
+}
+
+static void piece_update(Piece* p)
+{
+    p->total = piece_total(p->left) + p->length + piece_total(p->right);
+}
+
+static Piece* piece_new(TextBuffer* tb, const char* data, size_t length)
+{
+    Piece* p = pool_alloc(&tb->pieces);
+    if (!p) return NULL;
+
+    p->left = NULL;
+    p->right = NULL;
+    p->priority = next_priority(tb);
+    p->data = data;
+    p->length = length;
+    p->total = length;
+
+    return p;
+}
+
+static void piece_free_tree(TextBuffer* tb, Piece* p)
+{
+    if (!p) return;
+    piece_free_tree(tb, p->left);
+    piece_free_tree(tb, p->right);
+    pool_free(&tb->pieces, p);
+}
+
+static Piece* piece_merge(Piece* a, Piece* b)
+{
+    if (!a) return b;
+    if (!b) return a;
+
+    if (a->priority > b->priority)
+    {
+        a->right = piece_merge(a->right, b);
+        piece_update(a);
+        return a;
+    }
+
+    b->left = piece_merge(a, b->left);
+    piece_update(b);
+    return b;
+}
+
+// Splits a subtree so that the first pos bytes end up in *l and the rest in *r.
+// A piece straddling pos is cut in two.
+static void piece_split(TextBuffer* tb, Piece* p, size_t pos, Piece** l, Piece** r)
+{
+    if (!p)
+    {
+        *l = NULL;
+        *r = NULL;
+        return;
+    }
+
+    size_t left_total = piece_total(p->left);
+    if (pos <= left_total)
+    {
+        piece_split(tb, p->left, pos, l, &p->left);
+        piece_update(p);
+        *r = p;
+    }
+    else if (pos >= left_total + p->length)
+    {
+        piece_split(tb, p->right, pos - left_total - p->length, &p->right, r);
+        piece_update(p);
+        *l = p;
+    }
+    else
+    {
+        size_t cut = pos - left_total;
+        Piece* tail = piece_new(tb, p->data + cut, p->length - cut);
+        Piece* right = p->right;
+
+        p->length = cut;
+        p->right = NULL;
+        piece_update(p);
+
+        *l = p;
+        *r = piece_merge(tail, right);
+    }
+}
+
+// In-order visit of the pieces overlapping [from, to), base being the document
+// offset of the subtree's first byte
+static bool piece_visit(TextBuffer* tb, Piece* p, size_t base, size_t from, size_t to,
+                        TextBufferSpanFn fn, void* user)
+{
+    if (!p || from >= to) return true;
+
+    size_t left_total = piece_total(p->left);
+    size_t piece_begin = base + left_total;
+    size_t piece_end = piece_begin + p->length;
+
+    if (from < piece_begin)
+    {
+        if (!piece_visit(tb, p->left, base, from, to, fn, user)) return false;
+    }
+
+    if (from < piece_end && to > piece_begin && p->length > 0)
+    {
+        size_t begin = from > piece_begin ? from : piece_begin;
+        size_t end = to < piece_end ? to : piece_end;
+        if (!fn(p->data + (begin - piece_begin), end - begin, user)) return false;
+    }
+
+    if (to > piece_end)
+    {
+        if (!piece_visit(tb, p->right, piece_end, from, to, fn, user)) return false;
+    }
+
+    return true;
+}
+
+// ----------------------------------------------------------------
+// Line tracking
+// ----------------------------------------------------------------
+
+static bool hash_span(const char* data, size_t length, void* user)
+{
+    uint64_t* hash = user;
+    *hash = line_index_hash_bytes(*hash, data, length);
+    return true;
+}
+
+// Extends a hash with the document range [from, to)
+static uint64_t range_hash(TextBuffer* tb, uint64_t hash, size_t from, size_t to)
+{
+    piece_visit(tb, tb->root, 0, from, to, hash_span, &hash);
+    return hash;
+}
+
+// End of the text split into lines, bytes after it are hashed once scanned
+static size_t indexed_end(TextBuffer* tb)
+{
+    return text_buffer_length(tb) - tb->unindexed;
+}
+
+// Recomputes the stored hash of a line from its contents
+static void line_rehash(TextBuffer* tb, size_t line)
+{
+    size_t start = line_index_start(&tb->lines, line);
+    size_t end = start + line_index_length(&tb->lines, line);
+    if (end > indexed_end(tb)) end = indexed_end(tb);
+
+    line_index_set_hash(&tb->lines, line, range_hash(tb, 0, start, end));
+}
+
+// Updates the line index for text inserted at offset, after the pieces have been updated
+static void lines_insert(TextBuffer* tb, size_t offset, const char* text, size_t length)
+{
+    size_t line = line_index_find(&tb->lines, offset);
+    const char* newline = memchr(text, '\n', length);
+
+    if (!newline)
+    {
+        line_index_resize(&tb->lines, line, (ptrdiff_t)length);
+        line_rehash(tb, line);
+        return;
+    }
+
+    size_t line_start = line_index_start(&tb->lines, line);
+    size_t col = offset - line_start;
+    size_t old_length = line_index_length(&tb->lines, line);
+
+    size_t count = 1;
+    for (const char* c = newline; c; c = memchr(c + 1, '\n', text + length - c - 1)) count++;
+
+    uint32_t* lengths = malloc(count * sizeof(uint32_t));
+    uint64_t* hashes = malloc(count * sizeof(uint64_t));
+    if (!lengths || !hashes)
+    {
+        fprintf(stderr, "[text_buffer] Failed to update line index.\n");
+        free(lengths);
+        free(hashes);
+        return;
+    }
+
+    // The edited line is cut at the insertion point: its head ends at the first
+    // new '\n' and its tail is appended to the last inserted line
+    size_t n = 0;
+    const char* line_begin = text;
+    for (const char* c = newline; c; c = memchr(c + 1, '\n', text + length - c - 1))
+    {
+        lengths[n] = (uint32_t)(c + 1 - line_begin);
+        hashes[n] = line_index_hash_bytes(0, line_begin, c + 1 - line_begin);
+        if (n == 0)
+        {
+            lengths[n] += (uint32_t)col;
+            hashes[n] = line_index_hash_bytes(range_hash(tb, 0, line_start, offset),
+                                              line_begin, c + 1 - line_begin);
+        }
+        line_begin = c + 1;
+        n++;
+    }
+    size_t tail_length = old_length - col;
+    lengths[n] = (uint32_t)((text + length - line_begin) + tail_length);
+
+    size_t tail_end = offset + length + tail_length;
+    if (tail_end > indexed_end(tb)) tail_end = indexed_end(tb);
+    hashes[n] = range_hash(tb, line_index_hash_bytes(0, line_begin, text + length - line_begin),
+                           offset + length, tail_end);
+
+    line_index_splice(&tb->lines, line, 1, lengths, hashes, count);
+    free(lengths);
+    free(hashes);
+}
+
+// Updates the line index for the range [offset, offset + length) having been
+// deleted, after the pieces have been updated
+static void lines_delete(TextBuffer* tb, size_t offset, size_t length)
+{
+    size_t first = line_index_find(&tb->lines, offset);
+    size_t last = line_index_find(&tb->lines, offset + length);
+
+    if (first == last)
+    {
+        line_index_resize(&tb->lines, first, -(ptrdiff_t)length);
+    }
+    else
+    {
+        // Head of the first line joins the tail of the last
+        size_t head = offset - line_index_start(&tb->lines, first);
+        size_t last_end = line_index_start(&tb->lines, last) + line_index_length(&tb->lines, last);
+        uint32_t joined = (uint32_t)(head + last_end - (offset + length));
+
+        line_index_splice(&tb->lines, first, last - first + 1, &joined, NULL, 1);
+    }
+
+    line_rehash(tb, first);
+}
+
+// ----------------------------------------------------------------
+// Lazy indexing
+// ----------------------------------------------------------------
+
+typedef struct {
+    uint32_t* lengths;      // Lengths of lines completed by the scan
+    uint64_t* hashes;       // Hashes of lines completed by the scan
+    size_t count;
+    size_t capacity;
+    size_t partial;         // Bytes of the unfinished line seen so far
+    uint64_t hash;          // Hash of the unfinished line so far
+    size_t scanned;         // Bytes consumed by the scan
+} IndexScan;
+
+static bool index_scan_push(IndexScan* s, size_t length, uint64_t hash)
+{
+    if (length > LINE_INDEX_MAX_LINE)
+    {
+        fprintf(stderr, "[text_buffer] Line of %zu bytes is too long to index.\n", length);
+        return false;
+    }
+
+    if (s->count == s->capacity)
+    {
+        size_t new_capacity = s->capacity ? s->capacity * 2 : 1024;
+        uint32_t* lengths = realloc(s->lengths, new_capacity * sizeof(uint32_t));
+        if (lengths) s->lengths = lengths;
+        uint64_t* hashes = realloc(s->hashes, new_capacity * sizeof(uint64_t));
+        if (hashes) s->hashes = hashes;
+        if (!lengths || !hashes) return false;
+        s->capacity = new_capacity;
+    }
+
+    s->lengths[s->count] = (uint32_t)length;
+    s->hashes[s->count] = hash;
+    s->count++;
+    return true;
+}
+
+static bool index_scan_span(const char* data, size_t length, void* user)
+{
+    IndexScan* s = user;
+    const char* p = data;
+    const char* end = data + length;
+
+    while (p < end)
+    {
+        const char* newline = memchr(p, '\n', end - p);
+        if (!newline)
+        {
+            if (s->partial + (end - p) > LINE_INDEX_MAX_LINE)
+            {
+                fprintf(stderr, "[text_buffer] Line of over %zu bytes is too long to index.\n", s->partial + (end - p));
+                return false;
+            }
+            s->partial += end - p;
+            s->hash = line_index_hash_bytes(s->hash, p, end - p);
+            s->scanned += end - p;
+            break;
+        }
+
+        size_t n = newline + 1 - p;
+        if (!index_scan_push(s, s->partial + n, line_index_hash_bytes(s->hash, p, n))) return false;
+        s->partial = 0;
+        s->hash = 0;
+        s->scanned += n;
+        p = newline + 1;
+    }
+    return true;
+}
+
+// Completes the last line of the index and adds the lines after it, consuming
+// scanned bytes of the unindexed text. The first line's length includes the
+// part of it already in the index, tail_hash is the hash of what has been
+// scanned of the new last line.
+static void index_append(TextBuffer* tb, const uint32_t* lengths, const uint64_t* hashes,
+                         size_t count, size_t scanned, uint64_t tail_hash)
+{
+    size_t tail = line_index_count(&tb->lines) - 1;
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        bytes += lengths[i];
+    }
+
+    // Whatever follows the last newline stays in the last line
+    line_index_splice(&tb->lines, tail, 0, lengths, hashes, count);
+    line_index_resize(&tb->lines, tail + count, (ptrdiff_t)scanned - (ptrdiff_t)bytes);
+    line_index_set_hash(&tb->lines, tail + count, tail_hash);
+    tb->unindexed -= scanned;
+
+    // Finishing the index of the saved contents gives their hash for free
+    if (tb->unindexed == 0 && tb->generation == tb->clean_generation)
+    {
+        tb->clean_hash = text_buffer_hash(tb);
+        tb->has_clean_hash = true;
+    }
+}
+
+// Scans the next TEXT_BUFFER_INDEX_CHUNK bytes of unindexed text, splitting
+// the last line of the index at every newline found. Returns false if no progress was made.
+static bool index_extend(TextBuffer* tb)
+{
+    if (tb->unindexed == 0 || tb->index_paused) return false;
+
+    size_t tail = line_index_count(&tb->lines) - 1;
+    size_t tail_start = line_index_start(&tb->lines, tail);
+    size_t position = indexed_end(tb);
+    size_t length = tb->unindexed < TEXT_BUFFER_INDEX_CHUNK ? tb->unindexed : TEXT_BUFFER_INDEX_CHUNK;
+
+    IndexScan s = { NULL, NULL, 0, 0, position - tail_start, line_index_line_hash(&tb->lines, tail), 0 };
+    if (!piece_visit(tb, tb->root, 0, position, position + length, index_scan_span, &s))
+    {
+        fprintf(stderr, "[text_buffer] Failed to grow line index.\n");
+    }
+
+    index_append(tb, s.lengths, s.hashes, s.count, s.scanned, s.hash);
+    free(s.lengths);
+    free(s.hashes);
+
+    return s.scanned > 0;
+}
+
+// Indexes until the line containing offset is known
+static void index_to_offset(TextBuffer* tb, size_t offset)
+{
+    while (tb->unindexed > 0 && text_buffer_length(tb) - tb->unindexed <= offset)
+    {
+        if (!index_extend(tb)) break;
+    }
+}
+
+// ----------------------------------------------------------------
+// Original text
+// ----------------------------------------------------------------
+
+// Repoints pieces referencing [from, from + length) at the same bytes in to
+static void piece_relocate(Piece* p, const char* from, size_t length, const char* to)
+{
+    if (!p) return;
+
+    if (p->data >= from && p->data < from + length) p->data = to + (p->data - from);
+    piece_relocate(p->left, from, length, to);
+    piece_relocate(p->right, from, length, to);
+}
+
+static void release_original(TextBuffer* tb)
+{
+    free(tb->original_heap);
+    tb->original_heap = NULL;
+    kFileMap_close(&tb->original_map);
+
+    tb->original = NULL;
+    tb->original_length = 0;
+}
+
+// Makes data the whole document, dropping all pieces and inserted text
+static void set_original(TextBuffer* tb, const char* data, size_t length)
+{
+    pool_destroy(&tb->pieces);
+    pool_init(&tb->pieces, sizeof(Piece));
+    arena_destroy(&tb->add);
+    tb->root = NULL;
+
+    tb->original = data;
+    tb->original_length = data ? length : 0;
+
+    if (tb->original_length > 0)
+    {
+        tb->root = piece_new(tb, tb->original, tb->original_length);
+    }
+}
+
+// Resets the index to a single empty line, with the whole document unscanned
+static void reset_index(TextBuffer* tb)
+{
+    line_index_build(&tb->lines, NULL, 0);
+    tb->unindexed = tb->original_length;
+    tb->index_paused = false;
+
+    text_buffer_mark_saved(tb, tb->generation, tb->unindexed == 0 ? text_buffer_hash(tb) : 0);
+    tb->clean_is_original = true;
+}
+
+static void detect_eol(TextBuffer* tb)
+{
+    // Follow the file's line ending convention when inserting new lines,
+    // only looking at the start of the file
+    size_t length = tb->original_length < 65536 ? tb->original_length : 65536;
+    const char* newline = tb->original ? memchr(tb->original, '\n', length) : NULL;
+    if (newline)
+    {
+        strcpy(tb->eol, (newline > tb->original && newline[-1] == '\r') ? "\r\n" : "\n");
+    }
+    else
+    {
+        strcpy(tb->eol, TEXT_BUFFER_DEFAULT_EOL);
+    }
+}
+
+// ----------------------------------------------------------------
+// Public API
+// ----------------------------------------------------------------
+
+TextBuffer* text_buffer_create(void)
+{
+    TextBuffer* tb = calloc(1, sizeof(TextBuffer));
+    if (!tb) return NULL;
+
+    tb->seed = 0x9E3779B9u;
+    strcpy(tb->eol, TEXT_BUFFER_DEFAULT_EOL);
+
+    arena_init(&tb->add);
+    pool_init(&tb->pieces, sizeof(Piece));
+
+    line_index_init(&tb->lines);
+    text_buffer_mark_saved(tb, tb->generation, text_buffer_hash(tb));
+    tb->clean_is_original = true;
+
+    return tb;
+}
+
+void text_buffer_destroy(TextBuffer* tb)
+{
+    if (!tb) return;
+
+    pool_destroy(&tb->pieces);
+    arena_destroy(&tb->add);
+    release_original(tb);
+    line_index_destroy(&tb->lines);
+    free(tb);
+}
+
+void text_buffer_load(TextBuffer* tb, char* data, size_t length)
+{
+    set_original(tb, NULL, 0);
+    release_original(tb);
+
+    tb->original_heap = data;
+    set_original(tb, data, length);
+    detect_eol(tb);
+    reset_index(tb);
+}
+
+int text_buffer_load_file(TextBuffer* tb, const char* path)
+{
+    kFileMap map;
+    if (kFileMap_open(&map, path))
+    {
+        set_original(tb, NULL, 0);
+        release_original(tb);
+
+        tb->original_map = map;
+        set_original(tb, map.data, map.size);
+        detect_eol(tb);
+        reset_index(tb);
+        return 1;
+    }
+
+    // Not mappable (e.g. not a regular file), read it instead
+    FILE* f = fopen(path, "rb");
+    if (!f) return 0;
+
+    size_t capacity = 65536;
+    size_t length = 0;
+    char* data = malloc(capacity);
+    while (data)
+    {
+        length += fread(data + length, 1, capacity - length, f);
+        if (length < capacity) break;
+
+        capacity *= 2;
+        char* grown = realloc(data, capacity);
+        if (!grown) free(data);
+        data = grown;
+    }
+
+    bool failed = ferror(f) || !data;
+    fclose(f);
+    if (failed)
+    {
+        free(data);
+        return 0;
+    }
+
+    text_buffer_load(tb, data, length);
+    return 1;
+}
+
+int text_buffer_detach_file(TextBuffer* tb, char* copy)
+{
+    if (!tb->original_map.data)
+    {
+        free(copy);
+        return 1;
+    }
+
+    if (!copy)
+    {
+        copy = malloc(tb->original_length);
+        if (!copy) return 0;
+        memcpy(copy, tb->original, tb->original_length);
+    }
+
+    piece_relocate(tb->root, tb->original, tb->original_length, copy);
+
+    kFileMap_close(&tb->original_map);
+    tb->original_heap = copy;
+    tb->original = copy;
+    return 1;
+}
+
+uint64_t text_buffer_hash(TextBuffer* tb)
+{
+    return line_index_hash(&tb->lines) * LINE_INDEX_HASH_LINE + text_buffer_length(tb);
+}
+
+void text_buffer_mark_saved(TextBuffer* tb, uint64_t generation, uint64_t hash)
+{
+    tb->clean_generation = generation;
+    tb->clean_hash = hash;
+    tb->has_clean_hash = hash != 0;
+    tb->clean_is_original = false;
+}
+
+// text_buffer_hash the original text would have once fully indexed
+static uint64_t hash_original(TextBuffer* tb)
+{
+    uint64_t lines = 0;
+    const char* line = tb->original;
+    const char* end = tb->original + tb->original_length;
+    const char* newline;
+    while (line < end && (newline = memchr(line, '\n', end - line)) != NULL)
+    {
+        lines = lines * LINE_INDEX_HASH_LINE + line_index_hash_bytes(0, line, newline + 1 - line);
+        line = newline + 1;
+    }
+    lines = lines * LINE_INDEX_HASH_LINE + line_index_hash_bytes(0, line, end - line);
+    return lines * LINE_INDEX_HASH_LINE + tb->original_length;
+}
+
+bool text_buffer_is_modified(TextBuffer* tb)
+{
+    if (tb->generation == tb->clean_generation) return false;
+
+    // Hashes taken at different indexing progress cannot be compared
+    if (tb->unindexed > 0) return true;
+
+    if (!tb->has_clean_hash)
+    {
+        // Edited before the index was complete, the saved hash was never seen.
+        // When the saved text is the original it can still be hashed, once.
+        if (!tb->clean_is_original) return true;
+        tb->clean_hash = hash_original(tb);
+        tb->has_clean_hash = true;
+    }
+    return text_buffer_hash(tb) != tb->clean_hash;
+}
+
+int text_buffer_rebase(TextBuffer* tb)
+{
+    size_t length = text_buffer_length(tb);
+    char* data = malloc(length > 0 ? length : 1);
+    if (!data) return 0;
+
+    text_buffer_copy(tb, 0, length, data);
+
+    // Contents (and so the line index) are unchanged, only the storage behind them
+    set_original(tb, NULL, 0);
+    release_original(tb);
+
+    tb->original_heap = data;
+    set_original(tb, data, length);
+    tb->clean_is_original = tb->generation == tb->clean_generation;
+
+    return 1;
+}
+
+typedef struct {
+    const char* original;
+    size_t offset;
+} CompareState;
+
+int text_buffer_rebase_file(TextBuffer* tb, const char* path)
+{
+    kFileMap map;
+    if (!kFileMap_open(&map, path)) return text_buffer_rebase(tb);
+
+    if (map.size != text_buffer_length(tb))
+    {
+        kFileMap_close(&map);
+        return text_buffer_rebase(tb);
+    }
+
+    // Contents (and so the line index) are unchanged, only the storage behind them
+    set_original(tb, NULL, 0);
+    release_original(tb);
+
+    tb->original_map = map;
+    set_original(tb, map.data, map.size);
+    tb->clean_is_original = tb->generation == tb->clean_generation;
+
+    return 1;
+}
+
+static bool compare_span(const char* data, size_t length, void* user)
+{
+    CompareState* state = user;
+    if (memcmp(data, state->original + state->offset, length) != 0) return false;
+    state->offset += length;
+    return true;
+}
+
+bool text_buffer_is_original(TextBuffer* tb)
+{
+    if (text_buffer_length(tb) != tb->original_length) return false;
+
+    // Untouched documents are a single piece spanning the original
+    if (!tb->root) return true;
+    if (tb->pieces.count == 1 && tb->root->data == tb->original) return true;
+
+    CompareState state = { tb->original, 0 };
+    return text_buffer_for_each_span(tb, compare_span, &state);
+}
+
+void text_buffer_insert(TextBuffer* tb, size_t offset, const char* text, size_t length)
+{
+    if (length == 0) return;
+
+    size_t doc_length = text_buffer_length(tb);
+    if (offset > doc_length) offset = doc_length;
+
+    index_to_offset(tb, offset);
+    tb->generation++;
+
+    // Past what could be indexed the text simply joins the unscanned bytes
+    bool unscanned = offset > indexed_end(tb);
+
+    Piece* left;
+    Piece* right;
+    piece_split(tb, tb->root, offset, &left, &right);
+
+    // Typing usually continues straight after the previous insert, in which case
+    // the piece ending at the cursor can simply be extended in place
+    Piece* last = left;
+    while (last && last->right) last = last->right;
+
+    if (last && arena_extend(&tb->add, last->data + last->length, length))
+    {
+        memcpy((char*)last->data + last->length, text, length);
+        for (Piece* p = left; p; p = p->right) p->total += length;
+        last->length += length;
+        tb->root = piece_merge(left, right);
+    }
+    else
+    {
+        char* data = arena_alloc(&tb->add, length, 1);
+        Piece* piece = data ? piece_new(tb, data, length) : NULL;
+        if (!piece)
+        {
+            fprintf(stderr, "[text_buffer] Failed to allocate inserted text.\n");
+            tb->root = piece_merge(left, right);
+            return;
+        }
+
+        memcpy(data, text, length);
+        tb->root = piece_merge(piece_merge(left, piece), right);
+    }
+
+    if (unscanned) tb->unindexed += length;
+    else lines_insert(tb, offset, text, length);
+}
+
+void text_buffer_delete(TextBuffer* tb, size_t offset, size_t length)
+{
+    size_t doc_length = text_buffer_length(tb);
+    if (offset >= doc_length) return;
+    if (length > doc_length - offset) length = doc_length - offset;
+    if (length == 0) return;
+
+    index_to_offset(tb, offset + length);
+    tb->generation++;
+
+    // Bytes past what could be indexed only leave the unscanned text
+    size_t end = indexed_end(tb);
+    size_t unscanned = offset + length > end ? offset + length - (offset > end ? offset : end) : 0;
+    tb->unindexed -= unscanned;
+
+    Piece* left;
+    Piece* middle;
+    Piece* right;
+    piece_split(tb, tb->root, offset, &left, &right);
+    piece_split(tb, right, length, &middle, &right);
+    piece_free_tree(tb, middle);
+    tb->root = piece_merge(left, right);
+
+    if (unscanned < length) lines_delete(tb, offset, length - unscanned);
+}
+
+typedef struct {
+    char* out;
+} CopyState;
+
+static bool copy_span(const char* data, size_t length, void* user)
+{
+    CopyState* state = user;
+    memcpy(state->out, data, length);
+    state->out += length;
+    return true;
+}
+
+size_t text_buffer_copy(TextBuffer* tb, size_t offset, size_t length, char* out)
+{
+    size_t doc_length = text_buffer_length(tb);
+    if (offset >= doc_length) return 0;
+    if (length > doc_length - offset) length = doc_length - offset;
+
+    CopyState state = { out };
+    piece_visit(tb, tb->root, 0, offset, offset + length, copy_span, &state);
+    return length;
+}
+
+bool text_buffer_for_each_span(TextBuffer* tb, TextBufferSpanFn fn, void* user)
+{
+    return piece_visit(tb, tb->root, 0, 0, text_buffer_length(tb), fn, user);
+}
+
+static bool snapshot_span(const char* data, size_t length, void* user)
+{
+    TextBufferSnapshot* snap = user;
+    snap->spans[snap->count].data = data;
+    snap->spans[snap->count].size = length;
+    snap->count++;
+    return true;
+}
+
+int text_buffer_snapshot(TextBuffer* tb, TextBufferSnapshot* snap)
+{
+    // Every non-empty piece is one span
+    size_t pieces = tb->pieces.count;
+    snap->spans = malloc((pieces > 0 ? pieces : 1) * sizeof(kFileSpan));
+    snap->count = 0;
+    snap->length = text_buffer_length(tb);
+    snap->generation = tb->generation;
+    snap->hash = tb->unindexed == 0 ? text_buffer_hash(tb) : 0;
+    if (!snap->spans) return 0;
+
+    text_buffer_for_each_span(tb, snapshot_span, snap);
+    return 1;
+}
+
+void text_buffer_snapshot_free(TextBufferSnapshot* snap)
+{
+    free(snap->spans);
+    snap->spans = NULL;
+    snap->count = 0;
+}
+
+size_t text_buffer_length(TextBuffer* tb)
+{
+    return piece_total(tb->root);
+}
+
+void text_buffer_index_to_line(TextBuffer* tb, size_t line)
+{
+    // Lines before the last one in the index are complete
+    while (tb->unindexed > 0 && line_index_count(&tb->lines) - 1 <= line)
+    {
+        if (!index_extend(tb)) break;
+    }
+}
+
+bool text_buffer_is_indexed(TextBuffer* tb)
+{
+    return tb->unindexed == 0;
+}
+
+void text_buffer_pause_indexing(TextBuffer* tb, bool paused)
+{
+    tb->index_paused = paused;
+}
+
+int text_buffer_append_lines(TextBuffer* tb, const uint32_t* lengths, const uint64_t* hashes,
+                             size_t count, size_t scanned, uint64_t tail_hash)
+{
+    size_t tail = line_index_count(&tb->lines) - 1;
+    size_t tail_length = line_index_length(&tb->lines, tail);
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        bytes += lengths[i];
+    }
+
+    // Lines must come from the unindexed text, in order
+    if (scanned > tb->unindexed || bytes > tail_length + scanned) return 0;
+    if (tail_length + scanned - bytes > LINE_INDEX_MAX_LINE) return 0;
+
+    index_append(tb, lengths, hashes, count, scanned, tail_hash);
+    return 1;
+}
+
+size_t text_buffer_line_count(TextBuffer* tb)
+{
+    if (tb->unindexed == 0) return line_index_count(&tb->lines);
+
+    text_buffer_index_to_line(tb, 0);
+    size_t count = line_index_count(&tb->lines);
+    return (tb->unindexed > 0 && count > 1) ? count - 1 : count;
+}
+
+size_t text_buffer_line_start(TextBuffer* tb, size_t line)
+{
+    text_buffer_index_to_line(tb, line);
+    return line_index_start(&tb->lines, line);
+}
+
+size_t text_buffer_line_length(TextBuffer* tb, size_t line)
+{
+    text_buffer_index_to_line(tb, line);
+
+    size_t length = line_index_length(&tb->lines, line);
+    if (line + 1 >= line_index_count(&tb->lines)) return length + tb->unindexed;
+
+    // Exclude "\n", or "\r\n"
+    length--;
+    if (length > 0)
+    {
+        char c;
+        text_buffer_copy(tb, line_index_start(&tb->lines, line) + length - 1, 1, &c);
+        if (c == '\r') length--;
+    }
+    return length;
+}
+
+uint64_t text_buffer_line_hash(TextBuffer* tb, size_t line)
+{
+    text_buffer_index_to_line(tb, line);
+    return line_index_line_hash(&tb->lines, line);
+}
+
+size_t text_buffer_line_of_offset(TextBuffer* tb, size_t offset)
+{
+    index_to_offset(tb, offset);
+    return line_index_find(&tb->lines, offset);
+}
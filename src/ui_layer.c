@@ -0,0 +1,106 @@
+#include "ui_layer.h"
+#include "renderer.h"
+#include <stdio.h>
+#include <string.h>
+
+void ui_layer_init(UiLayer* l)
+{
+    memset(l, 0, sizeof(UiLayer));
+}
+
+void ui_layer_destroy(UiLayer* l)
+{
+    if (l->texture) SDL_DestroyTexture(l->texture);
+    ui_layer_init(l);
+}
+
+void ui_layer_invalidate(UiLayer* l)
+{
+    l->key = 0;
+}
+
+uint64_t ui_layer_hash(uint64_t seed, const void* data, size_t length)
+{
+    const unsigned char* p = data;
+    uint64_t h = seed;
+    for (size_t i = 0; i < length; i++)
+    {
+        h ^= p[i];
+        h *= 1099511628211ull; // FNV-1a prime
+    }
+    return h;
+}
+
+// (Re)creates the texture for the current size, falling back to direct drawing
+static void ui_layer_create_texture(UiLayer* l, struct Renderer* r)
+{
+    if (l->texture) SDL_DestroyTexture(l->texture);
+
+    l->texture = SDL_CreateTexture(r->sdl_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, l->w, l->h);
+    if (!l->texture)
+    {
+        fprintf(stderr, "[ui_layer] Failed to create layer texture, drawing directly: %s\n", SDL_GetError());
+        l->direct = true;
+        return;
+    }
+
+    // Drawing into a cleared texture with normal blending leaves premultiplied colour
+    SDL_BlendMode premultiplied = SDL_ComposeCustomBlendMode(
+        SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+        SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+    if (SDL_SetTextureBlendMode(l->texture, premultiplied) != 0)
+    {
+        SDL_SetTextureBlendMode(l->texture, SDL_BLENDMODE_BLEND); // Slightly darker edges
+    }
+}
+
+bool ui_layer_begin(UiLayer* l, struct Renderer* r, int x, int y, int w, int h, uint64_t key)
+{
+    l->x = x;
+    l->y = y;
+    if (w <= 0 || h <= 0)
+    {
+        // Nothing to show, the texture is recreated once there is
+        l->w = w;
+        l->h = h;
+        return false;
+    }
+
+    // Text drawn before its glyphs arrived from the raster pool is out of date
+    key = ui_layer_hash(key, &r->glyph_generation, sizeof(r->glyph_generation));
+
+    bool resized = l->w != w || l->h != h;
+    if (!l->direct && l->texture && !resized && l->key == key) return false;
+
+    l->w = w;
+    l->h = h;
+    l->key = key;
+    if (!l->direct && (resized || !l->texture)) ui_layer_create_texture(l, r);
+
+    l->viewport = renderer_get_viewport(r);
+    l->drawing = true;
+
+    if (l->direct)
+    {
+        SDL_Rect panel = { l->viewport.x + x, l->viewport.y + y, w, h };
+        renderer_set_viewport(r, &panel);
+        return true;
+    }
+
+    renderer_set_target(r, l->texture);
+    SDL_SetRenderDrawColor(r->sdl_renderer, 0, 0, 0, 0);
+    SDL_RenderClear(r->sdl_renderer);
+    return true;
+}
+
+void ui_layer_end(UiLayer* l, struct Renderer* r)
+{
+    if (l->drawing)
+    {
+        l->drawing = false;
+        if (!l->direct) renderer_set_target(r, NULL);
+        renderer_set_viewport(r, &l->viewport);
+    }
+
+    if (!l->direct && l->texture) renderer_draw_texture(r, l->texture, l->x, l->y, l->w, l->h);
+}
@@ -0,0 +1,299 @@
+#include "undo.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+// Copies text into the history arena
+static const char* undo_store(UndoHistory* u, const char* text, size_t length)
+{
+    if (length == 0) return NULL;
+
+    char* copy = arena_alloc(&u->text, length, 1);
+    if (copy) memcpy(copy, text, length);
+    return copy;
+}
+
+static size_t undo_memory(UndoHistory* u)
+{
+    return u->text.total_size + u->capacity * sizeof(UndoEntry);
+}
+
+// Drops the oldest applied entries until the history fits in half its budget,
+// copying what is kept into a fresh arena so the space is actually released
+static void undo_compact(UndoHistory* u)
+{
+    size_t keep_bytes = 0;
+    size_t first = u->count;
+    while (first > 0)
+    {
+        UndoEntry* e = &u->entries[first - 1];
+        size_t bytes = e->removed_length + e->inserted_length + sizeof(UndoEntry);
+        if (keep_bytes + bytes > u->budget / 2) break;
+        keep_bytes += bytes;
+        first--;
+    }
+
+    // Entries that can still be redone depend on everything before them
+    if (first > u->position) first = u->position;
+
+    Arena text;
+    arena_init(&text);
+    for (size_t i = first; i < u->count; i++)
+    {
+        UndoEntry* e = &u->entries[i];
+        char* removed = e->removed_length ? arena_alloc(&text, e->removed_length, 1) : NULL;
+        char* inserted = e->inserted_length ? arena_alloc(&text, e->inserted_length, 1) : NULL;
+        if ((e->removed_length && !removed) || (e->inserted_length && !inserted))
+        {
+            // Out of memory, keep the history as it was
+            arena_destroy(&text);
+            return;
+        }
+
+        if (removed) memcpy(removed, e->removed, e->removed_length);
+        if (inserted) memcpy(inserted, e->inserted, e->inserted_length);
+        e->removed = removed;
+        e->inserted = inserted;
+    }
+
+    arena_destroy(&u->text);
+    u->text = text;
+
+    memmove(u->entries, u->entries + first, (u->count - first) * sizeof(UndoEntry));
+    u->count -= first;
+    u->position -= first;
+
+    if (first > 0) printf("[undo] Dropped %zu oldest entries to stay within budget.\n", first);
+}
+
+// Starts a new entry, discarding anything that could have been redone
+static UndoEntry* undo_push(UndoHistory* u, size_t offset)
+{
+    u->count = u->position;
+
+    if (u->count == u->capacity)
+    {
+        size_t new_capacity = u->capacity ? u->capacity * 2 : 256;
+        UndoEntry* entries = realloc(u->entries, new_capacity * sizeof(UndoEntry));
+        if (!entries)
+        {
+            fprintf(stderr, "[undo] Failed to grow history.\n");
+            return NULL;
+        }
+        u->entries = entries;
+        u->capacity = new_capacity;
+    }
+
+    UndoEntry* e = &u->entries[u->count++];
+    u->position = u->count;
+
+    e->offset = offset;
+    e->removed = NULL;
+    e->removed_length = 0;
+    e->inserted = NULL;
+    e->inserted_length = 0;
+    return e;
+}
+
+// Last entry, if the next edit may be merged into it
+static UndoEntry* undo_mergeable(UndoHistory* u)
+{
+    if (u->sealed || u->position == 0 || u->position != u->count) return NULL;
+    return &u->entries[u->count - 1];
+}
+
+static void undo_check_budget(UndoHistory* u)
+{
+    u->sealed = false;
+    if (undo_memory(u) > u->budget) undo_compact(u);
+}
+
+void undo_init(UndoHistory* u, size_t budget)
+{
+    u->entries = NULL;
+    u->count = 0;
+    u->capacity = 0;
+    u->position = 0;
+    arena_init(&u->text);
+    u->budget = budget;
+    u->sealed = true;
+}
+
+void undo_destroy(UndoHistory* u)
+{
+    free(u->entries);
+    arena_destroy(&u->text);
+    undo_init(u, u->budget);
+}
+
+void undo_clear(UndoHistory* u)
+{
+    undo_destroy(u);
+}
+
+void undo_seal(UndoHistory* u)
+{
+    u->sealed = true;
+}
+
+// Whether an edit fits the budget, checked before any of its text is copied
+static bool undo_fits(UndoHistory* u, size_t length)
+{
+    if (length <= u->budget / 2 && u->budget / 2 - length >= sizeof(UndoEntry)) return true;
+
+    fprintf(stderr, "[undo] Edit of %zu bytes is too large to undo, history cleared.\n", length);
+    return false;
+}
+
+// Forgets the history, as an edit that was not recorded breaks every entry before it
+static bool undo_forget(UndoHistory* u)
+{
+    undo_clear(u);
+    return false;
+}
+
+bool undo_record_insert(UndoHistory* u, size_t offset, const char* text, size_t length)
+{
+    if (length == 0) return true;
+    if (!undo_fits(u, length)) return undo_forget(u);
+
+    // Typing straight after the last insert extends it, new lines start a new entry
+    UndoEntry* last = undo_mergeable(u);
+    if (last && last->removed_length == 0 && last->inserted_length > 0 &&
+        offset == last->offset + last->inserted_length &&
+        last->inserted_length + length <= UNDO_COALESCE_MAX &&
+        !memchr(text, '\n', length) &&
+        arena_extend(&u->text, last->inserted + last->inserted_length, length))
+    {
+        memcpy((char*)last->inserted + last->inserted_length, text, length);
+        last->inserted_length += length;
+        undo_check_budget(u);
+        return true;
+    }
+
+    UndoEntry* e = undo_push(u, offset);
+    if (!e) return undo_forget(u);
+
+    e->inserted = undo_store(u, text, length);
+    if (!e->inserted)
+    {
+        fprintf(stderr, "[undo] Failed to store inserted text.\n");
+        return undo_forget(u);
+    }
+    e->inserted_length = length;
+    undo_check_budget(u);
+    return true;
+}
+
+bool undo_record_delete(UndoHistory* u, TextBuffer* tb, size_t offset, size_t length)
+{
+    size_t doc_length = text_buffer_length(tb);
+    if (offset >= doc_length) return true;
+    if (length > doc_length - offset) length = doc_length - offset;
+    if (length == 0) return true;
+    if (!undo_fits(u, length)) return undo_forget(u);
+
+    UndoEntry* last = undo_mergeable(u);
+
+    // Backspacing over text that was just typed simply shortens the insert
+    if (last && last->removed_length == 0 && length <= last->inserted_length &&
+        offset + length == last->offset + last->inserted_length)
+    {
+        last->inserted_length -= length;
+        if (last->inserted_length == 0)
+        {
+            u->count--;
+            u->position--;
+        }
+        undo_check_budget(u);
+        return true;
+    }
+
+    // Consecutive backspaces (or deletes) grow the removed text
+    if (last && last->inserted_length == 0 && last->removed_length > 0 &&
+        last->removed_length + length <= UNDO_COALESCE_MAX &&
+        (offset + length == last->offset || offset == last->offset))
+    {
+        size_t total = last->removed_length + length;
+
+        // Grow the removed text in place like typed text, only moving it to a
+        // new allocation when something else was stored after it
+        char* removed = (char*)last->removed;
+        if (!arena_extend(&u->text, removed + last->removed_length, length))
+        {
+            removed = arena_alloc(&u->text, total, 1);
+            if (removed) memcpy(removed, last->removed, last->removed_length);
+        }
+        if (removed)
+        {
+            if (offset == last->offset)
+            {
+                text_buffer_copy(tb, offset, length, removed + last->removed_length);
+            }
+            else
+            {
+                // Backspacing puts the new text in front, bounded by UNDO_COALESCE_MAX
+                memmove(removed + length, removed, last->removed_length);
+                text_buffer_copy(tb, offset, length, removed);
+            }
+
+            last->offset = offset;
+            last->removed = removed;
+            last->removed_length = total;
+            undo_check_budget(u);
+            return true;
+        }
+    }
+
+    UndoEntry* e = undo_push(u, offset);
+    if (!e) return undo_forget(u);
+
+    char* removed = arena_alloc(&u->text, length, 1);
+    if (!removed)
+    {
+        fprintf(stderr, "[undo] Failed to store removed text.\n");
+        return undo_forget(u);
+    }
+
+    text_buffer_copy(tb, offset, length, removed);
+    e->removed = removed;
+    e->removed_length = length;
+    undo_check_budget(u);
+    return true;
+}
+
+const UndoEntry* undo_peek_undo(UndoHistory* u)
+{
+    return u->position > 0 ? &u->entries[u->position - 1] : NULL;
+}
+
+const UndoEntry* undo_peek_redo(UndoHistory* u)
+{
+    return u->position < u->count ? &u->entries[u->position] : NULL;
+}
+
+bool undo_undo(UndoHistory* u, TextBuffer* tb, size_t* cursor)
+{
+    if (u->position == 0) return false;
+
+    UndoEntry* e = &u->entries[--u->position];
+    text_buffer_delete(tb, e->offset, e->inserted_length);
+    text_buffer_insert(tb, e->offset, e->removed, e->removed_length);
+
+    if (cursor) *cursor = e->offset + e->removed_length;
+    u->sealed = true;
+    return true;
+}
+
+bool undo_redo(UndoHistory* u, TextBuffer* tb, size_t* cursor)
+{
+    if (u->position == u->count) return false;
+
+    UndoEntry* e = &u->entries[u->position++];
+    text_buffer_delete(tb, e->offset, e->removed_length);
+    text_buffer_insert(tb, e->offset, e->inserted, e->inserted_length);
+
+    if (cursor) *cursor = e->offset + e->inserted_length;
+    u->sealed = true;
+    return true;
+}
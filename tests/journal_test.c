@@ -0,0 +1,251 @@
+/**
+ * Journal checks, run with `make test`.
+ *
+ * Records random edits, then cuts the journal at every byte of its last
+ * record and checks that replaying it rebuilds exactly the text of the
+ * complete records. Also checks that a journal is refused for different
+ * text, and that a finished save restarts it relative to the saved text.
+ */
+
+#include "journal.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_FILE    "build/journal_test.txt"  // Never written, only its journal
+#define TEST_JOURNAL TEST_FILE JOURNAL_SUFFIX
+#define EDITS        200
+
+static const char base_text[] = "The quick brown fox\njumps over\nthe lazy dog\n";
+
+// Text the journal should rebuild, edited alongside it
+typedef struct {
+    char* data;
+    size_t length;
+} Model;
+
+static TextBuffer* load_text(const char* text, size_t length)
+{
+    char* data = malloc(length);
+    assert(data);
+    memcpy(data, text, length);
+
+    TextBuffer* tb = text_buffer_create();
+    assert(tb);
+    text_buffer_load(tb, data, length);
+    text_buffer_index_to_line(tb, (size_t)-1);
+    return tb;
+}
+
+static void check_text(TextBuffer* tb, const char* text, size_t length)
+{
+    assert(text_buffer_length(tb) == length);
+
+    char* data = malloc(length + 1);
+    assert(data);
+    text_buffer_copy(tb, 0, length, data);
+    assert(memcmp(data, text, length) == 0);
+    free(data);
+}
+
+static uint64_t text_hash(const char* text, size_t length)
+{
+    TextBuffer* tb = load_text(text, length);
+    uint64_t hash = text_buffer_hash(tb);
+    text_buffer_destroy(tb);
+    return hash;
+}
+
+// Applies an edit to the model and journals it, returning the record's size
+static size_t edit(Journal* j, Model* m, bool insert, size_t offset, const char* text, size_t length)
+{
+    if (insert)
+    {
+        m->data = realloc(m->data, m->length + length);
+        assert(m->data);
+        memmove(m->data + offset + length, m->data + offset, m->length - offset);
+        memcpy(m->data + offset, text, length);
+        m->length += length;
+        journal_record_insert(j, offset, text, length);
+        return JOURNAL_RECORD_HEADER + length + JOURNAL_CHECKSUM_SIZE;
+    }
+
+    memmove(m->data + offset, m->data + offset + length, m->length - offset - length);
+    m->length -= length;
+    journal_record_delete(j, offset, length);
+    return JOURNAL_RECORD_HEADER + JOURNAL_CHECKSUM_SIZE;
+}
+
+static void random_edit(Journal* j, Model* m, size_t* size)
+{
+    if (m->length > 0 && rand() % 3 == 0)
+    {
+        size_t offset = rand() % m->length;
+        size_t length = 1 + rand() % 5;
+        if (length > m->length - offset) length = m->length - offset;
+        *size += edit(j, m, false, offset, NULL, length);
+        return;
+    }
+
+    char text[8];
+    size_t length = 1 + rand() % sizeof(text);
+    for (size_t i = 0; i < length; i++) text[i] = (rand() % 8 == 0) ? '\n' : 'a' + rand() % 26;
+    *size += edit(j, m, true, m->length ? rand() % (m->length + 1) : 0, text, length);
+}
+
+static char* read_journal(size_t* length)
+{
+    FILE* f = fopen(TEST_JOURNAL, "rb");
+    assert(f);
+    fseek(f, 0, SEEK_END);
+    *length = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char* data = malloc(*length);
+    assert(data);
+    assert(fread(data, 1, *length, f) == *length);
+    fclose(f);
+    return data;
+}
+
+static void write_journal(const char* data, size_t length)
+{
+    FILE* f = fopen(TEST_JOURNAL, "wb");
+    assert(f);
+    assert(fwrite(data, 1, length, f) == length);
+    fclose(f);
+}
+
+static Model new_model(const char* text, size_t length)
+{
+    Model m = { malloc(length), length };
+    assert(m.data);
+    memcpy(m.data, text, length);
+    return m;
+}
+
+static Journal* open_journal(const char* text, size_t length)
+{
+    Journal* j = journal_open(TEST_FILE, length, text_hash(text, length), 0);
+    assert(j);
+    return j;
+}
+
+static void test_torn_tail(void)
+{
+    size_t base_length = strlen(base_text);
+    Model m = new_model(base_text, base_length);
+    Journal* j = open_journal(base_text, base_length);
+
+    size_t size = JOURNAL_HEADER_SIZE;
+    for (int i = 0; i < EDITS - 1; i++) random_edit(j, &m, &size);
+    Model before_last = new_model(m.data, m.length);
+    size_t last_start = size;
+    random_edit(j, &m, &size);
+    journal_close(j, false);
+
+    size_t length;
+    char* journal = read_journal(&length);
+    assert(length == size);
+
+    // Any cut within the last record replays the others, only a whole one replays it too
+    for (size_t cut = last_start; cut <= length; cut++)
+    {
+        write_journal(journal, cut);
+
+        TextBuffer* tb = load_text(base_text, base_length);
+        JournalReplayStats stats;
+        assert(journal_replay(TEST_FILE, tb, &stats));
+
+        bool whole = cut == length;
+        assert(stats.records == (whole ? EDITS : EDITS - 1));
+        assert(stats.bytes == (whole ? length : last_start));
+        if (whole) check_text(tb, m.data, m.length);
+        else check_text(tb, before_last.data, before_last.length);
+        text_buffer_destroy(tb);
+    }
+
+    // A damaged byte fails the last record's checksum
+    journal[length - 5] ^= 1;
+    write_journal(journal, length);
+    TextBuffer* tb = load_text(base_text, base_length);
+    JournalReplayStats stats;
+    assert(journal_replay(TEST_FILE, tb, &stats) && stats.records == EDITS - 1);
+    check_text(tb, before_last.data, before_last.length);
+    text_buffer_destroy(tb);
+
+    free(journal);
+    free(before_last.data);
+    free(m.data);
+}
+
+static void test_other_text(void)
+{
+    size_t base_length = strlen(base_text);
+    Model m = new_model(base_text, base_length);
+    Journal* j = open_journal(base_text, base_length);
+    edit(j, &m, true, 0, "edit", 4);
+    journal_close(j, false);
+
+    // Same length, different contents: the edits must not be applied
+    char other[sizeof(base_text)];
+    memcpy(other, base_text, sizeof(base_text));
+    other[0] = 't';
+    TextBuffer* tb = load_text(other, base_length);
+    assert(!journal_replay(TEST_FILE, tb, NULL));
+    check_text(tb, other, base_length);
+    text_buffer_destroy(tb);
+
+    free(m.data);
+}
+
+static void test_save(bool succeeded)
+{
+    size_t base_length = strlen(base_text);
+    Model m = new_model(base_text, base_length);
+    Journal* j = open_journal(base_text, base_length);
+    edit(j, &m, true, 0, "before ", 7);
+
+    // The save snapshot holds the first edit, the second is made while it is written
+    journal_begin_save(j);
+    Model saved = new_model(m.data, m.length);
+    edit(j, &m, true, m.length, "during", 6);
+    FileSaveStats stats = { .bytes = saved.length, .hash = text_hash(saved.data, saved.length) };
+    journal_end_save(j, succeeded ? &stats : NULL);
+    journal_close(j, false);
+
+    // A finished save restarts the journal on the saved text, a failed one leaves it
+    const char* on = succeeded ? saved.data : base_text;
+    size_t on_length = succeeded ? saved.length : base_length;
+    TextBuffer* tb = load_text(on, on_length);
+    JournalReplayStats replay;
+    assert(journal_replay(TEST_FILE, tb, &replay));
+    assert(replay.records == (succeeded ? 1 : 2));
+    check_text(tb, m.data, m.length);
+    text_buffer_destroy(tb);
+
+    if (succeeded)
+    {
+        tb = load_text(base_text, base_length);
+        assert(!journal_replay(TEST_FILE, tb, NULL));
+        text_buffer_destroy(tb);
+    }
+
+    free(saved.data);
+    free(m.data);
+}
+
+int main(void)
+{
+    srand(1);
+
+    test_torn_tail();
+    test_other_text();
+    test_save(true);
+    test_save(false);
+
+    remove(TEST_JOURNAL);
+    printf("[journal_test] Passed.\n");
+    return 0;
+}
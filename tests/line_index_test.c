@@ -0,0 +1,94 @@
+/**
+ * Line index checks, run with `make test`.
+ *
+ * Applies random splices to an index and to a plain array of line lengths,
+ * comparing the two after every edit, then checks that the edits did not
+ * leave the index spread over many mostly empty blocks.
+ */
+
+#include "line_index.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EDITS     20000
+#define MAX_LINES 200000
+
+static uint32_t shadow[MAX_LINES];
+static size_t shadow_count;
+
+static size_t count_blocks(LineBlock* b, size_t* smallest)
+{
+    if (!b) return 0;
+    if (b->count < *smallest) *smallest = b->count;
+    return count_blocks(b->left, smallest) + 1 + count_blocks(b->right, smallest);
+}
+
+static void check_lines(LineIndex* li)
+{
+    assert(line_index_count(li) == shadow_count);
+
+    size_t offset = 0;
+    for (size_t i = 0; i < shadow_count; i++)
+    {
+        assert(line_index_length(li, i) == shadow[i]);
+        assert(line_index_start(li, i) == offset);
+        offset += shadow[i];
+    }
+    assert(line_index_bytes(li) == offset);
+}
+
+static void splice(LineIndex* li, size_t line, size_t remove_count, size_t insert_count)
+{
+    uint32_t lengths[64];
+    for (size_t i = 0; i < insert_count; i++) lengths[i] = 1 + rand() % 80;
+
+    line_index_splice(li, line, remove_count, lengths, NULL, insert_count);
+
+    memmove(&shadow[line + insert_count], &shadow[line + remove_count],
+            (shadow_count - line - remove_count) * sizeof(uint32_t));
+    memcpy(&shadow[line], lengths, insert_count * sizeof(uint32_t));
+    shadow_count += insert_count - remove_count;
+}
+
+int main(void)
+{
+    srand(1);
+
+    LineIndex li;
+    line_index_init(&li);
+    shadow[0] = 0;
+    shadow_count = 1;
+
+    // Grow the document, then edit it mostly by joining and splitting single
+    // lines, the way typing does
+    for (int i = 0; i < 200; i++) splice(&li, shadow_count - 1, 0, 64);
+
+    for (int i = 0; i < EDITS; i++)
+    {
+        size_t line = rand() % shadow_count;
+        size_t available = shadow_count - line;
+        size_t remove_count = rand() % 3;
+        if (remove_count > available) remove_count = available;
+        size_t insert_count = rand() % 3;
+        if (shadow_count - remove_count + insert_count == 0) insert_count = 1;
+
+        splice(&li, line, remove_count, insert_count);
+        if (i % 1000 == 0) check_lines(&li);
+    }
+    check_lines(&li);
+
+    size_t smallest = LINE_INDEX_BLOCK_SIZE;
+    size_t blocks = count_blocks(li.root, &smallest);
+    double per_block = (double)shadow_count / (double)blocks;
+    printf("[line_index_test] %zu lines in %zu blocks, %.1f lines per block, smallest %zu.\n",
+           shadow_count, blocks, per_block, smallest);
+
+    assert(per_block >= LINE_INDEX_BLOCK_MIN);
+    assert(smallest >= LINE_INDEX_BLOCK_MIN);
+
+    line_index_destroy(&li);
+    printf("[line_index_test] Passed.\n");
+    return 0;
+}